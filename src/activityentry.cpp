@@ -1,2 +1,17 @@
 #include "activityentry.h"
 
+
+KVListEntry::KeyValueMap ActivityEntry::defaultValues() const
+{
+    static const KeyValueMap defaults = {
+        { selected, false },
+    };
+    return defaults;
+}
+
+bool ActivityEntry::resetForReuse()
+{
+    clearValues();
+    setValues(defaultValues());
+    return true;
+}
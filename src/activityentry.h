@@ -12,7 +12,12 @@ public:
     enum EnKey { name, iconRes, selected };
     Q_ENUM(EnKey)
 
-    explicit ActivityEntry(QObject *parent = nullptr) : KVListEntry(parent) {}
+    explicit ActivityEntry(QObject *parent = nullptr) : KVListEntry(parent) { setValues(defaultValues()); }
+
+    virtual KeyValueMap defaultValues() const override;
+
+    // activities are re-created often (see ActivityModel::processActivities())
+    virtual bool resetForReuse() override;
 };
 
 #endif // ACTIVITYENTRY_H
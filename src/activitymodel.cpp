@@ -1,4 +1,11 @@
 #include "activitymodel.h"
+#include <QCoreApplication>
+
+KVListEntryPool *ActivityModel::pool()
+{
+    static KVListEntryPool *pool_ = new KVListEntryPool(QCoreApplication::instance());
+    return pool_;
+}
 
 void ActivityModel::processActivities()
 {
@@ -116,7 +123,7 @@ void ActivityModel::processActivities()
 
         basename[0] = basename.front().toUpper();
 
-        ActivityEntry *e = new ActivityEntry(this);
+        ActivityEntry *e = pool()->acquire<ActivityEntry>(this);
         e->setValues({
                          { ActivityEntry::selected, false },
                          { ActivityEntry::name, basename },
@@ -138,10 +145,11 @@ void ActivityModel::processActivities()
     }
 
     beginResetModel();
-    // clear old ones
-    for(KVListEntry *e : entries_)
+    // clear old ones... they are reused by the next call
+    for(KVListEntry *e : entries_) {
         disconnectEntry(e);
-    qDeleteAll(entries_);
+        destroyEntry(e);
+    }
     entries_.clear();
 
     QMapIterator<QString, ActivityEntry*> i(tmpMap);
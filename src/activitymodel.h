@@ -3,6 +3,7 @@
 
 #include "kvlistmodel.h"
 #include "kvlistfilteredmodel.h"
+#include "kvlistentrypool.h"
 #include "activityentry.h"
 
 class ActivityModel : public KVListModel
@@ -10,8 +11,14 @@ class ActivityModel : public KVListModel
     Q_OBJECT
 
 public:
-    ActivityModel(QObject *parent=nullptr)  : KVListModel(QMetaEnum::fromType<ActivityEntry::EnKey>(), parent) {}
+    ActivityModel(QObject *parent=nullptr)  : KVListModel(QMetaEnum::fromType<ActivityEntry::EnKey>(), parent) { setEntryPool(pool()); }
     void processActivities();
+
+    // all activity models share their entries
+    static KVListEntryPool *pool();
+
+    // processActivities() re-creates all activities, only the selected ones need to be stored
+    virtual bool isDefaultEntry(const KVListEntry *entry) const override { return !entry->getValue(ActivityEntry::selected).toBool(); }
 private:
 };
 
@@ -0,0 +1,100 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+#include <QTemporaryDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDir>
+#include "friendsmodel.h"
+#include "activitymodel.h"
+#include "activityentry.h"
+#include "kvlistserializer.h"
+
+// kvlist_containerbench: writes the same generated FriendsModel as plain xml and as container (*.xml.kvlc)
+// and prints file size, save and load time of both
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    REGISTER_2_SERIALIZATION_FACTORY(FriendsModel);
+    REGISTER_2_SERIALIZATION_FACTORY(FriendsEntry);
+    REGISTER_2_SERIALIZATION_FACTORY(ActivityModel);
+    REGISTER_2_SERIALIZATION_FACTORY(ActivityEntry);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Compares file size and load time of xml and the KVList container");
+    parser.addHelpOption();
+    QCommandLineOption rows("rows", "number of generated rows", "n", "10000");
+    QCommandLineOption repeat("repeat", "load <n> times, the best time is reported", "n", "3");
+    parser.addOption(rows);
+    parser.addOption(repeat);
+    parser.process(app);
+
+    const int n = qMax(1, parser.value(rows).toInt());
+    const int runs = qMax(1, parser.value(repeat).toInt());
+
+    QTextStream out(stdout);
+    QTemporaryDir dir;
+    if(!dir.isValid()) {
+        out << "cannot create a temporary directory" << "\n";
+        return 1;
+    }
+
+    FriendsModel model;
+    const QDateTime now = QDateTime::currentDateTime();
+    QVector<KVListEntry*> entries;
+    entries.reserve(n);
+    for(int i=0; i<n; i++) {
+        const QString first = QString("First%1").arg(i);
+        const QString last = QString("Last%1").arg(i % 1000);
+        FriendsEntry *e = FriendsEntry::create({
+                                                   {FriendsEntry::firstname, first},
+                                                   {FriendsEntry::surname, last},
+                                                   {FriendsEntry::email, QString("%1.%2@example.com").arg(first, last)},
+                                                   {FriendsEntry::phonenumber, QString("+49 30 %1").arg(1000000 + i)},
+                                                   {FriendsEntry::lastseen, now.addSecs(-i * 60)},
+                                               });
+        // every third friend has chosen some activities
+        if(i % 3 == 0) {
+            KVListModel *activities = e->getChildModel(FriendsEntry::activitiesAll);
+            for(int a=0; a<activities->size(); a += 2)
+                activities->at(a)->setValue(ActivityEntry::selected, true);
+        }
+        entries << e;
+    }
+    model.appendEntries(entries);
+
+    out << n << " rows" << "\n";
+    for(const QString &suffix : { QString(".xml"), QString(".xml.kvlc") })
+    {
+        const QString file = QDir(dir.path()).filePath("friends" + suffix);
+
+        QElapsedTimer timer;
+        timer.start();
+        if(!model.serialize(file)) {
+            out << "cannot write " << file << "\n";
+            return 1;
+        }
+        const qint64 saveMs = timer.elapsed();
+
+        qint64 loadMs = -1;
+        for(int run=0; run<runs; run++) {
+            FriendsModel loaded;
+            timer.restart();
+            if(!loaded.deSerialize(file) || loaded.size() != n) {
+                out << "cannot read " << file << "\n";
+                return 1;
+            }
+            const qint64 ms = timer.elapsed();
+            loadMs = loadMs < 0 ? ms : qMin(loadMs, ms);
+        }
+
+        out << "  " << suffix.leftJustified(10)
+            << QString::number(QFileInfo(file).size()).rightJustified(12) << " bytes "
+            << QString::number(saveMs).rightJustified(8) << " ms save "
+            << QString::number(loadMs).rightJustified(8) << " ms load" << "\n";
+    }
+
+    return 0;
+}
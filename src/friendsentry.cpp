@@ -5,11 +5,11 @@
 #include <QDir>
 #include <QFileInfo>
 #include <QStandardPaths>
-#include <QImage>
+#include <QPointer>
 #include <QtGlobal>
+#include "logoprocessor.h"
 
 static const QUrl defaultLogo_("qrc:///qml/icons/default_user.png");
-static QString logoUrlTemplate_;
 
 FriendsEntry *FriendsEntry::create(const KVListEntry::KeyValueMap &initialValues, QObject *parent) {
     FriendsEntry *e = new FriendsEntry(parent);
@@ -17,12 +17,31 @@ FriendsEntry *FriendsEntry::create(const KVListEntry::KeyValueMap &initialValues
     return e;
 }
 
+KVListEntry::KeyValueMap FriendsEntry::defaultValues() const {
+    static const KeyValueMap defaults = {
+        {phonenumber, ""},
+        {address, ""},
+        {email, ""},
+        {logoURL, defaultLogo_},
+        {newlyCreatedEntry_ns, false},
+    };
+    return defaults;
+}
+
 int FriendsEntry::applyShadowedChanges() {
-    // in case a new logo has been set, we need to copy it first and then adjust the url
-    if(keyValueStoreShadowed_.contains(logoURL))
-        addNewLogo();
+    // in case a new logo has been set, we need to process it first; the url is set once that is done
+    // (counted as change nevertheless, the caller saves now and the new logo with the next save)
+    int cnt = 0;
+    if(keyValueStoreShadowed_.contains(logoURL)) {
+        QUrl url = keyValueStoreShadowed_[logoURL].toUrl();
+        if(url.isLocalFile()) {
+            keyValueStoreShadowed_.remove(logoURL);
+            addNewLogo(url.toLocalFile());
+            cnt++;
+        }
+    }
 
-    return KVListEntry::applyShadowedChanges();
+    return cnt + KVListEntry::applyShadowedChanges();
 }
 
 void FriendsEntry::updateLastSeenStatus(bool hasContact) {
@@ -65,63 +84,63 @@ void FriendsEntry::updateLastSeenStatus(bool hasContact) {
         }
     }
 
+    // the status of all friends is refreshed via the shared scheduler (one timer, batched updates)
     if(updateStatusInSecs < 0)
-        contactStatusUpdateTimer_->stop();
+        cancelScheduledUpdate(displayLastseen_ns);
     else
-        contactStatusUpdateTimer_->start(updateStatusInSecs * 1000);
+        scheduleUpdate(displayLastseen_ns, updateStatusInSecs * 1000, [this](){
+            updateLastSeenStatus(false);
+        });
 
     setValue(displayLastseen_ns, displayStr);
 }
 
 
-void FriendsEntry::addNewLogo()
-{
-    QString localFile = keyValueStoreShadowed_[logoURL].toUrl().toLocalFile();
-    QString newFile = QString(logoUrlTemplate_).arg(keyValueStore_[uid].toUuid().toString(QUuid::WithoutBraces));
-
-    // remove the old file, if there is any
-    QUrl urlOld = keyValueStore_[logoURL].toUrl();
-    if(urlOld.isLocalFile())
-        QFile::remove(urlOld.toLocalFile());
-
-    QImage img = cropImg(QImage(localFile));
-    img.save(newFile);
-
-    keyValueStoreShadowed_[logoURL] = QUrl::fromLocalFile(newFile);
-}
-
-QImage FriendsEntry::cropImg(const QImage &src) const
+void FriendsEntry::addNewLogo(const QString &localFile)
 {
-    int min = qMin(src.width(), src.height());
-    QRect r1(0,0, src.width(), src.height()), r2(0,0, min, min);
-    r2.moveCenter(r1.center());
-    QImage img = src.copy(r2);
-
-    if(img.width() > 512)
-        img = img.scaled(512, 512);
+    LogoProcessor *p = LogoProcessor::instance();
+    QString targetBase = QDir(p->logoDir()).filePath(keyValueStore_[uid].toUuid().toString(QUuid::WithoutBraces));
+
+    // decoding/scaling/encoding is done by the thread pool of the processor
+    int request = ++logoRequest_;
+    QPointer<FriendsEntry> self(this);
+    p->process(localFile, targetBase, [=](const QUrl &url){
+        // entry is gone (nobody else uses files named by its uid)
+        if(!self) {
+            if(url.isLocalFile())
+                QFile::remove(url.toLocalFile());
+            return;
+        }
 
-    return img;
+        QUrl current = self->getValue(logoURL).toUrl();
+        if(request == self->logoRequest_) {
+            self->logoDone_ = request;
+            if(!url.isEmpty()) {
+                if(current.isLocalFile())
+                    self->staleLogos_ << current.toLocalFile();
+                // marks the model as modified, its owner saves it
+                self->setValue(logoURL, url);
+                current = url;
+            }
+        }
+        // the user has chosen another logo in the meantime
+        else if(url.isLocalFile())
+            self->staleLogos_ << url.toLocalFile();
+
+        // as long as the latest logo is in progress, it may still end up in one of these files (same picture)
+        if(self->logoDone_ == self->logoRequest_) {
+            for(const QString &file : qAsConst(self->staleLogos_)) {
+                if(file != current.toLocalFile())
+                    QFile::remove(file);
+            }
+            self->staleLogos_.clear();
+        }
+    });
 }
 
 void FriendsEntry::init()
 {
-    if(logoUrlTemplate_.isEmpty()) {
-        QString loc = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
-        QDir d(loc);
-        d.mkpath("./logos");
-        d.cd("logos");
-
-        logoUrlTemplate_ = d.path() + QDir::separator() + "%1.png";
-    }
-
-    setValues({
-                  {phonenumber, ""},
-                  {address, ""},
-                  {email, ""},
-                  {phonenumber, ""},
-                  {logoURL, defaultLogo_},
-                  {newlyCreatedEntry_ns, false},
-              });
+    setValues(defaultValues());
 
     //each entry on creation should contain a uid
     setValue(uid, QUuid::createUuid());
@@ -149,25 +168,28 @@ void FriendsEntry::init()
 
 
     // prepare the last-seen status
-    contactStatusUpdateTimer_ = new QTimer(this);
-    contactStatusUpdateTimer_->setSingleShot(true);
-    connect(contactStatusUpdateTimer_, &QTimer::timeout, [this](){
-        updateLastSeenStatus(false);
-    });
     onValueChanged(lastseen, [=](){
         updateLastSeenStatus(false);
     });
     updateLastSeenStatus(false);
 
-    // add a activity submodel
-    ActivityModel * m = new ActivityModel(this);
-    m->processActivities();
-    setChildModel(activitiesAll, m);
+    // add a activity submodel... created once somebody needs it (e.g. the detail page or the deserializer)
+    setChildModelFactory(activitiesAll, [this](){
+        ActivityModel * m = new ActivityModel(this);
+        m->processActivities();
+        return m;
+    });
 
     // add a model that filters above (selected only)
-    KVListFilteredModel *fm = new KVListFilteredModel(m);
-    fm->setFilter({{ActivityEntry::selected, QVariantList() << true}});
-    setValue(activitiesSelected, QVariant::fromValue(fm));
+    setLazyValue(activitiesSelected, [this](){
+        KVListFilteredModel *fm = new KVListFilteredModel(getChildModel(activitiesAll));
+        fm->setFilter({{ActivityEntry::selected, QVariantList() << true}});
+        return QVariant::fromValue(fm);
+    });
+
+    // (de)selecting activities is a change of this entry (e.g. for the list and the serializer)
+    propagateChildChanges(activitiesAll);
+    propagateChildChanges(activitiesSelected);
 }
 
 
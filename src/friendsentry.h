@@ -3,8 +3,8 @@
 
 #include "kvlistentry.h"
 #include <QDateTime>
-#include <QTimer>
 #include <QUrl>
+#include <QStringList>
 #include "activitymodel.h"
 
 class FriendsEntry : public KVListEntry
@@ -26,14 +26,17 @@ public:
     // need to copy and process the logo first.. afterwards we simply store the updated url
     virtual int applyShadowedChanges() override;
 
+    virtual KeyValueMap defaultValues() const override;
+
     // call this function when we had contact to our friend here...
     Q_INVOKABLE void updateLastSeenStatus(bool hasContact);
 
 private:
-    void addNewLogo();
-    QImage cropImg(const QImage &src) const;
+    void addNewLogo(const QString &localFile);
     void init();
-    QTimer *contactStatusUpdateTimer_;
+    int logoRequest_ = 0, logoDone_ = 0;
+    // files of replaced / dropped logos, removed once no logo is in progress anymore
+    QStringList staleLogos_;
 };
 
 #endif // FRIENDSENTRY_H
@@ -1,22 +1,25 @@
 #include "friendsmodel.h"
 
-bool FriendsModel::deSerialize()
+void FriendsModel::entriesDeSerialized(int first, int last)
 {
-    bool res = KVListModel::deSerialize();
-
     // after deserialization we need to adjust the activities
     // activities have been loaded from xml.. need to merge those with the "available"
     // activities.. this allows us to later add more activities and not loose users choices then
     //
-    for(KVListEntry *e : *this) {
+    // called per batch when loading asynchronously
+    for(int i=first; i<=last; i++) {
+        KVListEntry *e = at(i);
+
+        // not loaded and not accessed yet... will be set up on first access
+        if(e->isLazy(FriendsEntry::activitiesAll))
+            continue;
+
         KVListModel *m = e->getChildModel(FriendsEntry::activitiesAll);
         Q_ASSERT(m);
         ActivityModel *m2 = dynamic_cast<ActivityModel*>(m);
         Q_ASSERT(m2);
         m2->processActivities();
     }
-
-    return res;
 }
 
 void FriendsModel::createDefaultValues()
@@ -2,6 +2,7 @@
 #define FRIENDSMODEL_H
 
 #include "kvlistmodel.h"
+#include "kvlisttextindex.h"
 #include "friendsentry.h"
 #include <QTimer>
 
@@ -11,10 +12,12 @@ class FriendsModel : public KVListModel
 
 public:
     // constructor
-    FriendsModel(QObject *parent=nullptr) : KVListModel(QMetaEnum::fromType<FriendsEntry::EnKey>(), parent) {}
-
-    // override the deSerialize function as wee need to make some adjustments afterwards
-    virtual bool deSerialize() override;
+    FriendsModel(QObject *parent=nullptr) : KVListModel(QMetaEnum::fromType<FriendsEntry::EnKey>(), parent) {
+        // live search (see KVListFilteredModel::setSearchText())
+        new KVListTextIndex(this, { FriendsEntry::firstname, FriendsEntry::surname, FriendsEntry::email });
+        // the "last seen" texts are refreshed by timers of all entries... no need to update the ui for every single one
+        setNotifyInterval(250, { FriendsEntry::lastseen, FriendsEntry::displayLastseen_ns });
+    }
 
     Q_INVOKABLE int addNewEntry() {
         // some default values when the user clicks 'add' button
@@ -29,6 +32,10 @@ public:
     }
 
     void createDefaultValues();
+
+protected:
+    // deserialized entries need some adjustments afterwards
+    void entriesDeSerialized(int first, int last) override;
 };
 
 #endif // FRIENDSMODEL_H
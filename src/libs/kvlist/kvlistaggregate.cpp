@@ -0,0 +1,257 @@
+#include "kvlistaggregate.h"
+#include <QDebug>
+
+KVListAggregate::KVListAggregate(QObject *parent) :
+    QObject(parent)
+{
+}
+
+KVListAggregate::KVListAggregate(KVListModel *model, Type type, KVListEntry::Key key, const KVListFilterExpression &filter) :
+    QObject(model),
+    type_(type),
+    key_(key),
+    filter_(filter),
+    filterKeys_(filter_.keys())
+{
+    Q_ASSERT(model);
+    if(key >= 0)
+        keyName_ = QString::fromUtf8(model->roleNames().value(key));
+    setModel(model);
+}
+
+KVListAggregate::~KVListAggregate()
+{
+    if(model_)
+        model_->removeObserver(this);
+}
+
+void KVListAggregate::setModel(KVListModel *model)
+{
+    if(model_ == model)
+        return;
+
+    if(model_) {
+        model_->removeObserver(this);
+        disconnect(model_, nullptr, this, nullptr);
+    }
+
+    model_ = model;
+
+    if(model_) {
+        model_->addObserver(this);
+        resolveKeyName();
+        resolveFilterMap();
+    }
+
+    refresh();
+    emit modelChanged();
+}
+
+void KVListAggregate::setType(Type type)
+{
+    if(type_ == type)
+        return;
+    type_ = type;
+    refresh();
+    emit typeChanged();
+}
+
+void KVListAggregate::setKey(KVListEntry::Key key)
+{
+    if(key_ == key)
+        return;
+    key_ = key;
+    keyName_ = model_ ? QString::fromUtf8(model_->roleNames().value(key)) : QString();
+    refresh();
+    emit keyChanged();
+}
+
+void KVListAggregate::setKeyName(const QString &name)
+{
+    if(keyName_ == name)
+        return;
+    keyName_ = name;
+    resolveKeyName();
+    refresh();
+    emit keyChanged();
+}
+
+void KVListAggregate::setFilter(const KVListFilterExpression &filter)
+{
+    filter_ = KVListFilterPlan(filter);
+    filterKeys_ = filter_.keys();
+    filterMap_.clear();
+    refresh();
+    emit filterChanged();
+}
+
+void KVListAggregate::setFilterMap(const QVariantMap &filter)
+{
+    filterMap_ = filter;
+    resolveFilterMap();
+    refresh();
+    emit filterChanged();
+}
+
+QVariant KVListAggregate::result() const
+{
+    switch(type_) {
+    case Count:
+        return contributions_.size();
+    case Sum:
+        return sum_;
+    case Min:
+        return values_.empty() ? QVariant() : values_.begin()->first;
+    case Max:
+        return values_.empty() ? QVariant() : values_.rbegin()->first;
+    case DistinctCount:
+        return int(values_.size());
+    }
+    return QVariant();
+}
+
+void KVListAggregate::refresh()
+{
+    QVariant oldResult = result();
+    int oldCount = count();
+
+    contributions_.clear();
+    values_.clear();
+    sum_ = 0;
+
+    if(model_) {
+        contributions_.reserve(model_->size());
+        for(const KVListEntry *e : qAsConst(*model_))
+            add(e);
+    }
+
+    notify(oldResult, oldCount);
+}
+
+void KVListAggregate::entryInserted(KVListModel * /*model*/, int /*row*/, KVListEntry *entry)
+{
+    QVariant oldResult = result();
+    int oldCount = count();
+    add(entry);
+    notify(oldResult, oldCount);
+}
+
+void KVListAggregate::entryAboutToBeRemoved(KVListModel * /*model*/, int /*row*/, KVListEntry *entry)
+{
+    QVariant oldResult = result();
+    int oldCount = count();
+    remove(entry);
+    notify(oldResult, oldCount);
+}
+
+void KVListAggregate::modelReset(KVListModel * /*model*/)
+{
+    refresh();
+}
+
+void KVListAggregate::valueChanged(KVListModel * /*model*/, KVListEntry *entry, KVListEntry::Key key,
+                                   const QVariant & /*oldValue*/, const QVariant & /*newValue*/)
+{
+    if(key != key_ && !filterKeys_.contains(key))
+        return;
+
+    QVariant oldResult = result();
+    int oldCount = count();
+    remove(entry);
+    add(entry);
+    notify(oldResult, oldCount);
+}
+
+void KVListAggregate::add(const KVListEntry *entry)
+{
+    if(!filter_.matches(entry))
+        return;
+
+    QVariant v = key_ >= 0 ? entry->getValue(key_) : QVariant();
+    contributions_.insert(entry, v);
+    addValue(v);
+}
+
+void KVListAggregate::remove(const KVListEntry *entry)
+{
+    auto i = contributions_.find(entry);
+    if(i == contributions_.end())
+        return;
+
+    removeValue(i.value());
+    contributions_.erase(i);
+}
+
+void KVListAggregate::addValue(const QVariant &v)
+{
+    if(!v.isValid() || v.isNull())
+        return;
+
+    switch(type_) {
+    case Sum:
+        sum_ += v.toDouble();
+        break;
+    case Min:
+    case Max:
+    case DistinctCount:
+        values_[v]++;
+        break;
+    default:
+        break;
+    }
+}
+
+void KVListAggregate::removeValue(const QVariant &v)
+{
+    if(!v.isValid() || v.isNull())
+        return;
+
+    switch(type_) {
+    case Sum:
+        sum_ -= v.toDouble();
+        break;
+    case Min:
+    case Max:
+    case DistinctCount: {
+        auto i = values_.find(v);
+        if(i != values_.end() && --i->second == 0)
+            values_.erase(i);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void KVListAggregate::notify(const QVariant &oldResult, int oldCount)
+{
+    if(result() != oldResult)
+        emit resultChanged();
+    if(count() != oldCount)
+        emit countChanged();
+}
+
+void KVListAggregate::resolveKeyName()
+{
+    if(!model_ || keyName_.isEmpty())
+        return;
+
+    key_ = model_->roleNames().key(keyName_.toUtf8(), -1);
+    if(key_ < 0)
+        qWarning(kvlist) << "aggregate: unknown key" << keyName_;
+}
+
+void KVListAggregate::resolveFilterMap()
+{
+    if(!model_ || filterMap_.isEmpty())
+        return;
+
+    QString error;
+    KVListFilterExpression e = KVListFilterExpression::fromVariant(filterMap_, model_->roleNames(), &error);
+    if(!error.isEmpty()) {
+        qWarning(kvlist) << "aggregate: invalid filter expression:" << error;
+        return;
+    }
+    filter_ = KVListFilterPlan(e);
+    filterKeys_ = filter_.keys();
+}
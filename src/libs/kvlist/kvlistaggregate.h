@@ -0,0 +1,131 @@
+#ifndef KVLISTAGGREGATE_H
+#define KVLISTAGGREGATE_H
+
+#include <QObject>
+#include <QPointer>
+#include <QHash>
+#include <QSet>
+#include <QVariant>
+#include <map>
+#include "kvlistentry.h"
+#include "kvlistmodel.h"
+#include "kvlistmodelobserver.h"
+#include "kvlistfilterexpression.h"
+#include "kvlist_global.h"
+
+/**
+ * @brief The KVListAggregate class
+ *
+ * Count, sum, min, max or number of distinct values of a key over all entries of a KVListModel
+ * (optionally only over entries matching a KVListFilterExpression).
+ *
+ * The value is maintained incrementally via KVListModelObserver: inserting, removing or
+ * modifying an entry only re-evaluates that entry (O(1) for count/sum, O(log n) for
+ * min/max/distinct). Only a model reset re-evaluates all entries.
+ *
+ * <code>
+ * typedef KVListFilterExpression F;
+ * KVListAggregate *selected = new KVListAggregate(activities, KVListAggregate::Count, -1,
+ *                                                 F::equals(ActivityEntry::selected, true));
+ * KVListAggregate *oldest = new KVListAggregate(addressbook, KVListAggregate::Max, Person::age);
+ * </code>
+ *
+ * From QML (after qmlRegisterType<KVListAggregate>()):
+ * <code>
+ * KVListAggregate { id: selectedCount; model: activities; type: KVListAggregate.Count; filter: { key: "selected", op: "==", value: true } }
+ * Text { text: selectedCount.result + " selected" }
+ * </code>
+ *
+ * Notes:
+ * - shadowed values are not taken into account
+ * - null/invalid values are ignored by Sum, Min, Max and DistinctCount; Count counts matching entries
+ * - filters relative to the current time are evaluated when an entry changes; call refresh() to re-evaluate all
+ */
+class KVLIST_EXPORT KVListAggregate : public QObject, public KVListModelObserver
+{
+    Q_OBJECT
+    Q_PROPERTY(KVListModel* model READ model WRITE setModel NOTIFY modelChanged)
+    Q_PROPERTY(Type type READ type WRITE setType NOTIFY typeChanged)
+    Q_PROPERTY(QString keyName READ keyName WRITE setKeyName NOTIFY keyChanged)
+    Q_PROPERTY(QVariantMap filter READ filterMap WRITE setFilterMap NOTIFY filterChanged)
+    Q_PROPERTY(QVariant result READ result NOTIFY resultChanged)
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+
+public:
+    enum Type { Count, Sum, Min, Max, DistinctCount };
+    Q_ENUM(Type)
+
+    explicit KVListAggregate(QObject *parent = nullptr);
+    // the aggregate is owned by the model
+    KVListAggregate(KVListModel *model, Type type, KVListEntry::Key key = -1,
+                    const KVListFilterExpression &filter = KVListFilterExpression());
+    virtual ~KVListAggregate();
+
+    KVListModel *model() const { return model_; }
+    void setModel(KVListModel *model);
+
+    Type type() const { return type_; }
+    void setType(Type type);
+
+    KVListEntry::Key key() const { return key_; }
+    void setKey(KVListEntry::Key key);
+    QString keyName() const { return keyName_; }
+    void setKeyName(const QString &name);
+
+    void setFilter(const KVListFilterExpression &filter);
+    QVariantMap filterMap() const { return filterMap_; }
+    void setFilterMap(const QVariantMap &filter);
+
+    // result of the aggregation (int for Count/DistinctCount, double for Sum, the value itself for Min/Max)
+    QVariant result() const;
+    // number of entries matching the filter
+    int count() const { return contributions_.size(); }
+
+    // re-evaluate all entries
+    Q_INVOKABLE void refresh();
+
+signals:
+    void modelChanged();
+    void typeChanged();
+    void keyChanged();
+    void filterChanged();
+    void resultChanged();
+    void countChanged();
+
+protected:
+    // KVListModelObserver
+    void entryInserted(KVListModel *model, int row, KVListEntry *entry) override;
+    void entryAboutToBeRemoved(KVListModel *model, int row, KVListEntry *entry) override;
+    void valueChanged(KVListModel *model, KVListEntry *entry, KVListEntry::Key key,
+                      const QVariant &oldValue, const QVariant &newValue) override;
+    void modelReset(KVListModel *model) override;
+
+private:
+    struct Less {
+        bool operator()(const QVariant &a, const QVariant &b) const { return KVListModel::compareValues(a, b) < 0; }
+    };
+
+    void add(const KVListEntry *entry);
+    void remove(const KVListEntry *entry);
+    void addValue(const QVariant &v);
+    void removeValue(const QVariant &v);
+    void notify(const QVariant &oldResult, int oldCount);
+    void resolveKeyName();
+    void resolveFilterMap();
+
+    QPointer<KVListModel> model_;
+    Type type_ = Count;
+    KVListEntry::Key key_ = -1;
+    QString keyName_;
+    KVListFilterPlan filter_;
+    QSet<KVListEntry::Key> filterKeys_;
+    QVariantMap filterMap_;
+
+    // value each matching entry contributes
+    QHash<const KVListEntry*, QVariant> contributions_;
+    double sum_ = 0;
+    // value -> number of entries having it (min/max/distinct)
+    std::map<QVariant, int, Less> values_;
+};
+
+#endif // KVLISTAGGREGATE_H
@@ -0,0 +1,227 @@
+#include "kvlistblobstore.h"
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QStandardPaths>
+#include <QDataStream>
+#include <QDirIterator>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDebug>
+#include <climits>
+
+static KVListBlobStore *instance_ = nullptr;
+
+// default size of the cache of loaded blobs
+static const qint64 CACHE_SIZE = 32*1024*1024;
+
+static void registerBlobType()
+{
+    KVListBlob::registerType();
+}
+Q_COREAPP_STARTUP_FUNCTION(registerBlobType)
+
+
+KVListBlob KVListBlob::fromData(const QByteArray &data)
+{
+    return KVListBlob(KVListBlobStore::instance()->put(data));
+}
+
+QByteArray KVListBlob::data() const
+{
+    return isNull() ? QByteArray() : KVListBlobStore::instance()->get(hash_);
+}
+
+qint64 KVListBlob::size() const
+{
+    return isNull() ? 0 : KVListBlobStore::instance()->size(hash_);
+}
+
+QUrl KVListBlob::url() const
+{
+    const QString path = isNull() ? QString() : KVListBlobStore::instance()->filePath(hash_);
+    return path.isEmpty() ? QUrl() : QUrl::fromLocalFile(path);
+}
+
+void KVListBlob::registerType()
+{
+    static bool registered = false;
+    if(registered)
+        return;
+    registered = true;
+
+    qRegisterMetaType<KVListBlob>();
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    qRegisterMetaTypeStreamOperators<KVListBlob>();
+    QMetaType::registerComparators<KVListBlob>();
+#endif
+    // the xml serializer stores values as strings: the hash
+    QMetaType::registerConverter<KVListBlob, QString>(&KVListBlob::hash);
+    QMetaType::registerConverter<QString, KVListBlob>([](const QString &hash) { return KVListBlob(hash); });
+}
+
+QDataStream &operator<<(QDataStream &out, const KVListBlob &blob)
+{
+    return out << blob.hash();
+}
+
+QDataStream &operator>>(QDataStream &in, KVListBlob &blob)
+{
+    QString hash;
+    in >> hash;
+    blob = KVListBlob(hash);
+    return in;
+}
+
+
+KVListBlobStore::KVListBlobStore(const QString &directory, QObject *parent) :
+    QObject(parent),
+    directory_(directory)
+{
+    KVListBlob::registerType();
+    cache_.setMaxCost(int(qMin<qint64>(CACHE_SIZE, INT_MAX)));
+    if(!QDir().mkpath(directory_))
+        qWarning(kvlist) << "blob store: cannot create" << directory_;
+}
+
+KVListBlobStore::~KVListBlobStore()
+{
+    if(instance_ == this)
+        instance_ = nullptr;
+}
+
+KVListBlobStore *KVListBlobStore::instance()
+{
+    if(!instance_) {
+        QString dir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+        instance_ = new KVListBlobStore(QDir(dir).filePath("blobs"), QCoreApplication::instance());
+    }
+    return instance_;
+}
+
+void KVListBlobStore::setInstance(KVListBlobStore *store)
+{
+    instance_ = store;
+}
+
+bool KVListBlobStore::isValidHash(const QString &hash)
+{
+    if(hash.size() != 64)
+        return false;
+    for(const QChar c : hash) {
+        if(!((c >= QLatin1Char('0') && c <= QLatin1Char('9')) || (c >= QLatin1Char('a') && c <= QLatin1Char('f'))))
+            return false;
+    }
+    return true;
+}
+
+QString KVListBlobStore::filePath(const QString &hash) const
+{
+    // never a path outside the store (e.g. "../..")
+    if(!isValidHash(hash)) {
+        qWarning(kvlist) << "blob store: invalid hash" << hash;
+        return QString();
+    }
+
+    // two levels, so that no directory gets too many files
+    return directory_ + QLatin1Char('/') + hash.left(2) + QLatin1Char('/') + hash.mid(2);
+}
+
+QString KVListBlobStore::put(const QByteArray &data)
+{
+    const QString hash = QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex());
+    const QString path = filePath(hash);
+
+    // same content, same file... already there
+    if(QFileInfo::exists(path))
+        return hash;
+
+    QDir().mkpath(QFileInfo(path).path());
+    QSaveFile file(path);
+    if(!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        qWarning(kvlist) << "blob store: cannot write" << path << file.errorString();
+        return QString();
+    }
+
+    QMutexLocker lock(&mutex_);
+    cache_.insert(hash, new QByteArray(data), data.size());
+    return hash;
+}
+
+QByteArray KVListBlobStore::get(const QString &hash)
+{
+    if(!isValidHash(hash)) {
+        qWarning(kvlist) << "blob store: invalid hash" << hash;
+        return QByteArray();
+    }
+
+    {
+        QMutexLocker lock(&mutex_);
+        if(QByteArray *data = cache_.object(hash))
+            return *data;
+    }
+
+    QFile file(filePath(hash));
+    if(!file.open(QIODevice::ReadOnly)) {
+        qWarning(kvlist) << "blob store: missing blob" << hash;
+        return QByteArray();
+    }
+    QByteArray data = file.readAll();
+
+    QMutexLocker lock(&mutex_);
+    cache_.insert(hash, new QByteArray(data), data.size());
+    return data;
+}
+
+bool KVListBlobStore::contains(const QString &hash) const
+{
+    return isValidHash(hash) && QFileInfo::exists(filePath(hash));
+}
+
+qint64 KVListBlobStore::size(const QString &hash) const
+{
+    const QString path = filePath(hash);
+    return path.isEmpty() ? 0 : QFileInfo(path).size();
+}
+
+bool KVListBlobStore::remove(const QString &hash)
+{
+    const QString path = filePath(hash);
+    if(path.isEmpty())
+        return false;
+
+    {
+        QMutexLocker lock(&mutex_);
+        cache_.remove(hash);
+    }
+    return QFile::remove(path);
+}
+
+int KVListBlobStore::collectGarbage(const QSet<QString> &used)
+{
+    int removed = 0;
+    QDirIterator it(directory_, QDir::Files, QDirIterator::Subdirectories);
+    while(it.hasNext()) {
+        const QString path = it.next();
+        const QFileInfo info(path);
+        const QString hash = info.dir().dirName() + info.fileName();
+        // not ours (e.g. a temporary file of a put() in progress)
+        if(!isValidHash(hash))
+            continue;
+        if(!used.contains(hash) && remove(hash))
+            removed++;
+    }
+    return removed;
+}
+
+qint64 KVListBlobStore::cacheSize() const
+{
+    QMutexLocker lock(&mutex_);
+    return cache_.maxCost();
+}
+
+void KVListBlobStore::setCacheSize(qint64 bytes)
+{
+    QMutexLocker lock(&mutex_);
+    cache_.setMaxCost(int(qBound<qint64>(0, bytes, INT_MAX)));
+}
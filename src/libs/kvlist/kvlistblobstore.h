@@ -0,0 +1,127 @@
+#ifndef KVLISTBLOBSTORE_H
+#define KVLISTBLOBSTORE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <QUrl>
+#include <QSet>
+#include <QCache>
+#include <QMutex>
+#include <QMetaType>
+#include "kvlist_global.h"
+
+/**
+ * @brief The KVListBlob class
+ *
+ * Handle of a large value kept in the KVListBlobStore instead of the entry: only the content
+ * hash is stored as value, the data is loaded on first access (and cached).
+ *
+ * Serializers (xml, trace, replication, containers) write the hash, never the data.
+ *
+ * <code>
+ * entry->setBlob(Person::photo, jpegBytes);      // small data stays inline
+ * QByteArray jpeg = entry->getBlob(Person::photo);
+ * </code>
+ *
+ * From QML the file can be used directly: Image { source: model.photo.url }
+ */
+class KVLIST_EXPORT KVListBlob
+{
+    Q_GADGET
+    Q_PROPERTY(QString hash READ hash)
+    Q_PROPERTY(QUrl url READ url)
+
+public:
+    KVListBlob() = default;
+    explicit KVListBlob(const QString &hash) : hash_(hash) {}
+
+    // put 'data' into the store; null in case it could not be stored (see KVListBlobStore::put())
+    static KVListBlob fromData(const QByteArray &data);
+
+    bool isNull() const { return hash_.isEmpty(); }
+    QString hash() const { return hash_; }
+
+    QByteArray data() const;
+    qint64 size() const;
+    QUrl url() const;
+
+    bool operator==(const KVListBlob &other) const { return hash_ == other.hash_; }
+    bool operator!=(const KVListBlob &other) const { return hash_ != other.hash_; }
+    bool operator<(const KVListBlob &other) const { return hash_ < other.hash_; }
+
+    // metatype, comparison, string conversion and stream operators (done on startup)
+    static void registerType();
+
+private:
+    QString hash_;
+};
+
+Q_DECLARE_METATYPE(KVListBlob)
+
+QDataStream &operator<<(QDataStream &out, const KVListBlob &blob);
+QDataStream &operator>>(QDataStream &in, KVListBlob &blob);
+
+
+/**
+ * @brief The KVListBlobStore class
+ *
+ * Content addressed storage of large values in a local directory: the file name is the SHA-256 of
+ * the data, so equal data is stored once. Files are written atomically and never modified.
+ * Loaded data is kept in a LRU cache bounded by 'cacheSize' bytes.
+ *
+ * Blobs are not reference counted; collectGarbage() removes the ones which are not in use anymore.
+ * The store does not know its users: whoever owns the models (the application) calls it with the
+ * union of KVListModel::usedBlobs() of all models using the store, while all of them are loaded.
+ *
+ * Hashes come from files and peers: anything but 64 lowercase hex digits is rejected.
+ *
+ * Notes:
+ * - thread safe
+ * - the library only depends on QtCore: images are stored as encoded data (e.g. png/jpeg bytes)
+ */
+class KVLIST_EXPORT KVListBlobStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    // data smaller than this stays inline (see KVListEntry::setBlob())
+    static const int InlineLimit = 4096;
+
+    explicit KVListBlobStore(const QString &directory, QObject *parent = nullptr);
+    virtual ~KVListBlobStore();
+
+    // the shared store (<AppLocalDataLocation>/blobs unless setInstance() has been called before,
+    // created on first use, owned by the application object)
+    static KVListBlobStore *instance();
+    static void setInstance(KVListBlobStore *store);
+
+    QString directory() const { return directory_; }
+
+    // 64 lowercase hex digits (SHA-256)
+    static bool isValidHash(const QString &hash);
+
+    // store 'data'; returns its hash (empty on errors)
+    QString put(const QByteArray &data);
+    // data of a blob; empty if it does not exist
+    QByteArray get(const QString &hash);
+
+    bool contains(const QString &hash) const;
+    qint64 size(const QString &hash) const;
+    // empty for invalid hashes
+    QString filePath(const QString &hash) const;
+    bool remove(const QString &hash);
+
+    // remove all blobs not contained in 'used'; returns the number of removed blobs
+    int collectGarbage(const QSet<QString> &used);
+
+    qint64 cacheSize() const;
+    void setCacheSize(qint64 bytes);
+
+private:
+    QString directory_;
+    mutable QMutex mutex_;
+    QCache<QString, QByteArray> cache_;
+};
+
+#endif // KVLISTBLOBSTORE_H
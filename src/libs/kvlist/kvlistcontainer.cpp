@@ -0,0 +1,292 @@
+#include "kvlistcontainer.h"
+#include "kvlistparallel.h"
+#include <QDataStream>
+#include <QIODevice>
+#include <QPair>
+#include <cstring>
+
+static const char MAGIC[4] = { 'K', 'V', 'L', 'C' };
+static const quint16 FORMAT_VERSION = 1;
+static const QDataStream::Version STREAM_VERSION = QDataStream::Qt_5_0;
+
+
+static QVector<quint32> createCrcTable()
+{
+    QVector<quint32> table(256);
+    for(quint32 i=0; i<256; i++) {
+        quint32 c = i;
+        for(int k=0; k<8; k++)
+            c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+        table[i] = c;
+    }
+    return table;
+}
+
+quint32 KVListContainer::crc32(const char *data, int len, quint32 crc)
+{
+    static const QVector<quint32> table = createCrcTable();
+    const quint32 *t = table.constData();
+
+    crc = ~crc;
+    for(int i=0; i<len; i++)
+        crc = t[(crc ^ uchar(data[i])) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+QByteArray KVListContainer::pack(const QString &format, const QVector<QByteArray> &blocks, Codec codec, int chunkSize, int level)
+{
+    // group the blocks into chunks (first block, number of blocks); a block is never split
+    QVector<QPair<int, int>> ranges;
+    int first = 0, size = 0;
+    for(int i=0; i<blocks.size(); i++) {
+        if(i > first && size + blocks[i].size() > chunkSize) {
+            ranges << qMakePair(first, i - first);
+            first = i;
+            size = 0;
+        }
+        size += blocks[i].size();
+    }
+    if(first < blocks.size())
+        ranges << qMakePair(first, blocks.size() - first);
+
+    // compress the chunks in parallel
+    QVector<QByteArray> stored(ranges.size());
+    QVector<Chunk> chunks(ranges.size());
+    QByteArray *storedOut = stored.data();
+    Chunk *chunkOut = chunks.data();
+    const QVector<QPair<int, int>> &r = ranges;
+    KVListParallel::forEach(ranges.size(), [&](int c){
+        QByteArray raw;
+        for(int i = r[c].first; i < r[c].first + r[c].second; i++)
+            raw += blocks[i];
+
+        QByteArray &out = storedOut[c];
+        out = (codec == Zlib) ? qCompress(raw, level) : raw;
+
+        chunkOut[c].firstBlock = r[c].first;
+        chunkOut[c].rawSize = raw.size();
+        chunkOut[c].storedSize = out.size();
+        chunkOut[c].crc = crc32(out.constData(), out.size());
+    }, 1);
+
+    quint64 offset = 0;
+    for(Chunk &c : chunks) {
+        c.offset = offset;
+        offset += c.storedSize;
+    }
+
+    // header & index
+    QByteArray header;
+    {
+        QDataStream ds(&header, QIODevice::WriteOnly);
+        ds.setVersion(STREAM_VERSION);
+        ds.writeRawData(MAGIC, sizeof(MAGIC));
+        ds << FORMAT_VERSION << quint8(codec) << format;
+
+        ds << quint32(chunks.size());
+        for(const Chunk &c : chunks)
+            ds << c.offset << c.storedSize << c.rawSize << c.crc << c.firstBlock;
+
+        ds << quint32(blocks.size());
+        for(const QByteArray &b : blocks)
+            ds << quint32(b.size());
+    }
+
+    QByteArray data;
+    data.reserve(header.size() + int(sizeof(quint32)) + int(offset));
+    data += header;
+    {
+        QDataStream ds(&data, QIODevice::WriteOnly | QIODevice::Append);
+        ds << crc32(header.constData(), header.size());
+    }
+    for(const QByteArray &s : stored)
+        data += s;
+
+    return data;
+}
+
+bool KVListContainer::open(const QByteArray &data)
+{
+    isOpen_ = false;
+    data_ = data;
+    format_.clear();
+    chunks_.clear();
+    blockSizes_.clear();
+    errorString_.clear();
+
+    QDataStream ds(data);
+    ds.setVersion(STREAM_VERSION);
+
+    char magic[sizeof(MAGIC)];
+    if(ds.readRawData(magic, sizeof(MAGIC)) != int(sizeof(MAGIC)) || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+        errorString_ = "not a kvlist container";
+        return false;
+    }
+
+    quint16 version;
+    quint8 codec;
+    ds >> version >> codec >> format_;
+    if(version != FORMAT_VERSION) {
+        errorString_ = QString("unsupported container version %1").arg(version);
+        return false;
+    }
+    if(codec != NoCompression && codec != Zlib) {
+        errorString_ = QString("unsupported codec %1").arg(codec);
+        return false;
+    }
+    codec_ = Codec(codec);
+
+    // each index record takes more than one byte... protects from allocating nonsense
+    quint32 chunkCount;
+    ds >> chunkCount;
+    if(ds.status() != QDataStream::Ok || chunkCount > quint32(data.size())) {
+        errorString_ = "corrupt container index";
+        return false;
+    }
+    chunks_.resize(int(chunkCount));
+    for(Chunk &c : chunks_)
+        ds >> c.offset >> c.storedSize >> c.rawSize >> c.crc >> c.firstBlock;
+
+    quint32 blockCount;
+    ds >> blockCount;
+    if(ds.status() != QDataStream::Ok || blockCount > quint32(data.size())) {
+        errorString_ = "corrupt container index";
+        return false;
+    }
+    blockSizes_.resize(int(blockCount));
+    for(quint32 &s : blockSizes_)
+        ds >> s;
+
+    qint64 headerSize = ds.device()->pos();
+    quint32 crc;
+    ds >> crc;
+    if(ds.status() != QDataStream::Ok || crc != crc32(data.constData(), int(headerSize))) {
+        errorString_ = "corrupt container index (checksum mismatch)";
+        return false;
+    }
+    dataStart_ = ds.device()->pos();
+
+    for(int i=0; i<chunks_.size(); i++) {
+        const Chunk &c = chunks_[i];
+        if(quint64(dataStart_) + c.offset + c.storedSize > quint64(data.size()) || c.firstBlock > blockCount) {
+            errorString_ = QString("chunk %1 exceeds the container").arg(i);
+            return false;
+        }
+    }
+
+    isOpen_ = true;
+    return true;
+}
+
+bool KVListContainer::decodeChunk(int i, QByteArray &raw, QString &error) const
+{
+    if(!isOpen_ || i < 0 || i >= chunks_.size()) {
+        error = QString("invalid chunk %1").arg(i);
+        return false;
+    }
+
+    const Chunk &c = chunks_.at(i);
+    const char *stored = data_.constData() + dataStart_ + c.offset;
+
+    // check before decompressing: corrupt input must never reach the codec
+    if(crc32(stored, int(c.storedSize)) != c.crc) {
+        error = QString("chunk %1 is corrupt (checksum mismatch)").arg(i);
+        return false;
+    }
+
+    if(codec_ == Zlib)
+        raw = qUncompress(reinterpret_cast<const uchar*>(stored), int(c.storedSize));
+    else
+        raw = QByteArray(stored, int(c.storedSize));
+
+    if(quint32(raw.size()) != c.rawSize) {
+        error = QString("chunk %1 has an unexpected size").arg(i);
+        return false;
+    }
+    return true;
+}
+
+QByteArray KVListContainer::chunk(int i, bool *ok) const
+{
+    QByteArray raw;
+    bool res = decodeChunk(i, raw, errorString_);
+    if(ok)
+        *ok = res;
+    return res ? raw : QByteArray();
+}
+
+int KVListContainer::chunkOfBlock(int block) const
+{
+    // chunks are sorted by their first block
+    int lo = 0, hi = chunks_.size() - 1, res = -1;
+    while(lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if(chunks_[mid].firstBlock <= quint32(block)) {
+            res = mid;
+            lo = mid + 1;
+        } else
+            hi = mid - 1;
+    }
+    return res;
+}
+
+QByteArray KVListContainer::block(int i, bool *ok) const
+{
+    if(ok)
+        *ok = false;
+
+    int c = (i >= 0 && i < blockSizes_.size()) ? chunkOfBlock(i) : -1;
+    if(c < 0) {
+        errorString_ = QString("invalid block %1").arg(i);
+        return QByteArray();
+    }
+
+    QByteArray raw;
+    if(!decodeChunk(c, raw, errorString_))
+        return QByteArray();
+
+    int offset = 0;
+    for(int b = int(chunks_[c].firstBlock); b < i; b++)
+        offset += int(blockSizes_[b]);
+
+    if(offset + int(blockSizes_[i]) > raw.size()) {
+        errorString_ = QString("block %1 exceeds its chunk").arg(i);
+        return QByteArray();
+    }
+
+    if(ok)
+        *ok = true;
+    return raw.mid(offset, int(blockSizes_[i]));
+}
+
+QByteArray KVListContainer::readAll(bool *ok) const
+{
+    if(ok)
+        *ok = false;
+
+    QVector<QByteArray> raw(chunks_.size());
+    QVector<QString> errors(chunks_.size());
+    QByteArray *rawOut = raw.data();
+    QString *errorOut = errors.data();
+    KVListParallel::forEach(chunks_.size(), [&](int i){
+        decodeChunk(i, rawOut[i], errorOut[i]);
+    }, 1);
+
+    int size = 0;
+    for(int i=0; i<errors.size(); i++) {
+        if(!errors[i].isEmpty()) {
+            errorString_ = errors[i];
+            return QByteArray();
+        }
+        size += raw[i].size();
+    }
+
+    QByteArray data;
+    data.reserve(size);
+    for(const QByteArray &r : raw)
+        data += r;
+
+    if(ok)
+        *ok = true;
+    return data;
+}
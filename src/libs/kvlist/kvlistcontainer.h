@@ -0,0 +1,83 @@
+#ifndef KVLISTCONTAINER_H
+#define KVLISTCONTAINER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include "kvlist_global.h"
+
+/**
+ * @brief The KVListContainer class
+ *
+ * Chunked, compressed container for serialized models. Any KVListSerializer backend can write
+ * into it (see KVListSerializer::serializeToContainer()).
+ *
+ * The blocks handed out by KVListSerializer::serializeToBlocks() are packed into chunks of
+ * roughly 'chunkSize' bytes; a block is never split. Every chunk is compressed on its own and
+ * carries a CRC32 of its stored bytes, so chunks can be decompressed in parallel, corrupt
+ * chunks are detected before decompressing them and a single block can be read without
+ * touching the other chunks.
+ *
+ * Layout (QDataStream, big endian):
+ * <code>
+ * "KVLC" | quint16 version | quint8 codec | QString format
+ * quint32 chunkCount  | chunkCount * { quint64 offset, quint32 storedSize, quint32 rawSize, quint32 crc, quint32 firstBlock }
+ * quint32 blockCount  | blockCount * { quint32 rawSize }
+ * quint32 crc of everything above
+ * chunk data
+ * </code>
+ * Chunk offsets are relative to the start of the chunk data.
+ */
+class KVLIST_EXPORT KVListContainer
+{
+public:
+    enum Codec { NoCompression = 0, Zlib = 1 };
+
+    struct Chunk {
+        quint64 offset = 0;     // position of the stored bytes within the chunk data
+        quint32 storedSize = 0;
+        quint32 rawSize = 0;
+        quint32 crc = 0;        // crc32 of the stored (compressed) bytes
+        quint32 firstBlock = 0;
+    };
+
+    // pack the blocks into a new container; 'level' is passed to qCompress()
+    static QByteArray pack(const QString &format, const QVector<QByteArray> &blocks,
+                           Codec codec = Zlib, int chunkSize = 256*1024, int level = -1);
+
+    // parse header and index; the data is kept (implicitly shared) until the next open()
+    bool open(const QByteArray &data);
+    bool isOpen() const { return isOpen_; }
+
+    QString format() const { return format_; }
+    Codec codec() const { return codec_; }
+    int chunkCount() const { return chunks_.size(); }
+    int blockCount() const { return blockSizes_.size(); }
+    const Chunk &chunkInfo(int i) const { return chunks_.at(i); }
+
+    // decompress a single chunk / block; 'ok' is set to false in case of errors (see errorString())
+    QByteArray chunk(int i, bool *ok = nullptr) const;
+    QByteArray block(int i, bool *ok = nullptr) const;
+
+    // decompress all chunks (in parallel) and return the concatenated blocks
+    QByteArray readAll(bool *ok = nullptr) const;
+
+    QString errorString() const { return errorString_; }
+
+    static quint32 crc32(const char *data, int len, quint32 crc = 0);
+
+private:
+    int chunkOfBlock(int block) const;
+    bool decodeChunk(int i, QByteArray &raw, QString &error) const; // thread safe
+
+    QByteArray data_;
+    QString format_;
+    Codec codec_ = NoCompression;
+    QVector<Chunk> chunks_;
+    QVector<quint32> blockSizes_;
+    qint64 dataStart_ = 0;
+    bool isOpen_ = false;
+    mutable QString errorString_;
+};
+
+#endif // KVLISTCONTAINER_H
@@ -1,6 +1,20 @@
 #include "kvlistentry.h"
 #include "kvlistmodel.h"
+#include "kvlistscheduler.h"
+#include "kvlisttrace.h"
+#include "kvlistblobstore.h"
+#include <QThread>
+#include <QMutex>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
+#include <QAbstractItemModel>
+#include <QVarLengthArray>
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QDebug>
+#include <cstring>
+#include <algorithm>
 
 
 KVListEntry::KVListEntry(QObject *parent) :
@@ -18,6 +32,9 @@ KVListEntry::~KVListEntry()
     }
     qDeleteAll(collect);
     keyModifiedCallbacks_.clear();
+
+    if(KVListScheduler::hasInstance())
+        KVListScheduler::instance()->cancelAll(this);
 }
 
 QVariant KVListEntry::getValue(Key key) const
@@ -29,6 +46,9 @@ QVariant KVListEntry::getValue(Key key) const
             return keyValueStoreShadowed_[key];
     }
 
+    if(!lazyValues_.isEmpty())
+        materialize(key);
+
     return keyValueStore_[key];
 }
 
@@ -41,9 +61,59 @@ QVariant &KVListEntry::getValue(KVListEntry::Key key)
             return keyValueStoreShadowed_[key];
     }
 
+    if(!lazyValues_.isEmpty())
+        materialize(key);
+
     return keyValueStore_[key];
 }
 
+void KVListEntry::getValues(const Key *keys, QVariant *values, int count) const
+{
+    // process the keys in store order (shadowed keys by the key they shadow)
+    auto base = [](Key key){ return key >= ShadowedKeysStartAt ? key - ShadowedKeysStartAt : key; };
+    QVarLengthArray<int, 32> order(count);
+    for(int i=0; i<count; i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](int a, int b){ return base(keys[a]) < base(keys[b]); });
+
+    QVarLengthArray<bool, 32> resolved(count);
+    for(int i=0; i<count; i++)
+        resolved[i] = false;
+
+    // shadowed values first... in case there is none, the regular one is returned
+    if(!keyValueStoreShadowed_.isEmpty()) {
+        auto it = keyValueStoreShadowed_.constBegin(), end = keyValueStoreShadowed_.constEnd();
+        for(int i : order) {
+            if(keys[i] < ShadowedKeysStartAt)
+                continue;
+            const Key key = base(keys[i]);
+            while(it != end && it.key() < key)
+                ++it;
+            if(it != end && it.key() == key) {
+                values[i] = it.value();
+                resolved[i] = true;
+            }
+        }
+    }
+
+    if(!lazyValues_.isEmpty()) {
+        for(int i : order) {
+            if(!resolved[i])
+                materialize(base(keys[i]));
+        }
+    }
+
+    auto it = keyValueStore_.constBegin(), end = keyValueStore_.constEnd();
+    for(int i : order) {
+        if(resolved[i])
+            continue;
+        const Key key = base(keys[i]);
+        while(it != end && it.key() < key)
+            ++it;
+        values[i] = (it != end && it.key() == key) ? it.value() : QVariant();
+    }
+}
+
 void KVListEntry::setValue(Key key, const QVariant &value)
 {
     if(setValueInt(key, value)) {
@@ -63,6 +133,129 @@ KVListModel *KVListEntry::getChildModel(KVListEntry::Key key) const
    return getValue(key).value<KVListModel*>();
 }
 
+void KVListEntry::setBlob(Key key, const QByteArray &data)
+{
+    if(data.size() < KVListBlobStore::InlineLimit) {
+        setValue(key, data);
+        return;
+    }
+
+    KVListBlob blob = KVListBlob::fromData(data);
+    if(blob.isNull()) {
+        // better a large entry than lost data
+        qWarning(kvlist) << "blob for key" << key << "could not be stored, keeping it inline";
+        setValue(key, data);
+    }
+    else
+        setValue(key, QVariant::fromValue(blob));
+}
+
+QByteArray KVListEntry::getBlob(Key key) const
+{
+    QVariant v = getValue(key);
+    if(v.userType() == qMetaTypeId<KVListBlob>())
+        return v.value<KVListBlob>().data();
+    return v.toByteArray();
+}
+
+void KVListEntry::setLazyValue(Key key, LazyValueFunc factory)
+{
+    Q_ASSERT(key >= 0 && key < ShadowedKeysStartAt);
+    if(keyValueStore_.contains(key))
+        qWarning(kvlist) << "lazy value for key" << key << "ignored, as there is a value already";
+    else
+        lazyValues_.insert(key, factory);
+}
+
+void KVListEntry::propagateChildChanges(Key key, bool enable)
+{
+    Q_ASSERT(key >= 0 && key < ShadowedKeysStartAt);
+    if(!enable) {
+        for(const QMetaObject::Connection &c : childConnections_.take(key))
+            disconnect(c);
+        return;
+    }
+
+    // an empty list marks the key; a lazy child model is connected once it is created
+    childConnections_.insert(key, QVector<QMetaObject::Connection>());
+    if(!isLazy(key))
+        connectChild(key);
+}
+
+void KVListEntry::connectChild(Key key)
+{
+    QVector<QMetaObject::Connection> &connections = childConnections_[key];
+    for(const QMetaObject::Connection &c : connections)
+        disconnect(c);
+    connections.clear();
+
+    const QVariant value = keyValueStore_.value(key);
+    if(!(QMetaType::typeFlags(value.userType()) & QMetaType::PointerToQObject))
+        return;
+    QAbstractItemModel *child = qobject_cast<QAbstractItemModel*>(value.value<QObject*>());
+    if(!child)
+        return;
+
+    auto changed = [this, key](){ childChanged(key); };
+    connections << connect(child, &QAbstractItemModel::dataChanged, this, changed)
+                << connect(child, &QAbstractItemModel::rowsInserted, this, changed)
+                << connect(child, &QAbstractItemModel::rowsRemoved, this, changed)
+                << connect(child, &QAbstractItemModel::rowsMoved, this, changed)
+                << connect(child, &QAbstractItemModel::layoutChanged, this, changed)
+                << connect(child, &QAbstractItemModel::modelReset, this, changed);
+}
+
+void KVListEntry::childChanged(Key key)
+{
+    if(pendingChildChanges_.contains(key))
+        return;
+
+    if(pendingChildChanges_.isEmpty()) {
+        QTimer::singleShot(0, this, [this](){
+            QVector<Key> keys;
+            keys.swap(pendingChildChanges_);
+            if(keys.isEmpty())
+                return;
+            notifyValueChangedCallbacks(keys);
+            invalidateModel(keys);
+        });
+    }
+    pendingChildChanges_ << key;
+}
+
+void KVListEntry::setChildModelFactory(Key key, std::function<KVListModel* ()> factory)
+{
+    setLazyValue(key, [factory](){ return QVariant::fromValue(factory()); });
+}
+
+bool KVListEntry::materialize(Key key) const
+{
+    auto i = lazyValues_.find(key);
+    if(i == lazyValues_.end())
+        return false;
+
+    // the factory usually creates QObjects... never from a worker thread (e.g. parallel serialization)
+    if(thread() != QThread::currentThread())
+        return false;
+
+    LazyValueFunc factory = i.value();
+    lazyValues_.erase(i);
+
+    // the value was there "all the time", so this is not a change the model needs to be notified about;
+    // observers (e.g. replication) need to know about the new child model though
+    KVListEntry *self = const_cast<KVListEntry*>(this);
+    QVariant value = factory();
+    self->keyValueStore_.insert(key, value);
+    if(KVListModel *m = value.value<KVListModel*>())
+        m->ownerEntry_ = self;
+    self->touch(false);
+    if(childConnections_.contains(key))
+        self->connectChild(key);
+    if(model_ && !model_->observers_.isEmpty())
+        model_->notifyValueChanged(self, key, QVariant(), value);
+    return true;
+}
+
 void KVListEntry::setValues(const QMap<Key, QVariant> &values)
 {
     QVector<Key> modifies;
@@ -121,11 +314,48 @@ void KVListEntry::removeOnValueChanged(KVListEntry::CbHandle *obj)
     delete obj;
 }
 
+void KVListEntry::scheduleUpdate(Key key, qint64 msecs, ValueChangedCallbackFunc func)
+{
+    KVListScheduler::instance()->schedule(this, key, msecs, func);
+}
+
+void KVListEntry::cancelScheduledUpdate(Key key)
+{
+    if(KVListScheduler::hasInstance())
+        KVListScheduler::instance()->cancel(this, key);
+}
+
+void KVListEntry::clearValues()
+{
+    keyValueStore_.clear();
+    keyValueStoreShadowed_.clear();
+    lazyValues_.clear();
+    touch();
+
+    // keys stay marked for propagateChildChanges()
+    for(QVector<QMetaObject::Connection> &connections : childConnections_) {
+        for(const QMetaObject::Connection &c : connections)
+            disconnect(c);
+        connections.clear();
+    }
+    pendingChildChanges_.clear();
+}
+
 void KVListEntry::revertShadowedChanges() {
+    if(KVListTraceRecorder *r = recorder())
+        r->record(KVListTrace::RevertShadowed, model_->indexOf(this));
     keyValueStoreShadowed_.clear();
 }
 
 int KVListEntry::applyShadowedChanges() {
+    // the changes caused by applying are not recorded on their own
+    struct TraceScope {
+        KVListTraceRecorder *r;
+        ~TraceScope() { if(r) r->endOp(); }
+    } scope{recorder()};
+    if(scope.r)
+        scope.r->beginOp(KVListTrace::ApplyShadowed, model_->indexOf(this));
+
     QVector<Key> modifies;
     for(Key key : keyValueStoreShadowed_.keys()) {
         if(setValueInt(key, keyValueStoreShadowed_[key]))
@@ -150,7 +380,12 @@ void KVListEntry::notifyValueChangedCallbacks(const QVector<Key> &keys) const
 {
     // in case only one key has been changed, simply call the stored callbacks
     if(keys.size() == 1) {
-        for(CbHandle *o : keyModifiedCallbacks_.value(keys[0]))
+        const QVector<CbHandle*> callbacks = keyModifiedCallbacks_.value(keys[0]);
+        if(!callbacks.isEmpty()) {
+            if(KVListTraceRecorder *r = recorder())
+                r->recordCallbacks(model_->indexOf(const_cast<KVListEntry*>(this)), keys);
+        }
+        for(CbHandle *o : callbacks)
             o->func();
         return;
     }
@@ -165,23 +400,129 @@ void KVListEntry::notifyValueChangedCallbacks(const QVector<Key> &keys) const
         }
     }
 
+    if(!set.isEmpty()) {
+        if(KVListTraceRecorder *r = recorder())
+            r->recordCallbacks(model_->indexOf(const_cast<KVListEntry*>(this)), keys);
+    }
+
     for(CbHandle *o : set)
         o->func();
 }
 
+KVListTraceRecorder *KVListEntry::recorder() const
+{
+    return model_ ? model_->recorder_ : nullptr;
+}
+
 bool KVListEntry::setValueInt(Key key, const QVariant &value)
 {
     QVariant *v = nullptr;
 
+    // an explicit value replaces a value which would have been created lazily
+    if(!lazyValues_.isEmpty())
+        lazyValues_.remove(key);
+
     if(key >= ShadowedKeysStartAt)
         v = &keyValueStoreShadowed_[key-ShadowedKeysStartAt];
     else
         v = &keyValueStore_[key];
 
     if(*v != value) {
-        *v = value;
+        // observers need the previous value... only copy it in case anybody is interested
+        if(model_ && !model_->observers_.isEmpty() && key < ShadowedKeysStartAt) {
+            QVariant oldValue = *v;
+            *v = value;
+            model_->notifyValueChanged(this, key, oldValue, value);
+        }
+        else
+            *v = value;
+
+        if(key >= ShadowedKeysStartAt) {
+            if(KVListTraceRecorder *r = recorder())
+                r->record(KVListTrace::SetShadowed, model_->indexOf(this), key - ShadowedKeysStartAt, value);
+            return true;
+        }
+
+        if(QMetaType::typeFlags(value.userType()) & QMetaType::PointerToQObject) {
+            if(KVListModel *m = value.value<KVListModel*>())
+                m->ownerEntry_ = this;
+        }
+        // e.g. display strings ('_ns') are no content
+        if(!isTransientKey(key))
+            touch();
+
+        if(!childConnections_.isEmpty() && childConnections_.contains(key))
+            connectChild(key);
         return true;
     }
 
     return false;
 }
+
+void KVListEntry::touch(bool modified)
+{
+    if(modified)
+        generation_++;
+    hashValid_ = false;
+    if(model_)
+        model_->touchEntry(this, modified);
+}
+
+bool KVListEntry::isTransientKey(Key key) const
+{
+    // per entry class: the keys of its enums ending with '_noserialize' / '_ns'
+    static QMutex mutex;
+    static QHash<const QMetaObject*, QSet<int>> transientKeys;
+
+    const QMetaObject *mo = metaObject();
+    QMutexLocker locker(&mutex);
+    auto i = transientKeys.find(mo);
+    if(i == transientKeys.end()) {
+        QSet<int> keys;
+        for(int e = KVListEntry::staticMetaObject.enumeratorCount(); e < mo->enumeratorCount(); e++) {
+            const QMetaEnum keyEnum = mo->enumerator(e);
+            for(int k=0; k<keyEnum.keyCount(); k++) {
+                const QByteArray name(keyEnum.key(k));
+                if(name.endsWith("_noserialize") || name.endsWith("_ns"))
+                    keys.insert(keyEnum.value(k));
+            }
+        }
+        i = transientKeys.insert(mo, keys);
+    }
+    return i->contains(key);
+}
+
+quint64 KVListEntry::contentHash() const
+{
+    if(hashValid_)
+        return contentHash_;
+
+    QByteArray buffer;
+    {
+        QDataStream out(&buffer, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_12);
+        out << QByteArray(metaObject()->className());
+
+        for(auto i = keyValueStore_.constBegin(); i != keyValueStore_.constEnd(); ++i) {
+            if(isTransientKey(i.key()))
+                continue;
+
+            const QVariant &v = i.value();
+            const int type = v.userType();
+            if(QMetaType::typeFlags(type) & QMetaType::PointerToQObject) {
+                // child models by their content, other objects are no content
+                if(KVListModel *m = v.value<KVListModel*>())
+                    out << qint32(i.key()) << m->contentHash();
+                continue;
+            }
+            if(type == QMetaType::VoidStar)
+                continue;
+            out << qint32(i.key()) << v;
+        }
+    }
+
+    const QByteArray digest = QCryptographicHash::hash(buffer, QCryptographicHash::Sha1);
+    std::memcpy(&contentHash_, digest.constData(), sizeof(contentHash_));
+    hashValid_ = true;
+    return contentHash_;
+}
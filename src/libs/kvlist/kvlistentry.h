@@ -77,12 +77,18 @@
  * It is also possible to store another KVListModel for a key. That proved to be useful for
  * displaying "childmodels" in QML easily. See KVListModel documentation for details on how
  * models can be used.
+ * Child models which are not always needed can be created lazily via setChildModelFactory():
+ * the model is created on first access (getValue()/getChildModel(), e.g. from QML or while
+ * deserializing content for it). Until then the key is not part of keys() and nothing is serialized.
  *
  * In case you want to exclude keys from being serialized, prepend '_noserialize' to the enum name.
  * E.g. in the above example the nickname above should not be set by the user but is instead created
  * programmatically... Any deserialization might overwrite values...
  * Instead of '_noserialize' '_ns' is also accepted
  *
+ * Values which equal the defaultValues() of the type are not serialized either; they are restored
+ * from defaultValues() on load.
+ *
  * <code>
  *
  * // in qml
@@ -104,6 +110,7 @@
  */
 
 class KVListModel;
+class KVListTraceRecorder;
 
 class KVLIST_EXPORT KVListEntry : public QObject, public KVListBase
 {
@@ -111,6 +118,7 @@ class KVLIST_EXPORT KVListEntry : public QObject, public KVListBase
 
 public:
     typedef std::function<void ()> ValueChangedCallbackFunc;
+    typedef std::function<QVariant ()> LazyValueFunc;
     struct CbHandle{ ValueChangedCallbackFunc func; };
     typedef int Key;
     typedef QMap<Key, QVariant> KeyValueMap;
@@ -125,6 +133,8 @@ public:
     // get/set QVariant for given key
     QVariant getValue(Key key) const;
     QVariant& getValue(Key key);
+    // values[i] = getValue(keys[i]) for 'count' keys; walks each store once instead of one lookup per key
+    void getValues(const Key *keys, QVariant *values, int count) const;
     void setValue(Key key, const QVariant &value);
     void setValues(const QMap<Key, QVariant> &values);
 
@@ -136,11 +146,32 @@ public:
     // set another model for given key
     void setChildModel(Key key, KVListModel *model_);
     KVListModel *getChildModel(Key key) const;
+
+    // large binary data: stored in the KVListBlobStore (the value is a KVListBlob handle),
+    // data smaller than KVListBlobStore::InlineLimit (or which cannot be stored) stays inline
+    void setBlob(Key key, const QByteArray &data);
+    QByteArray getBlob(Key key) const;
+
+    // create the value / child model for given key on first access (in the thread of the entry)
+    // setting a value for the key discards the factory
+    void setLazyValue(Key key, LazyValueFunc factory);
+    void setChildModelFactory(Key key, std::function<KVListModel* ()> factory);
+    // true in case the value of 'key' is created lazily and has not been accessed yet
+    bool isLazy(Key key) const { return lazyValues_.contains(key); }
+
+    // report changes within the child model stored for 'key' (also a lazily created or a later set one)
+    // as a change of 'key': the callbacks of 'key' are called and the parent model emits dataChanged().
+    // All changes of one event loop iteration are reported once
+    void propagateChildChanges(Key key, bool enable = true);
     KVListModel *getParentModel() const { return model_; }
 
     // return all keys that are currently set
     QList<Key> keys() const { return keyValueStore_.keys(); }
 
+    // values every entry of this type starts with; serializers only store values that differ and
+    // restore the others from here. Override it in your type (return a static map, it is called often)
+    virtual KeyValueMap defaultValues() const { return KeyValueMap(); }
+
     // add your callback/lambda here... will be notified when value for given key(s) have been modified
     // the returned value can be used as a handle to remove the callback again!
     CbHandle* onValueChanged(const QVector<Key> &keys, ValueChangedCallbackFunc func);
@@ -148,6 +179,11 @@ public:
     // remove a callback
     void removeOnValueChanged(CbHandle *obj);
 
+    // call 'func' in 'msecs' to refresh the value of 'key' (e.g. a "5 minutes ago" text); replaces a
+    // pending update of the same key. All entries share one timer, see KVListScheduler
+    void scheduleUpdate(Key key, qint64 msecs, ValueChangedCallbackFunc func);
+    void cancelScheduledUpdate(Key key);
+
     static inline Key SHADOWED_KEY(Key index) { return index+ShadowedKeysStartAt; }
 
     // apply the changes stored in the shadowed entries; return number of changes
@@ -156,15 +192,48 @@ public:
     // revert the changes stored in the shadowed entries
     Q_INVOKABLE virtual void revertShadowedChanges();
 
+    // called by KVListEntryPool before the entry is kept for reuse: bring the entry into the state of
+    // a new one and return true. The default returns false, i.e. the entry is deleted instead.
+    // Callbacks registered via onValueChanged() are kept, use clearValues() for the rest
+    virtual bool resetForReuse() { return false; }
+
+    // incremented with every change of a serialized value, also of the content of child models (not persisted)
+    quint64 generation() const { return generation_; }
+    // hash of the serialized values including the content of child models; values which are created
+    // lazily are included once created. Cached until the next change
+    quint64 contentHash() const;
+    // keys of the entry's enum ending with '_noserialize' / '_ns' (the enum has to be declared via Q_ENUM):
+    // no content, e.g. display strings
+    bool isTransientKey(Key key) const;
+
 protected:
+    // remove all values, shadowed values and lazy values
+    void clearValues();
     void invalidateModel(const QVector<Key> &keys) const;
     void notifyValueChangedCallbacks(const QVector<Key> &keys) const;
     bool setValueInt(Key key, const QVariant &value);
+    bool materialize(Key key) const;
+    KVListTraceRecorder *recorder() const;
+    void connectChild(Key key);
+    void childChanged(Key key);
+    // content changed ('modified': a new generation, otherwise only the hashes are outdated);
+    // passed on to the model
+    void touch(bool modified = true);
 
     QMap<Key, QVariant> keyValueStore_, keyValueStoreShadowed_;
+    mutable QMap<Key, LazyValueFunc> lazyValues_;
     QMap<Key, QVector<CbHandle*>> keyModifiedCallbacks_;
+    // propagateChildChanges(): connections to the child models and keys changed in this event loop iteration
+    QMap<Key, QVector<QMetaObject::Connection>> childConnections_;
+    QVector<Key> pendingChildChanges_;
     friend class KVListModel;
+    friend class KVListMemoryUsage;
     KVListModel *model_;
+    quint64 generation_ = 0;
+    mutable quint64 contentHash_ = 0;
+    mutable bool hashValid_ = false;
+    // row in model_ (a hint, verified on use)
+    mutable int modelRow_ = -1;
 };
 
 
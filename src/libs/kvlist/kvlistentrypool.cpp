@@ -0,0 +1,66 @@
+#include "kvlistentrypool.h"
+#include "kvlistscheduler.h"
+#include <QThread>
+
+KVListEntryPool::KVListEntryPool(QObject *parent, int capacity) :
+    QObject(parent),
+    capacity_(capacity)
+{
+}
+
+KVListEntryPool::~KVListEntryPool()
+{
+    release();
+}
+
+void KVListEntryPool::recycle(KVListEntry *entry)
+{
+    if(!entry)
+        return;
+
+    Q_ASSERT(!entry->getParentModel());
+    if(size_ >= capacity_ || entry->thread() != thread() || !entry->resetForReuse()) {
+        delete entry;
+        return;
+    }
+
+    if(KVListScheduler::hasInstance())
+        KVListScheduler::instance()->cancelAll(entry);
+    entry->setParent(nullptr);
+
+    free_[entry->metaObject()] << entry;
+    size_++;
+}
+
+void KVListEntryPool::release()
+{
+    for(QVector<KVListEntry*> &entries : free_)
+        qDeleteAll(entries);
+    free_.clear();
+    size_ = 0;
+}
+
+void KVListEntryPool::setCapacity(int capacity)
+{
+    capacity_ = capacity;
+
+    // drop the surplus
+    for(auto i = free_.begin(); i != free_.end() && size_ > capacity_; ++i) {
+        while(!i.value().isEmpty() && size_ > capacity_) {
+            delete i.value().takeLast();
+            size_--;
+        }
+    }
+}
+
+KVListEntry *KVListEntryPool::take(const QMetaObject *type, QObject *parent)
+{
+    auto i = free_.find(type);
+    if(i == free_.end() || i.value().isEmpty())
+        return nullptr;
+
+    KVListEntry *e = i.value().takeLast();
+    size_--;
+    e->setParent(parent);
+    return e;
+}
@@ -0,0 +1,65 @@
+#ifndef KVLISTENTRYPOOL_H
+#define KVLISTENTRYPOOL_H
+
+#include <QObject>
+#include <QHash>
+#include <QVector>
+#include "kvlistentry.h"
+#include "kvlist_global.h"
+
+/**
+ * @brief The KVListEntryPool class
+ *
+ * Keeps removed entries for reuse instead of freeing them, e.g. for models whose entries are
+ * re-created over and over (ActivityModel::processActivities()). Reusing an entry saves the
+ * allocation of the QObject (incl. its private data) and keeps the registered callbacks.
+ *
+ * Models using a pool (see KVListModel::setEntryPool()) hand over their entries in deleteAt(),
+ * deleteAll() etc. (and on destruction); new entries are taken via acquire(). Several models of
+ * the same type can share one pool. release() frees all pooled entries at once.
+ *
+ * <code>
+ * static KVListEntryPool *pool = new KVListEntryPool(QCoreApplication::instance());
+ * model->setEntryPool(pool);
+ * *model << pool->acquire<Person>();
+ * </code>
+ *
+ * Notes:
+ * - only entries whose type re-implements KVListEntry::resetForReuse() are pooled, others are deleted
+ * - pooled entries have no parent and get the parent given to acquire()
+ * - the pool must live in the thread of the models
+ */
+class KVLIST_EXPORT KVListEntryPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit KVListEntryPool(QObject *parent = nullptr, int capacity = 4096);
+    virtual ~KVListEntryPool();
+
+    // a reused entry of type T or a new one
+    template<class T>
+    T *acquire(QObject *parent = nullptr) {
+        KVListEntry *e = take(&T::staticMetaObject, parent);
+        return e ? static_cast<T*>(e) : new T(parent);
+    }
+
+    // reset the entry and keep it; it is deleted in case it cannot be reused or the pool is full
+    void recycle(KVListEntry *entry);
+
+    // delete all pooled entries
+    void release();
+
+    int size() const { return size_; }
+    int capacity() const { return capacity_; }
+    void setCapacity(int capacity);
+
+private:
+    KVListEntry *take(const QMetaObject *type, QObject *parent);
+
+    QHash<const QMetaObject*, QVector<KVListEntry*>> free_;
+    int size_ = 0;
+    int capacity_;
+};
+
+#endif // KVLISTENTRYPOOL_H
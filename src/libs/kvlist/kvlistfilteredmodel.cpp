@@ -1,5 +1,15 @@
 #include "kvlistfilteredmodel.h"
+#include <algorithm>
 
+// every previous word is the start of one of the new words: the new matches are a subset of the previous ones
+static bool narrows(const QStringList &previous, const QStringList &words)
+{
+    for(const QString &p : previous) {
+        if(std::none_of(words.begin(), words.end(), [&p](const QString &w) { return w.startsWith(p); }))
+            return false;
+    }
+    return true;
+}
 
 KVListFilteredModel::KVListFilteredModel(QObject *parent) : QSortFilterProxyModel(parent) {
     KVListModel *m = dynamic_cast<KVListModel*>(parent);
@@ -11,28 +21,193 @@ KVListFilteredModel::KVListFilteredModel(QObject *parent) : QSortFilterProxyMode
 
 void KVListFilteredModel::setFilter(const QMap<KVListEntry::Key, QVariantList> &filter)
 {
-    filterMap_ = filter;
-    invalidateFilter();
+    KVListFilterExpression expression;
+    for(auto i = filter.constBegin(); i != filter.constEnd(); ++i)
+        expression = expression && KVListFilterExpression::in(i.key(), i.value());
+    setFilterExpression(expression);
 }
 
-bool KVListFilteredModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+void KVListFilteredModel::setFilterExpression(const KVListFilterExpression &expression)
 {
-    Q_ASSERT(QSortFilterProxyModel::sourceModel());
+    plan_ = KVListFilterPlan(expression);
+    refilter();
+}
+
+bool KVListFilteredModel::setFilterExpression(const QVariantMap &expression)
+{
+    if(!source_)
+        return false;
+
+    QString error;
+    KVListFilterExpression e = KVListFilterExpression::fromVariant(expression, source_->roleNames(), &error);
+    if(!error.isEmpty()) {
+        qWarning(kvlist) << "invalid filter expression:" << error;
+        return false;
+    }
+
+    setFilterExpression(e);
+    return true;
+}
 
+void KVListFilteredModel::refilter()
+{
+    // evaluate all rows in one batch; filterAcceptsRow() only looks up the result
+    acceptCache_.clear();
+    KVListTextIndex *index = searchIndex();
+    const bool search = index && !searchWords_.isEmpty();
 
-    QModelIndex index = sourceModel()->index(sourceRow, 0, sourceParent);
+    if(source_ && (!plan_.isEmpty() || search)) {
+        QVector<KVListEntry*> entries;
+        entries.reserve(source_->size());
+        for(KVListEntry *e : *source_)
+            entries << e;
+        acceptCache_ = plan_.evaluate(entries);
 
-    auto i = filterMap_.constBegin();
-    bool res = true;
-    while (i != filterMap_.constEnd()) {
-        const QVariant &value = sourceModel()->data(index, i.key());
-        if (!i.value().contains(value)) {
-            res = false;
-            break;
+        if(search) {
+            const QSet<KVListEntry*> found = index->search(searchText_);
+            for(int row=0; row<entries.size(); row++) {
+                if(acceptCache_[row] && !found.contains(entries[row]))
+                    acceptCache_[row] = 0;
+            }
         }
+    }
+    invalidateFilter();
+}
+
+void KVListFilteredModel::narrowSearch()
+{
+    KVListTextIndex *index = searchIndex();
+    if(!index) {
+        refilter();
+        return;
+    }
+
+    // nothing filtered so far: all rows are accepted
+    if(acceptCache_.isEmpty())
+        acceptCache_.fill(1, source_->size());
+
+    // only rows accepted so far can still match; the filter expression does not change
+    const QSet<KVListEntry*> found = index->search(searchText_);
+    bool changed = false;
+    for(int row=0; row<acceptCache_.size(); row++) {
+        if(acceptCache_[row] && !found.contains(source_->at(row))) {
+            acceptCache_[row] = 0;
+            changed = true;
+        }
+    }
+
+    // the proxy removes the rows which are not accepted anymore (no reset)
+    if(changed) {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+        invalidateRowsFilter();
+#else
+        invalidateFilter();
+#endif
+    }
+}
+
+void KVListFilteredModel::setSearchText(const QString &text)
+{
+    if(text == searchText_)
+        return;
+
+    searchText_ = text;
+    QStringList words = KVListTextIndex::words(text);
+    // e.g. a trailing space: same result
+    if(words != searchWords_) {
+        // typing on: the cache of the previous search only has to lose rows
+        const bool cacheValid = source_ && (acceptCache_.size() == source_->size()
+                                            || (acceptCache_.isEmpty() && plan_.isEmpty() && searchWords_.isEmpty()));
+        const bool narrowing = cacheValid && !words.isEmpty() && narrows(searchWords_, words);
+
+        searchWords_ = words;
+        if(!searchIndex() && !words.isEmpty())
+            qWarning(kvlist) << "search text set, but the source model has no KVListTextIndex";
+        if(narrowing)
+            narrowSearch();
         else
-            ++i;
+            refilter();
     }
+    emit searchTextChanged();
+}
+
+KVListTextIndex *KVListFilteredModel::searchIndex() const
+{
+    if(searchIndex_ || !source_)
+        return searchIndex_;
+    return source_->findChild<KVListTextIndex*>(QString(), Qt::FindDirectChildrenOnly);
+}
+
+void KVListFilteredModel::setSearchIndex(KVListTextIndex *index)
+{
+    searchIndex_ = index;
+    if(!searchWords_.isEmpty())
+        refilter();
+}
+
+bool KVListFilteredModel::accepts(const KVListEntry *entry) const
+{
+    if(!plan_.matches(entry))
+        return false;
+
+    KVListTextIndex *index = searchWords_.isEmpty() ? nullptr : searchIndex();
+    return !index || index->matches(entry, searchWords_);
+}
+
+void KVListFilteredModel::setSourceModel(QAbstractItemModel *sourceModel)
+{
+    if(source_)
+        disconnect(source_, nullptr, this, nullptr);
+
+    source_ = dynamic_cast<KVListModel*>(sourceModel);
+    acceptCache_.clear();
+
+    // connect before QSortFilterProxyModel does: the cache must be up to date when it asks for rows
+    if(source_) {
+        connect(source_, &QAbstractItemModel::dataChanged, this, [this](const QModelIndex &topLeft, const QModelIndex &bottomRight){
+            updateAcceptCache(topLeft.row(), bottomRight.row());
+        });
+        connect(source_, &QAbstractItemModel::rowsInserted, this, [this](const QModelIndex &, int first, int last){
+            if(acceptCache_.isEmpty())
+                return;
+            acceptCache_.insert(first, last - first + 1, 0);
+            updateAcceptCache(first, last);
+        });
+        connect(source_, &QAbstractItemModel::rowsRemoved, this, [this](const QModelIndex &, int first, int last){
+            if(!acceptCache_.isEmpty())
+                acceptCache_.remove(first, last - first + 1);
+        });
+        connect(source_, &QAbstractItemModel::rowsMoved, this, [this](){ acceptCache_.clear(); });
+        connect(source_, &QAbstractItemModel::layoutChanged, this, [this](){ acceptCache_.clear(); });
+        connect(source_, &QAbstractItemModel::modelReset, this, [this](){ acceptCache_.clear(); });
+    }
+
+    QSortFilterProxyModel::setSourceModel(sourceModel);
+}
+
+void KVListFilteredModel::updateAcceptCache(int first, int last)
+{
+    if(acceptCache_.isEmpty())
+        return;
+
+    if(acceptCache_.size() != source_->size() || first < 0 || last >= acceptCache_.size()) {
+        acceptCache_.clear();
+        return;
+    }
+
+    for(int row = first; row <= last; row++)
+        acceptCache_[row] = accepts(source_->at(row));
+}
+
+bool KVListFilteredModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+{
+    Q_ASSERT(QSortFilterProxyModel::sourceModel());
+
+    if(sourceParent.isValid() || !source_)
+        return false;
+
+    if(sourceRow < acceptCache_.size() && acceptCache_.size() == source_->size())
+        return acceptCache_[sourceRow] != 0;
 
-    return res;
+    return accepts(source_->at(sourceRow));
 }
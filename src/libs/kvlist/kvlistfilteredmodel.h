@@ -3,20 +3,55 @@
 
 #include "kvlistmodel.h"
 #include "kvlistentry.h"
+#include "kvlistfilterexpression.h"
+#include "kvlisttextindex.h"
 #include "kvlist_global.h"
 #include <QSortFilterProxyModel>
+#include <QPointer>
 #include <QVariant>
 
+/**
+ * @brief The KVListFilteredModel class
+ *
+ * Filters the entries of its parent KVListModel.
+ *
+ * The filter is a KVListFilterExpression compiled into a KVListFilterPlan. A full re-filter
+ * evaluates all rows in one batch (see KVListFilterPlan::evaluate()) and caches the result;
+ * single row changes of the source only re-evaluate the affected rows.
+ *
+ * setFilter() keeps the simple "value is in this list" filter per key.
+ *
+ * setSearchText() additionally restricts the entries to the ones matching a text search, see
+ * KVListTextIndex. Without an explicit setSearchIndex() the index of the source model is used.
+ * Typing on (the new words extend the previous ones) only checks the rows accepted so far.
+ */
 class KVLIST_EXPORT KVListFilteredModel : public QSortFilterProxyModel
 {
     Q_OBJECT
+    Q_PROPERTY(QString searchText READ searchText WRITE setSearchText NOTIFY searchTextChanged)
 
 public:
     explicit KVListFilteredModel(QObject* parent=nullptr);
 
+    // accept entries whose value for each key is contained in the given list
     void setFilter(const QMap<KVListEntry::Key, QVariantList> &filter);
+
+    void setFilterExpression(const KVListFilterExpression &expression);
+    // qml: see KVListFilterExpression::fromVariant(); returns false (and keeps the current filter) on errors
+    Q_INVOKABLE bool setFilterExpression(const QVariantMap &expression);
+
+    // re-evaluate the filter, e.g. for filters relative to the current time
+    Q_INVOKABLE void refilter();
+
+    // text search on top of the filter expression; an empty text accepts all entries
+    QString searchText() const { return searchText_; }
+    void setSearchText(const QString &text);
+    KVListTextIndex *searchIndex() const;
+    void setSearchIndex(KVListTextIndex *index);
+
     Q_INVOKABLE KVListModel *getSourceModel() const { return dynamic_cast<KVListModel*>(QSortFilterProxyModel::sourceModel()); }
 
+    void setSourceModel(QAbstractItemModel *sourceModel) override;
     bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
 
     Q_INVOKABLE void dbgMe() {
@@ -26,8 +61,24 @@ public:
             qDebug() << e->getValue(0);
     }
 
+signals:
+    void searchTextChanged();
+
 private:
-    QMap<KVListEntry::Key, QVariantList> filterMap_;
+    friend class KVListMemoryUsage;
+    void updateAcceptCache(int first, int last);
+    // the search words were extended: drop the rows which do not match anymore
+    void narrowSearch();
+    bool accepts(const KVListEntry *entry) const;
+
+    KVListModel *source_ = nullptr;
+    KVListFilterPlan plan_;
+    // result of the last batch evaluation per source row; empty when not available
+    QVector<char> acceptCache_;
+
+    QPointer<KVListTextIndex> searchIndex_;
+    QString searchText_;
+    QStringList searchWords_;
 };
 
 
@@ -0,0 +1,492 @@
+#include "kvlistfilterexpression.h"
+#include "kvlistparallel.h"
+#include <QDateTime>
+#include <QRegularExpression>
+#include <QVarLengthArray>
+#include <cstring>
+
+typedef KVListFilterExpression Expr;
+
+// rows are evaluated in blocks of this size; blocks are spread over the thread pool
+static const int BLOCK_SIZE = 2048;
+
+struct KVListFilterExpression::Node {
+    Op op = And;
+    KVListEntry::Key key = -1;
+    QVariant value;
+    bool relativeToNow = false;
+    qint64 offsetMs = 0;
+    Qt::CaseSensitivity cs = Qt::CaseSensitive;
+    QVector<KVListFilterExpression> children;
+};
+
+
+KVListFilterExpression KVListFilterExpression::create(Node *node)
+{
+    KVListFilterExpression e;
+    e.node_ = QSharedPointer<const Node>(node);
+    return e;
+}
+
+KVListFilterExpression KVListFilterExpression::compare(KVListEntry::Key key, Op op, const QVariant &value)
+{
+    Node *n = new Node;
+    n->op = op;
+    n->key = key;
+    n->value = value;
+    return create(n);
+}
+
+KVListFilterExpression KVListFilterExpression::compareToNow(KVListEntry::Key key, Op op, qint64 offsetSecs)
+{
+    Node *n = new Node;
+    n->op = op;
+    n->key = key;
+    n->relativeToNow = true;
+    n->offsetMs = offsetSecs * 1000;
+    return create(n);
+}
+
+KVListFilterExpression KVListFilterExpression::between(KVListEntry::Key key, const QVariant &min, const QVariant &max)
+{
+    return compare(key, GreaterEqual, min) && compare(key, LessEqual, max);
+}
+
+KVListFilterExpression KVListFilterExpression::startsWith(KVListEntry::Key key, const QString &prefix, Qt::CaseSensitivity cs)
+{
+    Node *n = new Node;
+    n->op = StartsWith;
+    n->key = key;
+    n->value = prefix;
+    n->cs = cs;
+    return create(n);
+}
+
+KVListFilterExpression KVListFilterExpression::contains(KVListEntry::Key key, const QString &text, Qt::CaseSensitivity cs)
+{
+    Node *n = new Node;
+    n->op = Contains;
+    n->key = key;
+    n->value = text;
+    n->cs = cs;
+    return create(n);
+}
+
+KVListFilterExpression KVListFilterExpression::isNull(KVListEntry::Key key)
+{
+    return compare(key, IsNull, QVariant());
+}
+
+KVListFilterExpression KVListFilterExpression::isNotNull(KVListEntry::Key key)
+{
+    return compare(key, IsNotNull, QVariant());
+}
+
+KVListFilterExpression KVListFilterExpression::in(KVListEntry::Key key, const QVariantList &values)
+{
+    return compare(key, In, values);
+}
+
+KVListFilterExpression KVListFilterExpression::combine(Op op, const KVListFilterExpression &a, const KVListFilterExpression &b)
+{
+    // a null expression matches everything
+    if(a.isNull())
+        return op == And ? b : a;
+    if(b.isNull())
+        return op == And ? a : b;
+
+    // keep chains flat: (a && b) && c -> &&(a, b, c)
+    Node *n = new Node;
+    n->op = op;
+    for(const KVListFilterExpression *e : { &a, &b }) {
+        if(e->node_->op == op)
+            n->children << e->node_->children;
+        else
+            n->children << *e;
+    }
+    return create(n);
+}
+
+KVListFilterExpression KVListFilterExpression::operator&&(const KVListFilterExpression &other) const
+{
+    return combine(And, *this, other);
+}
+
+KVListFilterExpression KVListFilterExpression::operator||(const KVListFilterExpression &other) const
+{
+    return combine(Or, *this, other);
+}
+
+KVListFilterExpression KVListFilterExpression::operator!() const
+{
+    // not everything -> nothing; no value is contained in an empty list
+    if(isNull())
+        return in(-1, QVariantList());
+
+    Node *n = new Node;
+    n->op = Not;
+    n->children << *this;
+    return create(n);
+}
+
+static bool parseRelativeTime(const QString &str, qint64 *offsetSecs)
+{
+    static const QRegularExpression re("^\\s*now\\s*(?:([+-])\\s*(\\d+)\\s*([smhdw]))?\\s*$");
+    QRegularExpressionMatch m = re.match(str);
+    if(!m.hasMatch())
+        return false;
+
+    qint64 secs = 0;
+    if(m.capturedLength(1) > 0) {
+        qint64 unit = 1;
+        switch(m.captured(3).at(0).toLatin1()) {
+        case 'm': unit = 60; break;
+        case 'h': unit = 60*60; break;
+        case 'd': unit = 60*60*24; break;
+        case 'w': unit = 60*60*24*7; break;
+        default: break;
+        }
+        secs = m.captured(2).toLongLong() * unit;
+        if(m.captured(1) == "-")
+            secs = -secs;
+    }
+    *offsetSecs = secs;
+    return true;
+}
+
+KVListFilterExpression KVListFilterExpression::fromVariant(const QVariant &expression, const QHash<int, QByteArray> &roleNames, QString *error)
+{
+    auto fail = [&](const QString &msg) -> KVListFilterExpression {
+        if(error)
+            *error = msg;
+        return KVListFilterExpression();
+    };
+
+    QVariantMap map = expression.toMap();
+
+    // combinations
+    for(const char *name : { "and", "or" }) {
+        if(!map.contains(name))
+            continue;
+
+        KVListFilterExpression res;
+        for(const QVariant &v : map.value(name).toList()) {
+            QString err;
+            KVListFilterExpression e = fromVariant(v, roleNames, &err);
+            if(!err.isEmpty())
+                return fail(err);
+            res = combine(qstrcmp(name, "and") == 0 ? And : Or, res, e);
+        }
+        return res;
+    }
+
+    if(map.contains("not")) {
+        QString err;
+        KVListFilterExpression e = fromVariant(map.value("not"), roleNames, &err);
+        if(!err.isEmpty())
+            return fail(err);
+        return !e;
+    }
+
+    // comparisons
+    QString keyName = map.value("key").toString();
+    KVListEntry::Key key = roleNames.key(keyName.toUtf8(), -1);
+    if(key < 0)
+        return fail(QString("unknown key '%1'").arg(keyName));
+
+    QString op = map.value("op", "==").toString();
+    QVariant value = map.value("value");
+
+    if(op == "isNull")
+        return isNull(key);
+    if(op == "notNull")
+        return isNotNull(key);
+    if(op == "in")
+        return in(key, value.toList());
+    if(op == "startsWith")
+        return startsWith(key, value.toString());
+    if(op == "contains")
+        return contains(key, value.toString());
+    if(op == "between") {
+        QVariantList l = value.toList();
+        if(l.size() != 2)
+            return fail("'between' requires a list of two values");
+        return between(key, l[0], l[1]);
+    }
+
+    Op cmp;
+    if(op == "==") cmp = Equal;
+    else if(op == "!=") cmp = NotEqual;
+    else if(op == "<") cmp = Less;
+    else if(op == "<=") cmp = LessEqual;
+    else if(op == ">") cmp = Greater;
+    else if(op == ">=") cmp = GreaterEqual;
+    else return fail(QString("unknown op '%1'").arg(op));
+
+    qint64 offsetSecs;
+    if(value.userType() == QMetaType::QString && parseRelativeTime(value.toString(), &offsetSecs))
+        return compareToNow(key, cmp, offsetSecs);
+
+    return compare(key, cmp, value);
+}
+
+
+
+KVListFilterPlan::KVListFilterPlan(const KVListFilterExpression &expression)
+{
+    if(!expression.isNull())
+        compile(expression);
+}
+
+void KVListFilterPlan::compile(const KVListFilterExpression &expression)
+{
+    const Expr::Node *n = expression.node_.data();
+
+    switch(n->op) {
+    case Expr::And:
+    case Expr::Or:
+        for(int i=0; i<n->children.size(); i++) {
+            compile(n->children[i]);
+            if(i > 0) {
+                Instruction ins;
+                ins.op = n->op;
+                program_ << ins;
+            }
+        }
+        return;
+    case Expr::Not: {
+        compile(n->children.first());
+        Instruction ins;
+        ins.op = Expr::Not;
+        program_ << ins;
+        return;
+    }
+    default:
+        break;
+    }
+
+    // comparison: convert the constant once, so evaluation compares plain numbers/strings
+    Instruction ins;
+    ins.op = n->op;
+    ins.key = n->key;
+    ins.cs = n->cs;
+    ins.value = n->value;
+
+    if(n->relativeToNow) {
+        ins.type = Time;
+        ins.relativeToNow = true;
+        ins.time = n->offsetMs;
+    }
+    else if(n->op == Expr::In) {
+        ins.list = n->value.toList();
+    }
+    else if(n->op == Expr::StartsWith || n->op == Expr::Contains) {
+        ins.type = Text;
+        ins.text = n->value.toString();
+    }
+    else if(n->op != Expr::IsNull && n->op != Expr::IsNotNull) {
+        switch(n->value.userType()) {
+        case QMetaType::Bool:
+        case QMetaType::Int:
+        case QMetaType::UInt:
+        case QMetaType::LongLong:
+        case QMetaType::ULongLong:
+        case QMetaType::Double:
+        case QMetaType::Float:
+            ins.type = Number;
+            ins.number = n->value.toDouble();
+            break;
+        case QMetaType::QString:
+            ins.type = Text;
+            ins.text = n->value.toString();
+            break;
+        case QMetaType::QDate:
+        case QMetaType::QDateTime:
+            ins.type = Time;
+            ins.time = n->value.toDateTime().toMSecsSinceEpoch();
+            break;
+        default:
+            ins.type = Generic;
+            break;
+        }
+    }
+
+    program_ << ins;
+}
+
+QVector<char> KVListFilterPlan::evaluate(const QVector<KVListEntry*> &entries) const
+{
+    QVector<char> result(entries.size(), 1);
+    if(program_.isEmpty() || entries.isEmpty())
+        return result;
+
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const KVListEntry * const *in = entries.constData();
+    char *out = result.data();
+    int size = entries.size();
+
+    int blocks = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    KVListParallel::forEach(blocks, [&](int b){
+        int begin = b * BLOCK_SIZE;
+        evaluateBlock(in + begin, qMin(BLOCK_SIZE, size - begin), out + begin, now);
+    }, 1);
+
+    return result;
+}
+
+bool KVListFilterPlan::matches(const KVListEntry *entry) const
+{
+    if(program_.isEmpty())
+        return true;
+
+    char res = 0;
+    evaluateBlock(&entry, 1, &res, QDateTime::currentMSecsSinceEpoch());
+    return res != 0;
+}
+
+QSet<KVListEntry::Key> KVListFilterPlan::keys() const
+{
+    QSet<KVListEntry::Key> res;
+    for(const Instruction &ins : program_) {
+        if(ins.key >= 0)
+            res.insert(ins.key);
+    }
+    return res;
+}
+
+void KVListFilterPlan::evaluateBlock(const KVListEntry * const *entries, int count, char *out, qint64 now) const
+{
+    // postfix program; each stack element is a mask over the block
+    QVector<QVector<char>> stack;
+
+    for(const Instruction &ins : program_) {
+        switch(ins.op) {
+        case Expr::And: {
+            QVector<char> b = stack.takeLast();
+            char *a = stack.last().data();
+            for(int i=0; i<count; i++)
+                a[i] &= b[i];
+            break;
+        }
+        case Expr::Or: {
+            QVector<char> b = stack.takeLast();
+            char *a = stack.last().data();
+            for(int i=0; i<count; i++)
+                a[i] |= b[i];
+            break;
+        }
+        case Expr::Not: {
+            char *a = stack.last().data();
+            for(int i=0; i<count; i++)
+                a[i] = !a[i];
+            break;
+        }
+        default:
+            stack.append(QVector<char>(count));
+            evaluateLeaf(ins, entries, count, stack.last().data(), now);
+            break;
+        }
+    }
+
+    Q_ASSERT(stack.size() == 1);
+    memcpy(out, stack.last().constData(), count);
+}
+
+// compare a typed column against a constant; values that are not valid (null) never match
+template<class T>
+static void compareColumn(Expr::Op op, const T *col, const char *valid, int count, const T &c, char *out)
+{
+    switch(op) {
+    case Expr::Equal:        for(int i=0; i<count; i++) out[i] = valid[i] && col[i] == c; break;
+    case Expr::NotEqual:     for(int i=0; i<count; i++) out[i] = valid[i] && col[i] != c; break;
+    case Expr::Less:         for(int i=0; i<count; i++) out[i] = valid[i] && col[i] <  c; break;
+    case Expr::LessEqual:    for(int i=0; i<count; i++) out[i] = valid[i] && col[i] <= c; break;
+    case Expr::Greater:      for(int i=0; i<count; i++) out[i] = valid[i] && col[i] >  c; break;
+    case Expr::GreaterEqual: for(int i=0; i<count; i++) out[i] = valid[i] && col[i] >= c; break;
+    default:                 for(int i=0; i<count; i++) out[i] = 0; break;
+    }
+}
+
+static bool compareText(Expr::Op op, const QString &s, const QString &c, Qt::CaseSensitivity cs)
+{
+    switch(op) {
+    case Expr::StartsWith:   return s.startsWith(c, cs);
+    case Expr::Contains:     return s.contains(c, cs);
+    case Expr::Equal:        return s.compare(c, cs) == 0;
+    case Expr::NotEqual:     return s.compare(c, cs) != 0;
+    case Expr::Less:         return s.compare(c, cs) < 0;
+    case Expr::LessEqual:    return s.compare(c, cs) <= 0;
+    case Expr::Greater:      return s.compare(c, cs) > 0;
+    case Expr::GreaterEqual: return s.compare(c, cs) >= 0;
+    default:                 return false;
+    }
+}
+
+void KVListFilterPlan::evaluateLeaf(const Instruction &ins, const KVListEntry * const *entries, int count, char *out, qint64 now) const
+{
+    switch(ins.op) {
+    case Expr::IsNull:
+        for(int i=0; i<count; i++) {
+            QVariant v = entries[i]->getValue(ins.key);
+            out[i] = !v.isValid() || v.isNull();
+        }
+        return;
+    case Expr::IsNotNull:
+        for(int i=0; i<count; i++) {
+            QVariant v = entries[i]->getValue(ins.key);
+            out[i] = v.isValid() && !v.isNull();
+        }
+        return;
+    case Expr::In:
+        for(int i=0; i<count; i++)
+            out[i] = ins.list.contains(entries[i]->getValue(ins.key));
+        return;
+    default:
+        break;
+    }
+
+    switch(ins.type) {
+    case Number: {
+        // extract the column first, then compare in a tight loop
+        QVarLengthArray<double, BLOCK_SIZE> col(count);
+        QVarLengthArray<char, BLOCK_SIZE> valid(count);
+        for(int i=0; i<count; i++) {
+            QVariant v = entries[i]->getValue(ins.key);
+            bool ok = false;
+            col[i] = v.isNull() ? 0 : v.toDouble(&ok);
+            valid[i] = ok;
+        }
+        compareColumn<double>(ins.op, col.constData(), valid.constData(), count, ins.number, out);
+        break;
+    }
+    case Time: {
+        QVarLengthArray<qint64, BLOCK_SIZE> col(count);
+        QVarLengthArray<char, BLOCK_SIZE> valid(count);
+        for(int i=0; i<count; i++) {
+            QDateTime d = entries[i]->getValue(ins.key).toDateTime();
+            valid[i] = d.isValid();
+            col[i] = valid[i] ? d.toMSecsSinceEpoch() : 0;
+        }
+        qint64 c = ins.relativeToNow ? now + ins.time : ins.time;
+        compareColumn<qint64>(ins.op, col.constData(), valid.constData(), count, c, out);
+        break;
+    }
+    case Text:
+        for(int i=0; i<count; i++) {
+            QVariant v = entries[i]->getValue(ins.key);
+            out[i] = v.isValid() && compareText(ins.op, v.toString(), ins.text, ins.cs);
+        }
+        break;
+    case Generic:
+        for(int i=0; i<count; i++) {
+            QVariant v = entries[i]->getValue(ins.key);
+            if(ins.op == Expr::Equal)
+                out[i] = v.isValid() && v == ins.value;
+            else if(ins.op == Expr::NotEqual)
+                out[i] = v.isValid() && v != ins.value;
+            else
+                out[i] = 0;
+        }
+        break;
+    }
+}
@@ -0,0 +1,128 @@
+#ifndef KVLISTFILTEREXPRESSION_H
+#define KVLISTFILTEREXPRESSION_H
+
+#include <QVariant>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QSharedPointer>
+#include "kvlistentry.h"
+#include "kvlist_global.h"
+
+/**
+ * @brief The KVListFilterExpression class
+ *
+ * Describes a filter on the keyed values of KVListEntries. Expressions are cheap to copy and
+ * can be combined with &&, || and !.
+ *
+ * <code>
+ * typedef KVListFilterExpression F;
+ * F f = F::compareToNow(FriendsEntry::lastseen, F::Greater, -7*24*3600)   // seen within the last week
+ *       && (F::startsWith(FriendsEntry::firstname, "Jo") || F::isNull(FriendsEntry::email));
+ * filteredModel->setFilterExpression(f);
+ * </code>
+ *
+ * From QML the same can be expressed as (see fromVariant()):
+ * <code>
+ * filteredModel.setFilterExpression({ and: [
+ *     { key: "lastseen", op: ">", value: "now-7d" },
+ *     { or: [ { key: "firstname", op: "startsWith", value: "Jo" }, { key: "email", op: "isNull" } ] }
+ * ]})
+ * </code>
+ *
+ * Use KVListFilterPlan to evaluate an expression.
+ */
+class KVLIST_EXPORT KVListFilterExpression
+{
+public:
+    enum Op { And, Or, Not,
+              Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual,
+              StartsWith, Contains, IsNull, IsNotNull, In };
+
+    // a null expression matches everything
+    KVListFilterExpression() = default;
+    bool isNull() const { return node_.isNull(); }
+
+    // compare the value of 'key' with 'value'; the type of 'value' decides how values are compared
+    // (numbers/bools as numbers, strings as strings, QDate/QDateTime as points in time, anything else via QVariant ==)
+    static KVListFilterExpression compare(KVListEntry::Key key, Op op, const QVariant &value);
+    // compare a point in time with 'now + offsetSecs' (evaluated each time the filter runs)
+    static KVListFilterExpression compareToNow(KVListEntry::Key key, Op op, qint64 offsetSecs);
+
+    static KVListFilterExpression equals(KVListEntry::Key key, const QVariant &value) { return compare(key, Equal, value); }
+    static KVListFilterExpression between(KVListEntry::Key key, const QVariant &min, const QVariant &max);
+    static KVListFilterExpression startsWith(KVListEntry::Key key, const QString &prefix, Qt::CaseSensitivity cs = Qt::CaseInsensitive);
+    static KVListFilterExpression contains(KVListEntry::Key key, const QString &text, Qt::CaseSensitivity cs = Qt::CaseInsensitive);
+    static KVListFilterExpression isNull(KVListEntry::Key key);
+    static KVListFilterExpression isNotNull(KVListEntry::Key key);
+    static KVListFilterExpression in(KVListEntry::Key key, const QVariantList &values);
+
+    KVListFilterExpression operator&&(const KVListFilterExpression &other) const;
+    KVListFilterExpression operator||(const KVListFilterExpression &other) const;
+    KVListFilterExpression operator!() const;
+
+    // create from a QVariantMap (e.g. a javascript object) as shown above; keys are resolved via roleNames
+    // supported ops: == != < <= > >= startsWith contains isNull notNull in between
+    // time values of the form "now", "now-7d", "now+2h" (s, m, h, d, w) are relative to the evaluation time
+    static KVListFilterExpression fromVariant(const QVariant &expression, const QHash<int, QByteArray> &roleNames, QString *error = nullptr);
+
+private:
+    friend class KVListFilterPlan;
+    struct Node;
+    static KVListFilterExpression create(Node *node);
+    static KVListFilterExpression combine(Op op, const KVListFilterExpression &a, const KVListFilterExpression &b);
+
+    QSharedPointer<const Node> node_;
+};
+
+
+/**
+ * @brief The KVListFilterPlan class
+ *
+ * A KVListFilterExpression compiled into a typed evaluation plan (postfix program with
+ * pre-converted constants).
+ *
+ * evaluate() works in batches: for every comparison the needed values are extracted into a
+ * typed column first and compared in a tight loop; results are combined as byte masks.
+ * Large inputs are split into blocks which are evaluated on the thread pool.
+ * Values are read via KVListEntry::getValue() (not via QAbstractItemModel::data()).
+ */
+class KVLIST_EXPORT KVListFilterPlan
+{
+public:
+    KVListFilterPlan() = default;
+    explicit KVListFilterPlan(const KVListFilterExpression &expression);
+
+    // an empty plan matches everything
+    bool isEmpty() const { return program_.isEmpty(); }
+
+    // result[i] != 0 in case entries[i] matches
+    QVector<char> evaluate(const QVector<KVListEntry*> &entries) const;
+    bool matches(const KVListEntry *entry) const;
+
+    // keys the result depends on
+    QSet<KVListEntry::Key> keys() const;
+
+private:
+    enum ValueType { Number, Text, Time, Generic };
+    struct Instruction {
+        KVListFilterExpression::Op op = KVListFilterExpression::And;
+        KVListEntry::Key key = -1;
+        ValueType type = Generic;
+        double number = 0;
+        QString text;
+        qint64 time = 0;
+        bool relativeToNow = false;
+        QVariant value;
+        QVariantList list;
+        Qt::CaseSensitivity cs = Qt::CaseSensitive;
+    };
+
+    void compile(const KVListFilterExpression &expression);
+    void evaluateBlock(const KVListEntry * const *entries, int count, char *out, qint64 now) const;
+    void evaluateLeaf(const Instruction &ins, const KVListEntry * const *entries, int count, char *out, qint64 now) const;
+
+    QVector<Instruction> program_;
+};
+
+#endif // KVLISTFILTEREXPRESSION_H
@@ -0,0 +1,467 @@
+#include "kvlistgroupedmodel.h"
+#include <algorithm>
+
+
+KVListGroupedModel::KVListGroupedModel(QObject *parent) :
+    QAbstractListModel(parent)
+{
+}
+
+KVListGroupedModel::KVListGroupedModel(KVListModel *source, QObject *parent) :
+    QAbstractListModel(parent)
+{
+    setSourceModel(source);
+}
+
+KVListGroupedModel::~KVListGroupedModel()
+{
+    qDeleteAll(groups_);
+}
+
+void KVListGroupedModel::setSourceModel(KVListModel *model)
+{
+    if(model == source_)
+        return;
+
+    if(source_)
+        disconnect(source_, nullptr, this, nullptr);
+
+    source_ = model;
+    if(source_) {
+        connect(source_, &QAbstractItemModel::dataChanged, this,
+                [this](const QModelIndex &tl, const QModelIndex &br, const QVector<int> &roles) {
+                    sourceDataChanged(tl.row(), br.row(), roles); });
+        connect(source_, &QAbstractItemModel::rowsInserted, this,
+                [this](const QModelIndex &, int first, int last) { sourceRowsInserted(first, last); });
+        connect(source_, &QAbstractItemModel::rowsAboutToBeRemoved, this,
+                [this](const QModelIndex &, int first, int last) { sourceRowsAboutToBeRemoved(first, last); });
+        connect(source_, &QAbstractItemModel::rowsRemoved, this,
+                [this](const QModelIndex &, int first, int last) { sourceRowsRemoved(first, last); });
+        // the order within the groups changes: start over
+        connect(source_, &QAbstractItemModel::rowsMoved, this, &KVListGroupedModel::rebuild);
+        connect(source_, &QAbstractItemModel::layoutChanged, this, &KVListGroupedModel::rebuild);
+        connect(source_, &QAbstractItemModel::modelReset, this, &KVListGroupedModel::rebuild);
+        connect(source_, &QObject::destroyed, this, [this]() {
+            source_ = nullptr;
+            rebuild();
+            emit sourceModelChanged();
+        });
+        resolveGroupKeyName();
+    }
+
+    rebuild();
+    emit sourceModelChanged();
+}
+
+void KVListGroupedModel::setGroupKey(KVListEntry::Key key, bool firstLetterOnly)
+{
+    if(firstLetterOnly)
+        groupFunc_ = firstLetter(key);
+    else
+        groupFunc_ = [key](const KVListEntry *e) { return e->getValue(key).toString(); };
+    dependsOn_ = { key };
+    firstLetterOnly_ = firstLetterOnly;
+    if(source_)
+        groupKeyName_ = QString::fromLatin1(source_->roleNames().value(key));
+
+    rebuild();
+    emit groupingChanged();
+}
+
+void KVListGroupedModel::setGroupKeyName(const QString &name)
+{
+    if(groupKeyName_ == name)
+        return;
+    groupKeyName_ = name;
+    resolveGroupKeyName();
+    rebuild();
+    emit groupingChanged();
+}
+
+void KVListGroupedModel::setFirstLetterOnly(bool firstLetterOnly)
+{
+    if(firstLetterOnly_ == firstLetterOnly)
+        return;
+    firstLetterOnly_ = firstLetterOnly;
+    resolveGroupKeyName();
+    rebuild();
+    emit groupingChanged();
+}
+
+void KVListGroupedModel::resolveGroupKeyName()
+{
+    if(!source_ || groupKeyName_.isEmpty())
+        return;
+
+    KVListEntry::Key key = source_->roleNames().key(groupKeyName_.toUtf8(), -1);
+    if(key < 0) {
+        qWarning(kvlist) << "grouped model: unknown key" << groupKeyName_;
+        return;
+    }
+
+    if(firstLetterOnly_)
+        groupFunc_ = firstLetter(key);
+    else
+        groupFunc_ = [key](const KVListEntry *e) { return e->getValue(key).toString(); };
+    dependsOn_ = { key };
+}
+
+void KVListGroupedModel::setGroupFunction(GroupFunc func, const QVector<KVListEntry::Key> &dependsOn)
+{
+    groupFunc_ = func;
+    dependsOn_ = dependsOn;
+    groupKeyName_.clear();
+
+    rebuild();
+    emit groupingChanged();
+}
+
+KVListGroupedModel::GroupFunc KVListGroupedModel::firstLetter(KVListEntry::Key key)
+{
+    return [key](const KVListEntry *e) {
+        QString s = e->getValue(key).toString().trimmed();
+        if(s.isEmpty())
+            return QString();
+        // "É" -> "E"
+        return QString(s.at(0)).normalized(QString::NormalizationForm_D).left(1).toUpper();
+    };
+}
+
+QString KVListGroupedModel::groupOf(const KVListEntry *entry) const
+{
+    return groupFunc_ ? groupFunc_(entry) : QString();
+}
+
+void KVListGroupedModel::rebuild()
+{
+    const int oldGroups = groups_.size();
+
+    beginResetModel();
+    qDeleteAll(groups_);
+    groups_.clear();
+    groupByKey_.clear();
+    rowGroup_.clear();
+
+    if(source_) {
+        const int size = source_->size();
+        rowGroup_.resize(size);
+        for(int row=0; row<size; row++) {
+            const QString key = groupOf(source_->at(row));
+            Group *g = groupByKey_.value(key);
+            if(!g) {
+                g = new Group;
+                g->key = key;
+                g->expanded = !collapsed_.contains(key);
+                groups_ << g;
+                groupByKey_.insert(key, g);
+            }
+            g->rows << row;
+            rowGroup_[row] = g;
+        }
+
+        std::sort(groups_.begin(), groups_.end(), [](const Group *a, const Group *b) { return a->key < b->key; });
+    }
+    dirty_ = true;
+    endResetModel();
+
+    if(oldGroups != groups_.size())
+        emit groupCountChanged();
+}
+
+void KVListGroupedModel::updateRows() const
+{
+    if(!dirty_)
+        return;
+
+    int row = 0;
+    for(int i=0; i<groups_.size(); i++) {
+        Group *g = groups_[i];
+        g->index = i;
+        g->firstRow = row;
+        row += 1 + (g->expanded ? g->rows.size() : 0);
+    }
+    rows_ = row;
+    dirty_ = false;
+}
+
+KVListGroupedModel::Group *KVListGroupedModel::groupAt(int row, int *member) const
+{
+    updateRows();
+    if(row < 0 || row >= rows_)
+        return nullptr;
+
+    // last group starting at or before 'row'
+    auto it = std::upper_bound(groups_.constBegin(), groups_.constEnd(), row,
+                               [](int r, const Group *g) { return r < g->firstRow; });
+    Group *g = *(it - 1);
+    *member = row - g->firstRow - 1;
+    return g;
+}
+
+QStringList KVListGroupedModel::groups() const
+{
+    QStringList keys;
+    keys.reserve(groups_.size());
+    for(const Group *g : groups_)
+        keys << g->key;
+    return keys;
+}
+
+int KVListGroupedModel::count(const QString &group) const
+{
+    const Group *g = groupByKey_.value(group);
+    return g ? g->rows.size() : 0;
+}
+
+void KVListGroupedModel::setGroupExpanded(const QString &group, bool expanded)
+{
+    if(expanded)
+        collapsed_.remove(group);
+    else
+        collapsed_.insert(group);
+
+    Group *g = groupByKey_.value(group);
+    if(!g || g->expanded == expanded)
+        return;
+
+    updateRows();
+    const int header = g->firstRow;
+    if(expanded)
+        beginInsertRows(QModelIndex(), header + 1, header + g->rows.size());
+    else
+        beginRemoveRows(QModelIndex(), header + 1, header + g->rows.size());
+    g->expanded = expanded;
+    dirty_ = true;
+    if(expanded)
+        endInsertRows();
+    else
+        endRemoveRows();
+
+    emit dataChanged(index(header), index(header), { GROUP_EXPANDED });
+}
+
+KVListEntry *KVListGroupedModel::at(int row) const
+{
+    const int sourceRow = mapToSource(row);
+    return sourceRow >= 0 ? source_->at(sourceRow) : nullptr;
+}
+
+int KVListGroupedModel::mapToSource(int row) const
+{
+    int member;
+    Group *g = groupAt(row, &member);
+    return g && member >= 0 && source_ ? g->rows.at(member) : -1;
+}
+
+void KVListGroupedModel::addMember(int sourceRow, const QString &key)
+{
+    updateRows();
+
+    Group *g = groupByKey_.value(key);
+    if(!g) {
+        // new group: header (and the entry) at the sorted position
+        auto it = std::lower_bound(groups_.begin(), groups_.end(), key,
+                                   [](const Group *a, const QString &k) { return a->key < k; });
+        const int i = int(it - groups_.begin());
+        const int row = i < groups_.size() ? groups_[i]->firstRow : rows_;
+
+        g = new Group;
+        g->key = key;
+        g->rows << sourceRow;
+        g->expanded = !collapsed_.contains(key);
+
+        beginInsertRows(QModelIndex(), row, row + (g->expanded ? 1 : 0));
+        groups_.insert(i, g);
+        groupByKey_.insert(key, g);
+        rowGroup_[sourceRow] = g;
+        dirty_ = true;
+        endInsertRows();
+
+        emit groupCountChanged();
+        return;
+    }
+
+    const int pos = int(std::lower_bound(g->rows.begin(), g->rows.end(), sourceRow) - g->rows.begin());
+    const int header = g->firstRow;
+    if(g->expanded)
+        beginInsertRows(QModelIndex(), header + 1 + pos, header + 1 + pos);
+    g->rows.insert(pos, sourceRow);
+    rowGroup_[sourceRow] = g;
+    dirty_ = true;
+    if(g->expanded)
+        endInsertRows();
+
+    emit dataChanged(index(header), index(header), { GROUP_COUNT });
+}
+
+void KVListGroupedModel::removeMember(int sourceRow)
+{
+    Group *g = rowGroup_.value(sourceRow);
+    if(!g)
+        return;
+
+    updateRows();
+    const int header = g->firstRow;
+    rowGroup_[sourceRow] = nullptr;
+
+    if(g->rows.size() == 1) {
+        // last entry: the group goes away
+        beginRemoveRows(QModelIndex(), header, header + (g->expanded ? 1 : 0));
+        groups_.remove(g->index);
+        groupByKey_.remove(g->key);
+        delete g;
+        dirty_ = true;
+        endRemoveRows();
+
+        emit groupCountChanged();
+        return;
+    }
+
+    const int pos = int(std::lower_bound(g->rows.begin(), g->rows.end(), sourceRow) - g->rows.begin());
+    Q_ASSERT(pos < g->rows.size() && g->rows.at(pos) == sourceRow);
+    if(g->expanded)
+        beginRemoveRows(QModelIndex(), header + 1 + pos, header + 1 + pos);
+    g->rows.remove(pos);
+    dirty_ = true;
+    if(g->expanded)
+        endRemoveRows();
+
+    emit dataChanged(index(header), index(header), { GROUP_COUNT });
+}
+
+void KVListGroupedModel::shiftRows(int from, int delta)
+{
+    // the members are sorted: only the tail of each group is affected
+    for(Group *g : groups_) {
+        auto it = std::lower_bound(g->rows.begin(), g->rows.end(), from);
+        for(; it != g->rows.end(); ++it)
+            *it += delta;
+    }
+}
+
+int KVListGroupedModel::rowCount(const QModelIndex &parent) const
+{
+    if(parent.isValid())
+        return 0;
+    updateRows();
+    return rows_;
+}
+
+QVariant KVListGroupedModel::data(const QModelIndex &index, int role) const
+{
+    int member;
+    Group *g = index.isValid() ? groupAt(index.row(), &member) : nullptr;
+    if(!g)
+        return QVariant();
+
+    switch(role) {
+    case GROUP_KEY:       return g->key;
+    case GROUP_COUNT:     return g->rows.size();
+    case GROUP_EXPANDED:  return g->expanded;
+    case IS_GROUP_HEADER: return member < 0;
+    default:              break;
+    }
+
+    if(member < 0 || !source_)
+        return QVariant();
+    return source_->data(source_->index(g->rows.at(member)), role);
+}
+
+bool KVListGroupedModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    // the change (and a new group) comes back via dataChanged() of the source
+    const int sourceRow = index.isValid() ? mapToSource(index.row()) : -1;
+    if(sourceRow < 0)
+        return false;
+    return source_->setData(source_->index(sourceRow), value, role);
+}
+
+Qt::ItemFlags KVListGroupedModel::flags(const QModelIndex &index) const
+{
+    int member;
+    Group *g = index.isValid() ? groupAt(index.row(), &member) : nullptr;
+    if(!g)
+        return Qt::NoItemFlags;
+    if(member < 0 || !source_)
+        return Qt::ItemIsEnabled;
+    return source_->flags(source_->index(g->rows.at(member)));
+}
+
+QHash<int, QByteArray> KVListGroupedModel::roleNames() const
+{
+    QHash<int, QByteArray> names = source_ ? source_->roleNames() : QHash<int, QByteArray>();
+    names.insert(GROUP_KEY, "groupKey");
+    names.insert(GROUP_COUNT, "groupCount");
+    names.insert(GROUP_EXPANDED, "groupExpanded");
+    names.insert(IS_GROUP_HEADER, "isGroupHeader");
+    return names;
+}
+
+void KVListGroupedModel::sourceDataChanged(int first, int last, const QVector<int> &roles)
+{
+    bool regroup = dependsOn_.isEmpty() || roles.isEmpty();
+    for(int i=0; i<roles.size() && !regroup; i++)
+        regroup = dependsOn_.contains(roles.at(i));
+
+    // contiguous rows of this model get one dataChanged()
+    int runFirst = -1, runLast = -1;
+    auto flush = [&]() {
+        if(runFirst >= 0)
+            emit dataChanged(index(runFirst), index(runLast), roles);
+        runFirst = runLast = -1;
+    };
+
+    last = qMin(last, rowGroup_.size() - 1);
+    for(int sourceRow = first; sourceRow <= last; sourceRow++) {
+        Group *g = rowGroup_.at(sourceRow);
+        if(!g)
+            continue;
+
+        if(regroup) {
+            const QString key = groupOf(source_->at(sourceRow));
+            if(key != g->key) {
+                flush();
+                removeMember(sourceRow);
+                addMember(sourceRow, key);
+                continue;
+            }
+        }
+
+        if(!g->expanded)
+            continue;
+        updateRows();
+        const int pos = int(std::lower_bound(g->rows.constBegin(), g->rows.constEnd(), sourceRow) - g->rows.constBegin());
+        const int row = g->firstRow + 1 + pos;
+        if(row == runLast + 1) {
+            runLast = row;
+        } else {
+            flush();
+            runFirst = runLast = row;
+        }
+    }
+    flush();
+}
+
+void KVListGroupedModel::sourceRowsInserted(int first, int last)
+{
+    const int count = last - first + 1;
+    shiftRows(first, count);
+    rowGroup_.insert(first, count, nullptr);
+
+    for(int sourceRow = first; sourceRow <= last; sourceRow++)
+        addMember(sourceRow, groupOf(source_->at(sourceRow)));
+}
+
+void KVListGroupedModel::sourceRowsAboutToBeRemoved(int first, int last)
+{
+    // while the entries still exist
+    for(int sourceRow = last; sourceRow >= first; sourceRow--)
+        removeMember(sourceRow);
+}
+
+void KVListGroupedModel::sourceRowsRemoved(int first, int last)
+{
+    const int count = last - first + 1;
+    rowGroup_.remove(first, count);
+    shiftRows(last + 1, -count);
+}
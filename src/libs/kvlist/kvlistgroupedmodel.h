@@ -0,0 +1,149 @@
+#ifndef KVLISTGROUPEDMODEL_H
+#define KVLISTGROUPEDMODEL_H
+
+#include <QAbstractListModel>
+#include <QPointer>
+#include <QHash>
+#include <QSet>
+#include <functional>
+#include "kvlistentry.h"
+#include "kvlistmodel.h"
+#include "kvlist_global.h"
+
+/**
+ * @brief The KVListGroupedModel class
+ *
+ * Groups the entries of a KVListModel, e.g. friends by the first letter of their name: every group
+ * is one header row followed by its entries (in source order). Groups are sorted by their name and
+ * can be collapsed, which hides their entries but keeps the header.
+ *
+ * An entry's group is the value of a key (optionally only its first letter) or the result of a
+ * group function. Membership and counts are maintained incrementally: a changed entry only re-evaluates
+ * its own group, inserts / removals only evaluate the new rows. Only moves, layout changes and resets
+ * of the source rebuild all groups.
+ *
+ * Besides the roles of the source the model provides groupKey, groupCount, groupExpanded and
+ * isGroupHeader (for header and entry rows).
+ *
+ * <code>
+ * KVListGroupedModel *g = new KVListGroupedModel(friendsModel);
+ * g->setGroupFunction(KVListGroupedModel::firstLetter(FriendsEntry::surname), { FriendsEntry::surname });
+ * </code>
+ *
+ * From QML (after qmlRegisterType<KVListGroupedModel>()):
+ * <code>
+ * KVListGroupedModel { id: grouped; sourceModel: FriendsModel; groupKeyName: "surname"; firstLetterOnly: true }
+ * ListView { model: grouped; delegate: isGroupHeader ? header : friend }   // header: grouped.toggleGroup(groupKey)
+ * </code>
+ *
+ * Notes:
+ * - per member the group keeps its source row; inserting / removing source rows shifts these integers
+ *   (no values are evaluated for that)
+ * - entries without a group value are collected in the group "" (sorted first)
+ */
+class KVLIST_EXPORT KVListGroupedModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(KVListModel* sourceModel READ sourceModel WRITE setSourceModel NOTIFY sourceModelChanged)
+    Q_PROPERTY(QString groupKeyName READ groupKeyName WRITE setGroupKeyName NOTIFY groupingChanged)
+    Q_PROPERTY(bool firstLetterOnly READ firstLetterOnly WRITE setFirstLetterOnly NOTIFY groupingChanged)
+    Q_PROPERTY(int groupCount READ groupCount NOTIFY groupCountChanged)
+
+public:
+    typedef std::function<QString (const KVListEntry *entry)> GroupFunc;
+
+    enum EnGroupRoles {
+        GROUP_KEY = KVListEntry::InternalKeysStartAt + 16,
+        GROUP_COUNT,
+        GROUP_EXPANDED,
+        IS_GROUP_HEADER
+    };
+    Q_ENUM(EnGroupRoles)
+
+    explicit KVListGroupedModel(QObject *parent = nullptr);
+    KVListGroupedModel(KVListModel *source, QObject *parent = nullptr);
+    virtual ~KVListGroupedModel();
+
+    KVListModel *sourceModel() const { return source_; }
+    void setSourceModel(KVListModel *model);
+
+    // group by the value of a key
+    void setGroupKey(KVListEntry::Key key, bool firstLetterOnly = false);
+    QString groupKeyName() const { return groupKeyName_; }
+    void setGroupKeyName(const QString &name);
+    bool firstLetterOnly() const { return firstLetterOnly_; }
+    void setFirstLetterOnly(bool firstLetterOnly);
+
+    // group by a function of the entry; only changes of 'dependsOn' re-evaluate it (all keys if empty)
+    void setGroupFunction(GroupFunc func, const QVector<KVListEntry::Key> &dependsOn = QVector<KVListEntry::Key>());
+    // upper case first letter of the value of 'key'
+    static GroupFunc firstLetter(KVListEntry::Key key);
+
+    int groupCount() const { return groups_.size(); }
+    Q_INVOKABLE QStringList groups() const;
+    // number of entries in a group
+    Q_INVOKABLE int count(const QString &group) const;
+
+    Q_INVOKABLE bool isGroupExpanded(const QString &group) const { return !collapsed_.contains(group); }
+    Q_INVOKABLE void setGroupExpanded(const QString &group, bool expanded);
+    Q_INVOKABLE void toggleGroup(const QString &group) { setGroupExpanded(group, !isGroupExpanded(group)); }
+
+    // entry / source row of a row; nullptr / -1 for group headers
+    Q_INVOKABLE KVListEntry *at(int row) const;
+    Q_INVOKABLE int mapToSource(int row) const;
+
+    // QAbstractListModel impl
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    bool setData(const QModelIndex &index, const QVariant &value, int role) override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+signals:
+    void sourceModelChanged();
+    void groupingChanged();
+    void groupCountChanged();
+
+private:
+    struct Group {
+        QString key;
+        QVector<int> rows;      // source rows of the members, ascending
+        bool expanded;
+        int index;              // position in groups_
+        int firstRow;           // row of the header
+    };
+
+    void rebuild();
+    void resolveGroupKeyName();
+    QString groupOf(const KVListEntry *entry) const;
+
+    // position of the groups / number of rows, recomputed after structural changes
+    void updateRows() const;
+    // group and member of a row (member -1: header)
+    Group *groupAt(int row, int *member) const;
+
+    void addMember(int sourceRow, const QString &key);
+    void removeMember(int sourceRow);
+    void shiftRows(int from, int delta);
+
+    void sourceDataChanged(int first, int last, const QVector<int> &roles);
+    void sourceRowsInserted(int first, int last);
+    void sourceRowsAboutToBeRemoved(int first, int last);
+    void sourceRowsRemoved(int first, int last);
+
+    QPointer<KVListModel> source_;
+    GroupFunc groupFunc_;
+    QVector<KVListEntry::Key> dependsOn_;
+    QString groupKeyName_;
+    bool firstLetterOnly_ = false;
+
+    QVector<Group*> groups_;                // sorted by key
+    QHash<QString, Group*> groupByKey_;
+    QVector<Group*> rowGroup_;              // group per source row
+    QSet<QString> collapsed_;               // kept across rebuilds
+
+    mutable bool dirty_ = false;
+    mutable int rows_ = 0;
+};
+
+#endif // KVLISTGROUPEDMODEL_H
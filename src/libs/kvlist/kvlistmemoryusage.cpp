@@ -0,0 +1,292 @@
+#include "kvlistmemoryusage.h"
+#include "kvlistmodel.h"
+#include "kvlistentry.h"
+#include "kvlistfilteredmodel.h"
+#include <QMap>
+#include <QHash>
+#include <QUrl>
+#include <QMetaType>
+
+// bookkeeping of the allocator per allocation
+static const qint64 ALLOC_OVERHEAD = 16;
+// Qt's private objects (rough sizes for Qt 5, 64 bit)
+static const qint64 QOBJECT_PRIVATE_SIZE = 200;
+static const qint64 PROXY_PRIVATE_SIZE = 600;
+static const qint64 URL_PRIVATE_SIZE = 80;
+// container internals (header / per node bookkeeping besides key and value; rough sizes, 64 bit)
+static const qint64 MAP_HEADER_SIZE = 56;
+static const qint64 MAP_NODE_OVERHEAD = 24;     // parent+color, left, right
+static const qint64 HASH_HEADER_SIZE = 48;
+static const qint64 HASH_NODE_OVERHEAD = 16;    // next, hash value
+static const qint64 LIST_HEADER_SIZE = 16;
+
+static qint64 alloc(qint64 size)
+{
+    return size + ALLOC_OVERHEAD;
+}
+
+// data block of QString, QByteArray, QVector
+static qint64 arrayBytes(int capacity, qint64 elementSize)
+{
+    return capacity > 0 ? alloc(sizeof(QArrayData) + capacity * elementSize) : 0;
+}
+
+static qint64 stringBytes(const QString &s)
+{
+    return s.isNull() ? 0 : arrayBytes(s.capacity() + 1, sizeof(QChar));
+}
+
+// map structure without the payload of the values (only public API, the internals differ between Qt versions)
+static qint64 mapNodeBytes(qint64 keySize, qint64 valueSize)
+{
+    return alloc(MAP_NODE_OVERHEAD + keySize + valueSize);
+}
+
+template<class K, class V>
+static qint64 mapBytes(const QMap<K, V> &map)
+{
+    if(map.isEmpty())
+        return 0;
+    return alloc(MAP_HEADER_SIZE) + map.size() * mapNodeBytes(sizeof(K), sizeof(V));
+}
+
+template<class K, class V>
+static qint64 hashBytes(const QHash<K, V> &hash)
+{
+    if(hash.isEmpty())
+        return 0;
+    return alloc(HASH_HEADER_SIZE) + arrayBytes(hash.capacity(), sizeof(void*))
+            + hash.size() * alloc(HASH_NODE_OVERHEAD + sizeof(K) + sizeof(V));
+}
+
+template<class T>
+static qint64 setBytes(const QSet<T> &set)
+{
+    if(set.isEmpty())
+        return 0;
+    return alloc(HASH_HEADER_SIZE) + arrayBytes(set.capacity(), sizeof(void*))
+            + set.size() * alloc(HASH_NODE_OVERHEAD + sizeof(T));
+}
+
+static qint64 listBytes(int size, qint64 elementSize)
+{
+    if(size == 0)
+        return 0;
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    // QList stores large types (like QVariant) as pointers to separately allocated elements
+    if(elementSize > qint64(sizeof(void*)))
+        return alloc(LIST_HEADER_SIZE + size * qint64(sizeof(void*))) + size * alloc(elementSize);
+    return alloc(LIST_HEADER_SIZE + size * qint64(sizeof(void*)));
+#else
+    // QList is QVector
+    return arrayBytes(size, elementSize);
+#endif
+}
+
+
+KVListMemoryUsage KVListMemoryUsage::measure(const KVListModel *model)
+{
+    KVListMemoryUsage usage;
+    if(model) {
+        usage.rows_ = model->size();
+        usage.addModel(model);
+    }
+    return usage;
+}
+
+qint64 KVListMemoryUsage::total() const
+{
+    qint64 sum = 0;
+    for(int i=0; i<CategoryCount; i++)
+        sum += bytes_[i];
+    return sum;
+}
+
+QString KVListMemoryUsage::categoryName(Category category)
+{
+    switch(category) {
+    case Models:         return "models";
+    case Roles:          return "roles";
+    case Entries:        return "entries";
+    case Values:         return "values";
+    case ShadowedValues: return "shadowedValues";
+    case Callbacks:      return "callbacks";
+    case LazyValues:     return "lazyValues";
+    case FilteredModels: return "filteredModels";
+    default:             return QString();
+    }
+}
+
+QVariantMap KVListMemoryUsage::toVariantMap() const
+{
+    QVariantMap categories;
+    for(int i=0; i<CategoryCount; i++)
+        categories.insert(categoryName(Category(i)), bytes_[i]);
+
+    QVariantMap keys;
+    for(auto i = keyBytes_.constBegin(); i != keyBytes_.constEnd(); ++i)
+        keys.insert(i.key(), i.value());
+
+    return {
+        {"total", total()},
+        {"rows", rows_},
+        {"totalRows", totalRows_},
+        {"models", modelCount_},
+        {"bytesPerRow", bytesPerRow()},
+        {"categories", categories},
+        {"keys", keys},
+    };
+}
+
+qint64 KVListMemoryUsage::payloadSize(const QVariant &value)
+{
+    const int type = value.userType();
+
+    switch(type) {
+    case QMetaType::UnknownType:
+        return 0;
+    case QMetaType::QString:
+        return stringBytes(value.toString());
+    case QMetaType::QByteArray: {
+        QByteArray b = value.toByteArray();
+        return b.isNull() ? 0 : arrayBytes(b.capacity() + 1, 1);
+    }
+    case QMetaType::QUrl: {
+        QUrl url = value.toUrl();
+        return url.isEmpty() ? 0 : alloc(URL_PRIVATE_SIZE) + stringBytes(url.toString());
+    }
+    case QMetaType::QStringList: {
+        QStringList list = value.toStringList();
+        qint64 size = listBytes(list.size(), sizeof(QString));
+        for(const QString &s : list)
+            size += stringBytes(s);
+        return size;
+    }
+    case QMetaType::QVariantList: {
+        QVariantList list = value.toList();
+        qint64 size = listBytes(list.size(), sizeof(QVariant));
+        for(const QVariant &v : list)
+            size += payloadSize(v);
+        return size;
+    }
+    case QMetaType::QVariantMap: {
+        QVariantMap map = value.toMap();
+        qint64 size = mapBytes(map);
+        for(auto i = map.constBegin(); i != map.constEnd(); ++i)
+            size += stringBytes(i.key()) + payloadSize(i.value());
+        return size;
+    }
+    default:
+        break;
+    }
+
+    // child models etc. are measured on their own
+    if(QMetaType::typeFlags(type) & QMetaType::PointerToQObject)
+        return 0;
+
+    // anything larger than a pointer is stored in a shared, separately allocated object;
+    // QDateTime and friends keep short data inline
+    const int size = QMetaType::sizeOf(type);
+    if(size > int(sizeof(void*)))
+        return alloc(2 * sizeof(void*)) + alloc(size);
+    return 0;
+}
+
+void KVListMemoryUsage::addModel(const KVListModel *model)
+{
+    if(!model || visited_.contains(model))
+        return;
+    visited_.insert(model);
+
+    modelCount_++;
+    totalRows_ += model->entries_.size();
+
+    qint64 pending = hashBytes(model->pendingChanges_);
+    for(const QSet<int> &roles : model->pendingChanges_)
+        pending += setBytes(roles);
+
+    bytes_[Models] += alloc(sizeof(KVListModel)) + QOBJECT_PRIVATE_SIZE
+            + arrayBytes(model->entries_.capacity(), sizeof(void*))
+            + arrayBytes(model->observers_.capacity(), sizeof(void*))
+            + stringBytes(model->serializationFile_)
+            + pending;
+
+    bytes_[Roles] += hashBytes(model->roleNames_);
+    for(const QByteArray &name : model->roleNames_)
+        bytes_[Roles] += arrayBytes(name.capacity() + 1, 1);
+
+    QSet<const KVListModel::CbHandle*> handles;
+    bytes_[Callbacks] += mapBytes(model->entryChangedCallbacks_);
+    for(const QVector<KVListModel::CbHandle*> &v : model->entryChangedCallbacks_) {
+        bytes_[Callbacks] += arrayBytes(v.capacity(), sizeof(void*));
+        for(const KVListModel::CbHandle *h : v)
+            handles.insert(h);
+    }
+    bytes_[Callbacks] += handles.size() * alloc(sizeof(KVListModel::CbHandle));
+
+    for(const KVListEntry *e : model->entries_)
+        addEntry(e, model);
+}
+
+void KVListMemoryUsage::addEntry(const KVListEntry *entry, const KVListModel *model)
+{
+    bytes_[Entries] += alloc(sizeof(KVListEntry)) + QOBJECT_PRIVATE_SIZE;
+
+    const QString prefix = QString::fromLatin1(entry->metaObject()->className()) + QLatin1Char('.');
+    auto addValues = [&](const KVListEntry::KeyValueMap &values, Category category) {
+        if(values.isEmpty())
+            return;
+        bytes_[category] += alloc(MAP_HEADER_SIZE);
+        for(auto i = values.constBegin(); i != values.constEnd(); ++i) {
+            const qint64 size = mapNodeBytes(sizeof(KVListEntry::Key), sizeof(QVariant)) + payloadSize(i.value());
+            bytes_[category] += size;
+
+            QByteArray name = model->roleNames_.value(i.key());
+            keyBytes_[prefix + (name.isEmpty() ? QString::number(i.key()) : QString::fromLatin1(name))] += size;
+        }
+    };
+    addValues(entry->keyValueStore_, Values);
+    addValues(entry->keyValueStoreShadowed_, ShadowedValues);
+
+    QSet<const KVListEntry::CbHandle*> handles;
+    bytes_[Callbacks] += mapBytes(entry->keyModifiedCallbacks_);
+    for(const QVector<KVListEntry::CbHandle*> &v : entry->keyModifiedCallbacks_) {
+        bytes_[Callbacks] += arrayBytes(v.capacity(), sizeof(void*));
+        for(const KVListEntry::CbHandle *h : v)
+            handles.insert(h);
+    }
+    bytes_[Callbacks] += handles.size() * alloc(sizeof(KVListEntry::CbHandle));
+
+    bytes_[LazyValues] += mapBytes(entry->lazyValues_);
+
+    for(const QVariant &v : entry->keyValueStore_)
+        addChild(v);
+}
+
+void KVListMemoryUsage::addFilteredModel(const KVListFilteredModel *model)
+{
+    if(visited_.contains(model))
+        return;
+    visited_.insert(model);
+
+    // the proxy keeps two int vectors (source rows, proxy rows) for the mapping
+    const int sourceRows = model->source_ ? model->source_->size() : 0;
+    bytes_[FilteredModels] += alloc(sizeof(KVListFilteredModel)) + QOBJECT_PRIVATE_SIZE + PROXY_PRIVATE_SIZE
+            + arrayBytes(model->rowCount(), sizeof(int))
+            + arrayBytes(sourceRows, sizeof(int))
+            + arrayBytes(model->acceptCache_.capacity(), 1);
+
+    addModel(model->source_);
+}
+
+void KVListMemoryUsage::addChild(const QVariant &value)
+{
+    if(!(QMetaType::typeFlags(value.userType()) & QMetaType::PointerToQObject))
+        return;
+
+    QObject *o = value.value<QObject*>();
+    if(KVListModel *m = qobject_cast<KVListModel*>(o))
+        addModel(m);
+    else if(KVListFilteredModel *f = qobject_cast<KVListFilteredModel*>(o))
+        addFilteredModel(f);
+}
@@ -0,0 +1,85 @@
+#ifndef KVLISTMEMORYUSAGE_H
+#define KVLISTMEMORYUSAGE_H
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QVariant>
+#include "kvlist_global.h"
+
+class KVListModel;
+class KVListEntry;
+class KVListFilteredModel;
+
+/**
+ * @brief The KVListMemoryUsage class
+ *
+ * Estimates the heap memory of a KVListModel tree: the model itself, its entries, all values
+ * (including shadowed values), callback handles, lazy value factories, role tables and every
+ * child model or filtered model stored as a value.
+ *
+ * <code>
+ * KVListMemoryUsage usage = KVListMemoryUsage::measure(friendsModel);
+ * qDebug() << usage.total() << "bytes," << usage.bytesPerRow() << "per row";
+ * qDebug() << usage.keyBytes(); // e.g. "FriendsEntry.firstname" -> bytes
+ * </code>
+ *
+ * From QML: FriendsModel.memoryUsage() (see toVariantMap()).
+ *
+ * Notes:
+ * - these are estimations for 64 bit builds: container and allocator overhead is approximated,
+ *   Qt's private objects (QObjectPrivate, QSortFilterProxyModelPrivate) by a fixed size
+ * - members added by subclasses of KVListEntry / KVListModel are not included
+ * - values shared with other entries (implicit sharing) are counted for every entry
+ * - measure() must be called from the thread of the model
+ */
+class KVLIST_EXPORT KVListMemoryUsage
+{
+public:
+    enum Category {
+        Models,         // model objects, entry pointers, pending changes, observers
+        Roles,          // role name tables
+        Entries,        // entry objects
+        Values,         // value maps incl. payload
+        ShadowedValues,
+        Callbacks,      // onValueChanged() / onEntriesChanged() handles
+        LazyValues,     // factories of not yet created values
+        FilteredModels,
+        CategoryCount
+    };
+
+    // walk 'model' and all child models
+    static KVListMemoryUsage measure(const KVListModel *model);
+
+    qint64 total() const;
+    qint64 bytes(Category category) const { return bytes_[category]; }
+    static QString categoryName(Category category);
+
+    // value bytes (regular and shadowed) per "<entry class>.<key name>"
+    QHash<QString, qint64> keyBytes() const { return keyBytes_; }
+
+    // rows of the measured model / of all models in the tree
+    int rows() const { return rows_; }
+    int totalRows() const { return totalRows_; }
+    int modelCount() const { return modelCount_; }
+    qint64 bytesPerRow() const { return rows_ > 0 ? total() / rows_ : 0; }
+
+    // { total, rows, totalRows, models, bytesPerRow, categories: { name: bytes }, keys: { name: bytes } }
+    QVariantMap toVariantMap() const;
+
+    // heap memory of a value beyond sizeof(QVariant); pointers (e.g. child models) count as 0
+    static qint64 payloadSize(const QVariant &value);
+
+private:
+    void addModel(const KVListModel *model);
+    void addEntry(const KVListEntry *entry, const KVListModel *model);
+    void addFilteredModel(const KVListFilteredModel *model);
+    void addChild(const QVariant &value);
+
+    qint64 bytes_[CategoryCount] = {};
+    QHash<QString, qint64> keyBytes_;
+    int rows_ = 0, totalRows_ = 0, modelCount_ = 0;
+    QSet<const QObject*> visited_;
+};
+
+#endif // KVLISTMEMORYUSAGE_H
@@ -1,7 +1,21 @@
 #include "kvlistmodel.h"
 #include "kvlistserializerxml.h"
+#include "kvlistmodelobserver.h"
+#include "kvlistmemoryusage.h"
+#include "kvlisttrace.h"
+#include "kvlistentrypool.h"
+#include "kvlistblobstore.h"
 #include <QSet>
+#include <QDateTime>
 #include <QDebug>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QMutex>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QVarLengthArray>
+#include <QFile>
+#include <algorithm>
 
 #define DEBUG_DATA_ACCESS 0
 
@@ -9,11 +23,72 @@
     #error "debug macro set for non debug build"
 #endif
 
+// deSerializeAsync(): entries of the first batch (about a screenful), entries created between two
+// checks of the clock and the time one batch may take on the gui thread
+static const int LOAD_FIRST_BATCH = 32;
+static const int LOAD_GRAIN_SIZE = 8;
+static const int LOAD_SLICE_MSECS = 8;
+
+// share of the entry hash 'h' at 'row' in the model hash (splitmix64 finalizer): the model hash is the sum
+// of these, so a row is replaced by subtracting its old share and adding the new one
+static inline quint64 rowHash(quint64 h, int row)
+{
+    quint64 x = h ^ (quint64(row) * Q_UINT64_C(0x9E3779B97F4A7C15));
+    x = (x ^ (x >> 30)) * Q_UINT64_C(0xBF58476D1CE4E5B9);
+    x = (x ^ (x >> 27)) * Q_UINT64_C(0x94D049BB133111EB);
+    return x ^ (x >> 31);
+}
+
+namespace {
+class LoadJob : public QRunnable
+{
+public:
+    explicit LoadJob(const std::function<void ()> &func) : func_(func) {}
+    void run() override { func_(); }
+private:
+    std::function<void ()> func_;
+};
+}
+
+// shared between the model and the worker parsing the file
+struct KVListModel::AsyncLoad {
+    QMutex mutex;
+    KVListModel *model = nullptr;   // reset (under 'mutex') when the model is destroyed
+    KVListSerializerXml::ModelData root;
+    bool ok = false;
+    int next = 0;                   // next entry of 'root' to attach
+    QString file;                   // set in case the model was empty: the model equals the file afterwards
+    quint64 generation = 0;         // of the model after the last batch; differs on changes in between
+};
+
 KVListModel::KVListModel(const QMetaEnum &keysEnum, QObject *parent) : QAbstractListModel(parent){
     roleNames_ = setupModelRoleNames(keysEnum);
+
+    for(auto i = roleNames_.constBegin(); i != roleNames_.constEnd(); ++i) {
+        if(i.value().endsWith("_noserialize") || i.value().endsWith("_ns"))
+            transientKeys_.insert(i.key());
+    }
+
+    // also covers resets done by subclasses
+    connect(this, &QAbstractItemModel::modelAboutToBeReset, this, [this]() {
+        // every reset path: changes of the old entries are dropped (a recycled entry may come back at the same address)
+        pendingChanges_.clear();
+        for(KVListModelObserver *o : observers_)
+            o->modelAboutToBeReset(this);
+    });
+    connect(this, &QAbstractItemModel::modelReset, this, [this]() {
+        touch(0);
+        for(KVListModelObserver *o : observers_)
+            o->modelReset(this);
+    });
 }
 
 KVListModel::~KVListModel() {
+    if(asyncLoad_) {
+        QMutexLocker locker(&asyncLoad_->mutex);
+        asyncLoad_->model = nullptr;
+    }
+
     for(int role : entryChangedCallbacks_.keys())
         qDeleteAll(entryChangedCallbacks_[role]);
 
@@ -41,6 +116,31 @@ void KVListModel::prepend(KVListEntry *entry)
     insertInt(0, entry);
 }
 
+void KVListModel::appendEntries(const QVector<KVListEntry *> &entries)
+{
+    QVector<KVListEntry*> valid;
+    valid.reserve(entries.size());
+    for(KVListEntry *e : entries) {
+        if(e)
+            valid << e;
+    }
+    if(valid.isEmpty())
+        return;
+
+    const int first = entries_.size();
+    beginInsertRows(QModelIndex(), first, first + valid.size() - 1);
+    entries_ += valid;
+    for(KVListEntry *e : valid)
+        connectEntry(e);
+    endInsertRows();
+    touch(first);
+
+    for(int i=0; i<valid.size(); i++) {
+        for(KVListModelObserver *o : observers_)
+            o->entryInserted(this, first + i, valid[i]);
+    }
+}
+
 KVListEntry *KVListModel::takeAt(int i)
 {
     KVListEntry *e=nullptr;
@@ -68,6 +168,139 @@ void KVListModel::move(int from, int to)
 }
 
 
+bool KVListModel::applyPermutation(const QVector<int> &order)
+{
+    const int n = entries_.size();
+    if(order.size() != n) {
+        qWarning() << "invalid permutation recieved! size:" << order.size() << "expected:" << n;
+        return false;
+    }
+
+    QVector<int> newRowOf(n, -1);
+    bool identity = true;
+    for(int row=0; row<n; row++) {
+        int old = order[row];
+        if(old < 0 || old >= n || newRowOf[old] != -1) {
+            qWarning() << "invalid permutation recieved! index:" << old;
+            return false;
+        }
+        newRowOf[old] = row;
+        identity = identity && (old == row);
+    }
+    if(identity)
+        return true;
+
+    emit layoutAboutToBeChanged(QList<QPersistentModelIndex>(), QAbstractItemModel::VerticalSortHint);
+
+    QVector<KVListEntry*> reordered(n);
+    for(int row=0; row<n; row++)
+        reordered[row] = entries_[order[row]];
+    entries_.swap(reordered);
+
+    const QModelIndexList from = persistentIndexList();
+    QModelIndexList to;
+    to.reserve(from.size());
+    for(const QModelIndex &i : from)
+        to << index(newRowOf[i.row()], i.column());
+    changePersistentIndexList(from, to);
+
+    emit layoutChanged(QList<QPersistentModelIndex>(), QAbstractItemModel::VerticalSortHint);
+    touch(0);
+
+    for(KVListModelObserver *o : observers_)
+        o->entriesReordered(this, order);
+
+    return true;
+}
+
+void KVListModel::sort(const LessThanFunc &lessThan)
+{
+    QVector<int> order(entries_.size());
+    for(int i=0; i<order.size(); i++)
+        order[i] = i;
+
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b){
+        return lessThan(entries_[a], entries_[b]);
+    });
+    applyPermutation(order);
+}
+
+void KVListModel::sort(const QVector<SortKey> &keys)
+{
+    const int n = entries_.size();
+    if(keys.isEmpty() || n < 2)
+        return;
+
+    // fetch the values once instead of on every comparison
+    QVector<QVector<QVariant>> columns(keys.size());
+    for(int k=0; k<keys.size(); k++) {
+        columns[k].resize(n);
+        for(int row=0; row<n; row++)
+            columns[k][row] = entries_[row]->getValue(keys[k].key);
+    }
+
+    QVector<int> order(n);
+    for(int i=0; i<n; i++)
+        order[i] = i;
+
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b){
+        for(int k=0; k<keys.size(); k++) {
+            int c = compareValues(columns[k][a], columns[k][b]);
+            if(c != 0)
+                return keys[k].order == Qt::AscendingOrder ? c < 0 : c > 0;
+        }
+        return false;
+    });
+    applyPermutation(order);
+}
+
+int KVListModel::compareValues(const QVariant &a, const QVariant &b)
+{
+    bool aNull = !a.isValid() || a.isNull(), bNull = !b.isValid() || b.isNull();
+    if(aNull || bNull)
+        return int(bNull) - int(aNull);
+
+    auto isNumber = [](int type){
+        switch(type) {
+        case QMetaType::Bool:
+        case QMetaType::Int:
+        case QMetaType::UInt:
+        case QMetaType::LongLong:
+        case QMetaType::ULongLong:
+        case QMetaType::Double:
+        case QMetaType::Float:
+            return true;
+        default:
+            return false;
+        }
+    };
+
+    int ta = a.userType(), tb = b.userType();
+    if(isNumber(ta) && isNumber(tb)) {
+        double da = a.toDouble(), db = b.toDouble();
+        return da < db ? -1 : (db < da ? 1 : 0);
+    }
+    if(ta == tb) {
+        switch(ta) {
+        case QMetaType::QDateTime: {
+            QDateTime da = a.toDateTime(), db = b.toDateTime();
+            return da < db ? -1 : (db < da ? 1 : 0);
+        }
+        case QMetaType::QDate: {
+            QDate da = a.toDate(), db = b.toDate();
+            return da < db ? -1 : (db < da ? 1 : 0);
+        }
+        case QMetaType::QTime: {
+            QTime da = a.toTime(), db = b.toTime();
+            return da < db ? -1 : (db < da ? 1 : 0);
+        }
+        default:
+            break;
+        }
+    }
+    return QString::localeAwareCompare(a.toString(), b.toString());
+}
+
 void KVListModel::clear()
 {
     if(entries_.isEmpty())
@@ -82,17 +315,17 @@ void KVListModel::clear()
 
 void KVListModel::deleteAt(int i) {
     KVListEntry *e = takeAt(i);
-    if(e) delete e;
+    if(e) destroyEntry(e);
 }
 
 void KVListModel::deleteFirst() {
     KVListEntry *e = takeFirst();
-    if(e) delete e;
+    if(e) destroyEntry(e);
 }
 
 void KVListModel::deleteLast() {
     KVListEntry *e = takeLast();
-    if(e) delete e;
+    if(e) destroyEntry(e);
 }
 
 void KVListModel::deleteAll()
@@ -103,7 +336,11 @@ void KVListModel::deleteAll()
     beginResetModel();
     for(KVListEntry *e : entries_)
         disconnectEntry(e);
-    qDeleteAll(entries_);
+    if(entryPool_) {
+        for(KVListEntry *e : entries_)
+            entryPool_->recycle(e);
+    } else
+        qDeleteAll(entries_);
     entries_.clear();
     endResetModel();
 }
@@ -123,6 +360,9 @@ QHash<int, QByteArray> KVListModel::roleNames() const {
 
 QVariant KVListModel::data(const QModelIndex &index, int role) const
 {    
+    if(recorder_)
+        recorder_->recordRead(index.row(), &role, 1);
+
     QVariant result;
     if(role == MODEL) // readonly!
         result = QVariant::fromValue((KVListModel*)this);
@@ -140,6 +380,84 @@ QVariant KVListModel::data(const QModelIndex &index, int role) const
     return result;
 }
 
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+void KVListModel::multiData(const QModelIndex &index, QModelRoleDataSpan roleDataSpan) const
+{
+    const int count = int(roleDataSpan.size());
+    QVarLengthArray<int, 32> roles(count);
+    QVarLengthArray<QVariant, 32> values(count);
+    for(int i=0; i<count; i++)
+        roles[i] = roleDataSpan[i].role();
+
+    fillRoles(index.row(), roles.data(), values.data(), count);
+
+    for(int i=0; i<count; i++)
+        roleDataSpan[i].setData(values[i]);
+}
+#endif
+
+void KVListModel::multiData(const QModelIndex &index, const QVector<int> &roles, QVector<QVariant> &values) const
+{
+    values.resize(roles.size());
+    fillRoles(index.row(), roles.constData(), values.data(), roles.size());
+}
+
+QVariantMap KVListModel::rowValues(int row, const QStringList &roleNames) const
+{
+    QVector<int> roles;
+    QVector<QByteArray> names;
+    for(auto i = roleNames_.constBegin(); i != roleNames_.constEnd(); ++i) {
+        if(roleNames.isEmpty() ? i.key() < KVListEntry::InternalKeysStartAt : roleNames.contains(QString::fromLatin1(i.value()))) {
+            roles << i.key();
+            names << i.value();
+        }
+    }
+
+    QVector<QVariant> values(roles.size());
+    fillRoles(row, roles.constData(), values.data(), roles.size());
+
+    QVariantMap result;
+    for(int i=0; i<roles.size(); i++)
+        result.insert(QString::fromLatin1(names[i]), values[i]);
+    return result;
+}
+
+void KVListModel::fillRoles(int row, const int *roles, QVariant *values, int count) const
+{
+    if(recorder_)
+        recorder_->recordRead(row, roles, count);
+
+    KVListEntry *e = entries_.value(row, nullptr);
+
+    // the entry handles its keys in one go, the internal roles are done here
+    QVarLengthArray<int, 32> keys, positions;
+    for(int i=0; i<count; i++) {
+        if(roles[i] == MODEL)
+            values[i] = QVariant::fromValue((KVListModel*)this);
+        else if(roles[i] == ENTRY)
+            values[i] = QVariant::fromValue(e);
+        else if(!e)
+            values[i] = QVariant();
+        else {
+            keys.append(roles[i]);
+            positions.append(i);
+        }
+    }
+
+    if(keys.isEmpty())
+        return;
+
+    QVarLengthArray<QVariant, 32> keyValues(keys.size());
+    e->getValues(keys.constData(), keyValues.data(), keys.size());
+    for(int i=0; i<keys.size(); i++)
+        values[positions[i]] = keyValues[i];
+
+#if (DEBUG_DATA_ACCESS != 0)
+    for(int i=0; i<count; i++)
+        qDebug().nospace() << "KVListModel::fillRoles(" << row << ", " << roleNames_.value(roles[i]) << ") -> " << values[i];
+#endif
+}
+
 bool KVListModel::setData(const QModelIndex &index, const QVariant &value, int role)
 {
 #if (DEBUG_DATA_ACCESS != 0)
@@ -151,7 +469,11 @@ bool KVListModel::setData(const QModelIndex &index, const QVariant &value, int r
 
     KVListEntry *e = entries_.value(index.row(), nullptr);
     if(e) {
+        if(recorder_)
+            recorder_->beginOp(KVListTrace::SetData, index.row(), role, value);
         e->setValue(role, value);
+        if(recorder_)
+            recorder_->endOp();
         return true;
     }
     return false;
@@ -168,17 +490,17 @@ QHash<int, QByteArray> KVListModel::createHashFromEnum(const QMetaEnum &keysEnum
     return hash;
 }
 
-KVListModel::CbHandle *KVListModel::onEntriesChanged(const QVector<int> &roles, KVListModel::EntryChangedCallbackFunc func)
+KVListModel::CbHandle *KVListModel::onEntriesChanged(const QVector<int> &roles, KVListModel::EntryChangedCallbackFunc func, bool deferred)
 {
-    CbHandle *obj = new CbHandle(func);
+    CbHandle *obj = new CbHandle(func, deferred);
     for(int role : roles)
         entryChangedCallbacks_[role] << obj;
     return obj;
 }
 
-KVListModel::CbHandle *KVListModel::onEntriesChanged(int role, KVListModel::EntryChangedCallbackFunc func)
+KVListModel::CbHandle *KVListModel::onEntriesChanged(int role, KVListModel::EntryChangedCallbackFunc func, bool deferred)
 {
-    CbHandle *obj = new CbHandle(func);
+    CbHandle *obj = new CbHandle(func, deferred);
     entryChangedCallbacks_[role] << obj;
     return obj;
 }
@@ -191,6 +513,55 @@ void KVListModel::removeEntriesRoleChanged(KVListModel::CbHandle *obj)
     delete obj;
 }
 
+void KVListModel::addObserver(KVListModelObserver *observer)
+{
+    if(observer && !observers_.contains(observer))
+        observers_ << observer;
+}
+
+void KVListModel::removeObserver(KVListModelObserver *observer)
+{
+    observers_.removeAll(observer);
+}
+
+void KVListModel::beginUpdateBatch()
+{
+    updateBatchDepth_++;
+}
+
+void KVListModel::endUpdateBatch()
+{
+    Q_ASSERT(updateBatchDepth_ > 0);
+    if(--updateBatchDepth_ == 0)
+        flushPendingChanges();
+}
+
+void KVListModel::setNotifyInterval(int msecs, const QVector<int> &roles)
+{
+    notifyInterval_ = qMax(0, msecs);
+    throttledRoles_.clear();
+    for(int role : roles)
+        throttledRoles_ << role;
+
+    // don't keep anything back when throttling is turned off
+    if(notifyInterval_ == 0 && updateBatchDepth_ == 0)
+        flushPendingChanges();
+}
+
+void KVListModel::scheduleFlush()
+{
+    if(flushScheduled_)
+        return;
+    flushScheduled_ = true;
+
+    QTimer::singleShot(notifyInterval_, this, [this](){
+        flushScheduled_ = false;
+        // a running update batch flushes when it ends
+        if(updateBatchDepth_ == 0)
+            flushPendingChanges();
+    });
+}
+
 QVector<KVListEntry*>::iterator KVListModel::begin()
 {
     return entries_.begin();
@@ -211,6 +582,11 @@ QVector<KVListEntry*>::const_iterator KVListModel::end() const
     return entries_.end();
 }
 
+QVariantMap KVListModel::memoryUsage() const
+{
+    return KVListMemoryUsage::measure(this).toVariantMap();
+}
+
 QStringList KVListModel::keyNamesList() const
 {
     QStringList l;
@@ -226,32 +602,183 @@ bool KVListModel::serialize(const QString &to) {
 
     if(to.isEmpty()) return false;
 
+    // would write a partial model: written once loading is done (the early rows can be edited meanwhile)
+    if(isLoading()) {
+        pendingSave_ = to;
+        return true;
+    }
+
+    // the file already has this content
+    if(to == savedFile_ && generation_ == savedGeneration_ && QFile::exists(to))
+        return true;
+
+    bool res;
     if(to.endsWith(".xml", Qt::CaseInsensitive))
     {
         KVListSerializerXml s;
-        return s.serialize(this, to);
+        res = s.serialize(this, to);
+    }
+    else if(to.endsWith(".xml.kvlc", Qt::CaseInsensitive))
+    {
+        KVListSerializerXml s;
+        res = s.serializeToContainer(this, to);
     }
     else
     {
         qCritical() << "invalid file type!";
         return false;
     }
+
+    if(res)
+        markSaved(to);
+    return res;
 }
 
 bool KVListModel::deSerialize(const QString &from)
 {
     if(from.isEmpty()) return false;
 
+    const int first = entries_.size();
+    bool res;
+
     if(from.endsWith(".xml", Qt::CaseInsensitive))
     {
         KVListSerializerXml s;
-        return s.deserializeToExistingModel(this, from);
+        res = s.deserializeToExistingModel(this, from);
+    }
+    else if(from.endsWith(".xml.kvlc", Qt::CaseInsensitive))
+    {
+        KVListSerializerXml s;
+        res = s.deserializeContainerToExistingModel(this, from);
     }
     else
     {
         qCritical() << "invalid file type!";
         return false;
     }
+
+    if(res && entries_.size() > first)
+        entriesDeSerialized(first, entries_.size() - 1);
+    // appended to existing entries the model differs from the file
+    if(res && first == 0)
+        markSaved(from);
+    return res;
+}
+
+bool KVListModel::deSerializeAsync(const QString &from)
+{
+    if(from.isEmpty()) return false;
+
+    if(isLoading()) {
+        qWarning(kvlist) << "already loading" << from;
+        return false;
+    }
+
+    const bool isContainer = from.endsWith(".xml.kvlc", Qt::CaseInsensitive);
+    if(!isContainer && !from.endsWith(".xml", Qt::CaseInsensitive)) {
+        qCritical() << "invalid file type!";
+        return false;
+    }
+
+    QSharedPointer<AsyncLoad> load = QSharedPointer<AsyncLoad>::create();
+    load->model = this;
+    if(entries_.isEmpty())
+        load->file = from;
+    load->generation = generation_;
+    asyncLoad_ = load;
+    progress_ = 0;
+    emit loadingChanged();
+    emit progressChanged();
+
+    QThreadPool::globalInstance()->start(new LoadJob([load, from, isContainer](){
+        {
+            // the serializer lives in the worker only
+            KVListSerializerXml s;
+            QByteArray data;
+            load->ok = s.readData(from, isContainer, data) && s.parse(data, load->root);
+        }
+
+        QMutexLocker locker(&load->mutex);
+        KVListModel *model = load->model;
+        if(model) {
+            QMetaObject::invokeMethod(model, [model, load](){
+                if(model->asyncLoad_ == load)
+                    model->attachNextBatch();
+            }, Qt::QueuedConnection);
+        }
+    }));
+
+    return true;
+}
+
+void KVListModel::attachNextBatch()
+{
+    QSharedPointer<AsyncLoad> load = asyncLoad_;
+    KVListSerializerXml s;
+
+    if(load->next == 0 && (!load->ok || !s.canAttach(load->root, this))) {
+        finishAsyncLoad(false);
+        return;
+    }
+
+    const int total = load->root.entries.size();
+    QVector<KVListEntry*> batch;
+
+    if(load->next == 0) {
+        // get something on the screen as soon as possible
+        batch = s.createEntries(load->root, this, 0, LOAD_FIRST_BATCH);
+        load->next = qMin(LOAD_FIRST_BATCH, total);
+    }
+    else {
+        QElapsedTimer timer;
+        timer.start();
+        while(load->next < total && timer.elapsed() < LOAD_SLICE_MSECS) {
+            batch += s.createEntries(load->root, this, load->next, LOAD_GRAIN_SIZE);
+            load->next = qMin(load->next + LOAD_GRAIN_SIZE, total);
+        }
+    }
+
+    // the early rows can be edited while loading: the model does not equal the file anymore
+    if(generation_ != load->generation)
+        load->file.clear();
+
+    const int first = entries_.size();
+    appendEntries(batch);
+    if(entries_.size() > first)
+        entriesDeSerialized(first, entries_.size() - 1);
+    load->generation = generation_;
+
+    progress_ = total > 0 ? qreal(load->next) / total : 1;
+    emit progressChanged();
+
+    if(load->next < total) {
+        QTimer::singleShot(0, this, [this, load](){
+            if(asyncLoad_ == load)
+                attachNextBatch();
+        });
+    }
+    else
+        finishAsyncLoad(true);
+}
+
+void KVListModel::finishAsyncLoad(bool ok)
+{
+    if(ok && !asyncLoad_->file.isEmpty() && generation_ == asyncLoad_->generation)
+        markSaved(asyncLoad_->file);
+    asyncLoad_.reset();
+
+    QString save;
+    save.swap(pendingSave_);
+    if(!save.isEmpty()) {
+        // the file could not be read: only write in case there is nothing to overwrite
+        if(ok || !QFile::exists(save))
+            serialize(save);
+        else
+            qWarning(kvlist) << "loading failed, not overwriting" << save;
+    }
+
+    emit loadingChanged();
+    emit loaded(ok);
 }
 
 KVListEntry::Key KVListModel::lookupKey(const QString &keyName, const QVersionNumber &version) {
@@ -280,6 +807,45 @@ void KVListModel::revertAllShadowedChanges()
 
 void KVListModel::entryHasChanged(const KVListEntry *entry, const QVector<int> &modifiedRoles)
 {
+    // roles to notify right away / to collect for flushPendingChanges()
+    const bool batched = updateBatchDepth_ > 0;
+    QVector<int> now, later;
+    if(batched) {
+        later = modifiedRoles;
+    } else if(notifyInterval_ > 0) {
+        for(int role : modifiedRoles) {
+            if(throttledRoles_.isEmpty() || throttledRoles_.contains(role))
+                later << role;
+            else
+                now << role;
+        }
+    } else {
+        now = modifiedRoles;
+    }
+
+    // filter duplicates; deferred callbacks of collected roles are called on flush
+    QSet<CbHandle*> callbacks;
+    for(int role : modifiedRoles) {
+        for(CbHandle *obj : entryChangedCallbacks_[role]) {
+            if(!obj->deferred || now.contains(role))
+                callbacks << obj;
+        }
+    }
+
+    for(CbHandle *obj : callbacks)
+        obj->func(entry);
+
+    // collect the changes... flushPendingChanges() will emit them
+    if(!later.isEmpty()) {
+        QSet<int> &roles = pendingChanges_[entry];
+        for(int role : later)
+            roles << role;
+        if(!batched)
+            scheduleFlush();
+    }
+    if(now.isEmpty())
+        return;
+
     // obtaining the index can be improved, if the index is being stored within the entry
     // whenever the model changes, of course the index must be updated
     // for now we obtain the index each time something changes... This allows us to minimize
@@ -289,18 +855,76 @@ void KVListModel::entryHasChanged(const KVListEntry *entry, const QVector<int> &
     int index = entries_.indexOf((KVListEntry*)entry);
     Q_ASSERT(index >= 0);
 
-    // filter duplicates
-    QSet<CbHandle*> callbacks;
-    for(int role : modifiedRoles) {
-        for(CbHandle *obj : entryChangedCallbacks_[role])
-            callbacks << obj;
+    QModelIndex ix = QAbstractListModel::index(index);
+    dataChanged(ix, ix, now);
+}
+
+void KVListModel::flushPendingChanges()
+{
+    if(pendingChanges_.isEmpty())
+        return;
+
+    QHash<const KVListEntry*, QSet<int>> pending;
+    pending.swap(pendingChanges_);
+
+    // row -> modified roles; entries that have been removed meanwhile are simply not found
+    QMap<int, const QSet<int>*> rows;
+    if(pending.size() * 8 < entries_.size()) {
+        for(auto i = pending.constBegin(); i != pending.constEnd(); ++i) {
+            int row = entries_.indexOf((KVListEntry*)i.key());
+            if(row >= 0)
+                rows.insert(row, &i.value());
+        }
+    } else {
+        for(int row=0; row<entries_.size(); row++) {
+            auto i = pending.constFind(entries_[row]);
+            if(i != pending.constEnd())
+                rows.insert(row, &i.value());
+        }
     }
 
-    for(CbHandle *obj : callbacks)
-        obj->func(entry);
+    // one dataChanged() per contiguous range of rows
+    auto i = rows.constBegin();
+    while(i != rows.constEnd()) {
+        int first = i.key(), last = first;
+        QSet<int> roles = *i.value();
+        for(++i; i != rows.constEnd() && i.key() == last+1; ++i) {
+            roles.unite(*i.value());
+            last++;
+        }
+
+        QVector<int> modifiedRoles;
+        modifiedRoles.reserve(roles.size());
+        for(int role : roles)
+            modifiedRoles << role;
+        dataChanged(QAbstractListModel::index(first), QAbstractListModel::index(last), modifiedRoles);
+    }
 
-    QModelIndex ix = QAbstractListModel::index(index);
-    dataChanged(ix, ix, modifiedRoles);
+    // deferred callbacks, once per entry; collected first as they may modify the model
+    QVector<QPair<QPointer<KVListEntry>, QSet<CbHandle*>>> deferred;
+    for(auto r = rows.constBegin(); r != rows.constEnd(); ++r) {
+        QSet<CbHandle*> callbacks;
+        for(int role : *r.value()) {
+            for(CbHandle *obj : entryChangedCallbacks_.value(role)) {
+                if(obj->deferred)
+                    callbacks << obj;
+            }
+        }
+        if(!callbacks.isEmpty())
+            deferred << qMakePair(QPointer<KVListEntry>(entries_[r.key()]), callbacks);
+    }
+    for(const auto &d : deferred) {
+        if(d.first) {
+            for(CbHandle *obj : d.second)
+                obj->func(d.first);
+        }
+    }
+}
+
+void KVListModel::notifyValueChanged(KVListEntry *entry, KVListEntry::Key key, const QVariant &oldValue, const QVariant &newValue)
+{
+    for(KVListModelObserver *o : observers_)
+        o->valueChanged(this, entry, key, oldValue, newValue);
 }
 
 QHash<int, QByteArray> KVListModel::setupModelRoleNames(const QMetaEnum &keysEnum) const
@@ -341,6 +965,10 @@ void KVListModel::insertInt(int i, KVListEntry *entry)
     entries_.insert(i, entry);
     connectEntry(entry);
     endInsertRows();
+    touch(i);
+
+    for(KVListModelObserver *o : observers_)
+        o->entryInserted(this, i, entry);
 }
 
 void KVListModel::moveInt(int from, int to)
@@ -353,6 +981,10 @@ void KVListModel::moveInt(int from, int to)
     if(beginMoveRows(QModelIndex(), from, from, QModelIndex(), to2)) {
         entries_.move(from, to);
         endMoveRows();
+        touch(qMin(from, to));
+
+        for(KVListModelObserver *o : observers_)
+            o->entryMoved(this, from, to);
     } else {
         qWarning() << "move condition not satisfied; from/to:" << from << to2;
     }
@@ -361,13 +993,218 @@ void KVListModel::moveInt(int from, int to)
 KVListEntry *KVListModel::takeAtInt(int i)
 {
     KVListEntry *e;
+    for(KVListModelObserver *o : observers_)
+        o->entryAboutToBeRemoved(this, i, entries_.at(i));
+
     beginRemoveRows(QModelIndex(), i, i);
     e=entries_.takeAt(i);
     disconnectEntry(e);
+    pendingChanges_.remove(e);
     endRemoveRows();
+    touch(i);
     return e;
 }
 
+void KVListModel::touch(int row, bool modified)
+{
+    if(modified)
+        generation_++;
+    dropRowHashes(row);
+    if(ownerEntry_)
+        ownerEntry_->touch(modified);
+}
+
+void KVListModel::touchEntry(const KVListEntry *entry, bool modified)
+{
+    if(modified)
+        generation_++;
+
+    // nothing to update as long as nobody asked for the hash
+    if(!rowHashes_.isEmpty()) {
+        const int row = rowOf(entry);
+        if(dirtyRows_.size() >= rowHashes_.size())
+            dropRowHashes(0);
+        else if(row >= 0 && row < rowHashes_.size())
+            dirtyRows_ << row;
+    }
+
+    if(ownerEntry_)
+        ownerEntry_->touch(modified);
+}
+
+void KVListModel::dropRowHashes(int row) const
+{
+    row = qMax(row, 0);
+    if(row >= rowHashes_.size())
+        return;
+
+    for(int i = row; i < rowHashes_.size(); i++)
+        contentHash_ -= rowHash(rowHashes_[i], i);
+    rowHashes_.resize(row);
+    dirtyRows_.erase(std::remove_if(dirtyRows_.begin(), dirtyRows_.end(), [row](int r) { return r >= row; }),
+                     dirtyRows_.end());
+}
+
+int KVListModel::rowOf(const KVListEntry *entry) const
+{
+    // rows only change on inserts / removals / moves before the entry: check the hint first
+    int row = entry->modelRow_;
+    if(row < 0 || row >= entries_.size() || entries_[row] != entry) {
+        row = entries_.indexOf(const_cast<KVListEntry*>(entry));
+        entry->modelRow_ = row;
+    }
+    return row;
+}
+
+void KVListModel::markSaved(const QString &file)
+{
+    savedFile_ = file;
+    savedGeneration_ = generation_;
+}
+
+bool KVListModel::isModified() const
+{
+    return savedFile_.isEmpty() || generation_ != savedGeneration_;
+}
+
+QSet<QString> KVListModel::usedBlobs() const
+{
+    QSet<QString> used;
+    const int blobType = qMetaTypeId<KVListBlob>();
+    for(const KVListEntry *entry : qAsConst(entries_)) {
+        for(const QMap<KVListEntry::Key, QVariant> *store : { &entry->keyValueStore_, &entry->keyValueStoreShadowed_ }) {
+            for(const QVariant &value : *store) {
+                if(value.userType() == blobType) {
+                    const KVListBlob blob = value.value<KVListBlob>();
+                    if(!blob.isNull())
+                        used.insert(blob.hash());
+                }
+                else if(QMetaType::typeFlags(value.userType()) & QMetaType::PointerToQObject) {
+                    if(const KVListModel *child = value.value<KVListModel*>())
+                        used.unite(child->usedBlobs());
+                }
+            }
+        }
+    }
+    return used;
+}
+
+quint64 KVListModel::contentHash() const
+{
+    // entries changed since the last call: replace their share
+    for(int row : dirtyRows_) {
+        const quint64 h = entries_[row]->contentHash();
+        contentHash_ += rowHash(h, row) - rowHash(rowHashes_[row], row);
+        rowHashes_[row] = h;
+    }
+    dirtyRows_.clear();
+
+    // rows behind the first insert / removal / move since the last call
+    rowHashes_.reserve(entries_.size());
+    for(int row = rowHashes_.size(); row < entries_.size(); row++) {
+        const quint64 h = entries_[row]->contentHash();
+        entries_[row]->modelRow_ = row;
+        rowHashes_ << h;
+        contentHash_ += rowHash(h, row);
+    }
+    return contentHash_;
+}
+
+QVector<KVListModel::Difference> KVListModel::diff(const KVListModel *a, const KVListModel *b)
+{
+    QVector<Difference> result;
+    QVector<QPair<int, KVListEntry::Key>> path;
+    diffInt(a, b, path, result);
+    return result;
+}
+
+void KVListModel::diffInt(const KVListModel *a, const KVListModel *b, QVector<QPair<int, KVListEntry::Key>> &path,
+                          QVector<Difference> &result)
+{
+    const int na = a ? a->entries_.size() : 0;
+    const int nb = b ? b->entries_.size() : 0;
+    if(na == nb && (na == 0 || a->contentHash() == b->contentHash()))
+        return;
+
+    auto hashAt = [](const KVListModel *m, int row) { return m->entries_[row]->contentHash(); };
+    auto childModelOf = [](const QVariant &v) -> KVListModel* {
+        return QMetaType::typeFlags(v.userType()) & QMetaType::PointerToQObject ? v.value<KVListModel*>() : nullptr;
+    };
+
+    // rows equal at the start and at the end
+    int prefix = 0;
+    while(prefix < na && prefix < nb && hashAt(a, prefix) == hashAt(b, prefix))
+        prefix++;
+    int suffix = 0;
+    while(suffix < na - prefix && suffix < nb - prefix && hashAt(a, na - 1 - suffix) == hashAt(b, nb - 1 - suffix))
+        suffix++;
+
+    const int countA = na - prefix - suffix;
+    const int countB = nb - prefix - suffix;
+    if(countA != countB) {
+        result << Difference{ path, prefix, countA, countB };
+        return;
+    }
+
+    for(int row = prefix; row < prefix + countA; row++) {
+        const KVListEntry *ea = a->entries_[row];
+        const KVListEntry *eb = b->entries_[row];
+        if(ea->contentHash() == eb->contentHash())
+            continue;
+
+        // values other than child models: the row differs, otherwise descend into the differing child models
+        bool same = ea->metaObject() == eb->metaObject();
+        QVector<KVListEntry::Key> childKeys;
+        QList<KVListEntry::Key> keys = ea->keyValueStore_.keys() + eb->keyValueStore_.keys();
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        for(int i=0; i<keys.size() && same; i++) {
+            const KVListEntry::Key key = keys.at(i);
+            if(ea->isTransientKey(key))
+                continue;
+
+            const QVariant va = ea->keyValueStore_.value(key);
+            const QVariant vb = eb->keyValueStore_.value(key);
+            KVListModel *ma = childModelOf(va), *mb = childModelOf(vb);
+            if(ma || mb) {
+                if(!ma || !mb || ma->contentHash() != mb->contentHash())
+                    childKeys << key;
+                continue;
+            }
+            // other objects are no content
+            if(QMetaType::typeFlags(va.userType()) & QMetaType::PointerToQObject || va.userType() == QMetaType::VoidStar)
+                continue;
+            same = va == vb;
+        }
+
+        if(!same || childKeys.isEmpty()) {
+            result << Difference{ path, row, 1, 1 };
+            continue;
+        }
+        for(KVListEntry::Key key : childKeys) {
+            path << qMakePair(row, key);
+            diffInt(childModelOf(ea->keyValueStore_.value(key)), childModelOf(eb->keyValueStore_.value(key)), path, result);
+            path.removeLast();
+        }
+    }
+}
+
+QVector<int> KVListModel::differingRows(const KVListModel *a, const KVListModel *b)
+{
+    QVector<int> rows;
+    for(const Difference &d : diff(a, b)) {
+        if(!d.path.isEmpty())
+            rows << d.path.first().first;
+        else {
+            for(int row = d.row; row < d.row + qMax(d.countA, d.countB); row++)
+                rows << row;
+        }
+    }
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    return rows;
+}
+
 void KVListModel::disconnectEntry(KVListEntry *entry)
 {
     entry->model_ = nullptr;
@@ -377,3 +1214,11 @@ void KVListModel::connectEntry(KVListEntry *entry) {
     entry->model_ = this;
 }
 
+void KVListModel::destroyEntry(KVListEntry *entry)
+{
+    if(entryPool_)
+        entryPool_->recycle(entry);
+    else
+        delete entry;
+}
+
@@ -7,11 +7,17 @@
 #include <QMetaEnum>
 #include <QPair>
 #include <QVersionNumber>
+#include <QSharedPointer>
+#include <QPointer>
 
 #include "kvlist_global.h"
 #include "kvlistentry.h"
 #include "kvlistserializer.h"
 
+class KVListModelObserver;
+class KVListTraceRecorder;
+class KVListEntryPool;
+
 /**
  * @brief The KVListModel class
  *
@@ -113,12 +119,15 @@
 class KVLIST_EXPORT KVListModel : public QAbstractListModel, public KVListBase
 {
     Q_OBJECT
+    Q_PROPERTY(bool loading READ isLoading NOTIFY loadingChanged)
+    Q_PROPERTY(qreal progress READ progress NOTIFY progressChanged)
 
 public:
     typedef std::function<void (const KVListEntry *entry)> EntryChangedCallbackFunc;
     struct CbHandle{
-        CbHandle(EntryChangedCallbackFunc f) : func(f){}
+        CbHandle(EntryChangedCallbackFunc f, bool d = false) : func(f), deferred(d){}
         EntryChangedCallbackFunc func;
+        bool deferred;
     };
 
 
@@ -138,6 +147,8 @@ public:
     Q_INVOKABLE virtual void insert(int i, KVListEntry *entry);
     Q_INVOKABLE virtual void append(KVListEntry *entry);
     Q_INVOKABLE virtual void prepend(KVListEntry *entry);
+    // append several entries with a single rowsInserted()
+    void appendEntries(const QVector<KVListEntry*> &entries);
 
     // remove value (items are not deleted)
     Q_INVOKABLE virtual KVListEntry *takeAt(int i);
@@ -153,9 +164,33 @@ public:
     // delete all items
     Q_INVOKABLE virtual void deleteAll();
 
+    // with a pool, deleted entries are handed over to it for reuse (see KVListEntryPool); not owned
+    void setEntryPool(KVListEntryPool *pool) { entryPool_ = pool; }
+    KVListEntryPool *entryPool() const { return entryPool_; }
+
     // move value from one position to another
     Q_INVOKABLE virtual void move(int from, int to);
 
+    // reorder all entries at once: a single layoutAboutToBeChanged()/layoutChanged() is emitted and
+    // persistent indexes are remapped. 'order' lists the current rows in their new order,
+    // i.e. the entry at row 'order[i]' moves to row i. Returns false in case 'order' is no permutation
+    bool applyPermutation(const QVector<int> &order);
+
+    // sort the entries (stable) by a comparator or by the values of one or more keys
+    struct SortKey {
+        KVListEntry::Key key;
+        Qt::SortOrder order;
+    };
+    typedef std::function<bool (const KVListEntry *a, const KVListEntry *b)> LessThanFunc;
+    using QAbstractListModel::sort;
+    void sort(const LessThanFunc &lessThan);
+    void sort(const QVector<SortKey> &keys);
+    void sortByKey(KVListEntry::Key key, Qt::SortOrder order = Qt::AscendingOrder) { sort(QVector<SortKey>() << SortKey{key, order}); }
+
+    // <0, 0, >0... numbers, dates and times are compared by value, anything else as (locale aware) string;
+    // invalid/null values come first
+    static int compareValues(const QVariant &a, const QVariant &b);
+
     // get the index of element... or -1 in case it does not exist
     Q_INVOKABLE int indexOf(KVListEntry *entry) const { return entries_.indexOf(entry); }
     Q_INVOKABLE int size() const { return entries_.size(); }
@@ -165,11 +200,32 @@ public:
 
     // add your callback/lambda here... will be notified when any entries role changes
     // returns a handle that can be used to remove the entry again
-    CbHandle* onEntriesChanged(const QVector<int> &roles, EntryChangedCallbackFunc func);
-    CbHandle* onEntriesChanged(int role, EntryChangedCallbackFunc func);
+    // 'deferred' callbacks are called along with the collected dataChanged() of an update batch or
+    // of throttled roles (once per entry), the others right away
+    CbHandle* onEntriesChanged(const QVector<int> &roles, EntryChangedCallbackFunc func, bool deferred = false);
+    CbHandle* onEntriesChanged(int role, EntryChangedCallbackFunc func, bool deferred = false);
     // remove a callback
     void removeEntriesRoleChanged(CbHandle *obj);
 
+    // observers get notified about every mutation including the previous values (see KVListModelObserver)
+    // the model does not take ownership
+    void addObserver(KVListModelObserver *observer);
+    void removeObserver(KVListModelObserver *observer);
+
+    // coalesce notifications: between beginUpdateBatch() and endUpdateBatch() dataChanged() is collected
+    // and emitted once for each contiguous range of modified rows; callbacks registered via
+    // onEntriesChanged() are still called right away (unless deferred). Calls can be nested.
+    void beginUpdateBatch();
+    void endUpdateBatch();
+
+    // throttle notifications for values changing many times per second: dataChanged() of 'roles'
+    // (all roles if empty) is collected like in an update batch and emitted at most once per 'msecs'.
+    // 0 turns throttling off. flushNotifications() emits the collected changes right away, e.g. when
+    // connected to QQuickWindow::beforeRendering for delivery once per frame
+    void setNotifyInterval(int msecs, const QVector<int> &roles = QVector<int>());
+    int notifyInterval() const { return notifyInterval_; }
+    Q_INVOKABLE void flushNotifications() { flushPendingChanges(); }
+
     // provide begin() end() to allow iterating via range-based-loops
     QVector<KVListEntry*>::iterator begin();
     QVector<KVListEntry*>::iterator end();
@@ -188,10 +244,51 @@ public:
     Q_INVOKABLE virtual bool deSerialize() { return deSerialize(getSerializationFile()); }
 
     // serialize-to / de-serialize-from file given by argument; returns false on error
+    // serialize() skips writing (and returns true) when nothing changed since the file was last written / read
     // depending on the filetype, the serialization type is choosen... (for now only *.xml is supported!)
+    // *.xml.kvlc stores the xml in a chunked, compressed container (see KVListContainer)
     Q_INVOKABLE virtual bool serialize(const QString &to);
     Q_INVOKABLE virtual bool deSerialize(const QString &from);
 
+    // like deSerialize(), but the file is read and parsed on the thread pool; the entries are appended
+    // in time sliced batches (the first screenful right away), so the event loop keeps running.
+    // Returns false in case loading could not be started, otherwise 'loaded()' is emitted once done.
+    // serialize() while loading is done once all entries are there.
+    Q_INVOKABLE virtual bool deSerializeAsync() { return deSerializeAsync(getSerializationFile()); }
+    Q_INVOKABLE virtual bool deSerializeAsync(const QString &from);
+    bool isLoading() const { return !asyncLoad_.isNull(); }
+    // share of the entries appended so far [0..1]
+    qreal progress() const { return progress_; }
+
+    // incremented with every change of the serialized content: entries inserted / removed / moved, values
+    // changed, also in child models (not persisted)
+    quint64 generation() const { return generation_; }
+    // hash of the serialized content (entry hashes in order, child models included); maintained incrementally:
+    // a changed entry replaces its share, inserts / removals / moves recombine the cached hashes behind them
+    quint64 contentHash() const;
+    // content changed since the last serialize() / deSerialize()
+    Q_INVOKABLE bool isModified() const;
+    // hashes of all KVListBlob values, child models included (child models not created yet hold no
+    // values); the union over all models using the store is what KVListBlobStore::collectGarbage() keeps
+    QSet<QString> usedBlobs() const;
+
+    // rows [row, row + countA) of 'a' differ from rows [row, row + countB) of 'b', in the child models
+    // reached via 'path' ((row, key) per level; empty: the compared models themselves)
+    struct Difference {
+        QVector<QPair<int, KVListEntry::Key>> path;
+        int row;
+        int countA;
+        int countB;
+    };
+    // compares two model trees by their hashes: rows equal at the start and the end are skipped (an insert
+    // only reports the new row), entries which only differ in child models are compared recursively and
+    // subtrees with equal hashes are not visited
+    static QVector<Difference> diff(const KVListModel *a, const KVListModel *b);
+    // rows of the top level with differences (see diff())
+    static QVector<int> differingRows(const KVListModel *a, const KVListModel *b);
+    // keys which are not serialized (role names ending with '_ns' / '_noserialize')
+    bool isTransientKey(int key) const { return transientKeys_.contains(key); }
+
 
     // here you can implement special behaviour in case you need to e.g. deserialize data from version 1.0,
     // but your implementation has been bumped to 2.0:
@@ -200,6 +297,12 @@ public:
     // in case the key does not exist, please return -1
     virtual KVListEntry::Key lookupKey(const QString &keyString, const QVersionNumber &version);
 
+    // return true for entries the model re-creates by itself after deserialization (e.g. a fixed list
+    // of choices where only the chosen ones need to be stored): those entries are not serialized.
+    // A child model which only consists of such entries is not serialized at all.
+    // Called from worker threads during serialization, so only read the entry here.
+    virtual bool isDefaultEntry(const KVListEntry * /*entry*/) const { return false; }
+
     // version major & minor
     Q_INVOKABLE int versionMinor() const {return versionMinor_;}
     Q_INVOKABLE int versionMajor() const {return versionMajor_;}
@@ -210,6 +313,9 @@ public:
     // revert the changes stored in the shadowed entries
     Q_INVOKABLE void revertAllShadowedChanges();
 
+    // estimated memory of this model including all child models (see KVListMemoryUsage::toVariantMap())
+    Q_INVOKABLE QVariantMap memoryUsage() const;
+
     // qml can access the roles by the names created here... by default we simply use the enum names
     // please override this function in case you want to change anything
     virtual QHash<int, QByteArray> setupModelRoleNames(const QMetaEnum &keysEnum) const;
@@ -222,14 +328,32 @@ public:
     virtual int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     QHash<int, QByteArray> roleNames() const override;
     virtual QVariant data(const QModelIndex &index, int role) const override;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    // all roles a delegate binds in one go
+    void multiData(const QModelIndex &index, QModelRoleDataSpan roleDataSpan) const override;
+#endif
+    // same for Qt 5: values[i] = data(index, roles[i])
+    void multiData(const QModelIndex &index, const QVector<int> &roles, QVector<QVariant> &values) const;
+    // qml: role name -> value for the given role names (all roles of the entry in case 'roleNames' is empty)
+    Q_INVOKABLE QVariantMap rowValues(int row, const QStringList &roleNames = QStringList()) const;
     virtual bool setData(const QModelIndex &index, const QVariant &value, int role) override;
     virtual Qt::ItemFlags flags(const QModelIndex& index) const override;
 
     // static helper
     static QHash<int, QByteArray> createHashFromEnum(const QMetaEnum &keysEnum);
 
+signals:
+    void loadingChanged();
+    void progressChanged();
+    void loaded(bool ok);
+
 protected:
     friend class KVListEntry;
+    friend class KVListMemoryUsage;
+    friend class KVListTraceRecorder;
+    // called after deSerialize() / deSerializeAsync() added the entries [first .. last]; re-implement this
+    // for post-processing, with deSerializeAsync() it is called once per batch
+    virtual void entriesDeSerialized(int /*first*/, int /*last*/) {}
     // entry informs that keyed values have been changed
     virtual void entryHasChanged(const KVListEntry *entry, const QVector<int> &modifiedRoles);
     void insertInt(int i, KVListEntry *entry);
@@ -237,11 +361,58 @@ protected:
     KVListEntry* takeAtInt(int i);
     void disconnectEntry(KVListEntry *entry);
     void connectEntry(KVListEntry *entry);
+    // delete or recycle a removed entry
+    void destroyEntry(KVListEntry *entry);
+    // emit the dataChanged() collected during an update batch or throttling
+    void flushPendingChanges();
+    void scheduleFlush();
+    void fillRoles(int row, const int *roles, QVariant *values, int count) const;
+    void notifyValueChanged(KVListEntry *entry, KVListEntry::Key key, const QVariant &oldValue, const QVariant &newValue);
+    // rows changed from 'row' on (inserted / removed / moved); passed on to the entry owning this model
+    void touch(int row = 0, bool modified = true);
+    // values of 'entry' changed (see KVListEntry::touch())
+    void touchEntry(const KVListEntry *entry, bool modified);
+    void dropRowHashes(int row) const;
+    int rowOf(const KVListEntry *entry) const;
+    static void diffInt(const KVListModel *a, const KVListModel *b, QVector<QPair<int, KVListEntry::Key>> &path,
+                        QVector<Difference> &result);
+    // the content of 'file' equals the current generation
+    void markSaved(const QString &file);
 
     QVector<KVListEntry*> entries_;
     QHash<int, QByteArray> roleNames_;
     QMap<int, QVector<CbHandle*>> entryChangedCallbacks_;
     QString serializationFile_;
+    QVector<KVListModelObserver*> observers_;
+    int updateBatchDepth_ = 0;
+    QHash<const KVListEntry*, QSet<int>> pendingChanges_;
+    int notifyInterval_ = 0;
+    QSet<int> throttledRoles_;
+    bool flushScheduled_ = false;
+    // set while a KVListTraceRecorder is attached
+    KVListTraceRecorder *recorder_ = nullptr;
+    QPointer<KVListEntryPool> entryPool_;
+    quint64 generation_ = 0;
+    quint64 savedGeneration_ = 0;
+    QString savedFile_;
+    // contentHash(): sum of the row shares of the first rowHashes_.size() rows, the entry hashes these are
+    // based on and the rows among them whose entry changed since
+    mutable quint64 contentHash_ = 0;
+    mutable QVector<quint64> rowHashes_;
+    mutable QVector<int> dirtyRows_;
+    // entry holding this model as value
+    QPointer<KVListEntry> ownerEntry_;
+    QSet<int> transientKeys_;
+
+private:
+    struct AsyncLoad;
+    void attachNextBatch();
+    void finishAsyncLoad(bool ok);
+
+    QSharedPointer<AsyncLoad> asyncLoad_;
+    // serialize() requested while loading
+    QString pendingSave_;
+    qreal progress_ = 0;
 };
 
 #endif // KVLISTMODEL_H
@@ -0,0 +1,51 @@
+#ifndef KVLISTMODELOBSERVER_H
+#define KVLISTMODELOBSERVER_H
+
+#include <QVariant>
+#include <QVector>
+#include "kvlistentry.h"
+#include "kvlist_global.h"
+
+class KVListModel;
+
+/**
+ * @brief The KVListModelObserver class
+ *
+ * Gets notified synchronously about every mutation of a KVListModel and its entries.
+ * Unlike Qt's model signals this includes the previous value of a modified key, which is
+ * needed e.g. for undo/redo.
+ *
+ * Register via KVListModel::addObserver(). Shadowed keys are not reported; applying them
+ * is reported like any other change. Resets (clear(), deleteAll(), resets done by subclasses)
+ * are reported as a whole, not per entry.
+ */
+class KVLIST_EXPORT KVListModelObserver
+{
+public:
+    virtual ~KVListModelObserver() = default;
+
+    // entry has been inserted at 'row'
+    virtual void entryInserted(KVListModel * /*model*/, int /*row*/, KVListEntry * /*entry*/) {}
+
+    // entry at 'row' is going to be removed (it is still part of the model)
+    virtual void entryAboutToBeRemoved(KVListModel * /*model*/, int /*row*/, KVListEntry * /*entry*/) {}
+
+    // entry has been moved (same semantics as KVListModel::move())
+    virtual void entryMoved(KVListModel * /*model*/, int /*from*/, int /*to*/) {}
+
+    // all entries have been reordered (same semantics as KVListModel::applyPermutation())
+    virtual void entriesReordered(KVListModel * /*model*/, const QVector<int> & /*order*/) {}
+
+    // value of 'key' has been changed from 'oldValue' to 'newValue'
+    // (a lazily created value is reported as a change from an invalid QVariant)
+    virtual void valueChanged(KVListModel * /*model*/, KVListEntry * /*entry*/, KVListEntry::Key /*key*/,
+                              const QVariant & /*oldValue*/, const QVariant & /*newValue*/) {}
+
+    // all entries are going to be removed or replaced; the entries are still valid, drop them here
+    virtual void modelAboutToBeReset(KVListModel * /*model*/) {}
+
+    // the model has been reset, the entries of before may be deleted or recycled
+    virtual void modelReset(KVListModel * /*model*/) {}
+};
+
+#endif // KVLISTMODELOBSERVER_H
@@ -0,0 +1,78 @@
+#include "kvlistparallel.h"
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+
+static thread_local bool insideWorker_ = false;
+
+static void runChunk(const std::function<void (int)> &func, int begin, int end)
+{
+    bool wasInside = insideWorker_;
+    insideWorker_ = true;
+    for(int i=begin; i<end; i++)
+        func(i);
+    insideWorker_ = wasInside;
+}
+
+namespace {
+
+class KVListChunkRunnable : public QRunnable
+{
+public:
+    KVListChunkRunnable(const std::function<void (int)> &func, int begin, int end, QSemaphore *done) :
+        func_(func), begin_(begin), end_(end), done_(done) {}
+
+    void run() override {
+        runChunk(func_, begin_, end_);
+        // do not touch any member after releasing: forEach() may return right away
+        done_->release();
+    }
+
+private:
+    const std::function<void (int)> &func_;
+    int begin_, end_;
+    QSemaphore *done_;
+};
+
+}
+
+void KVListParallel::forEach(int count, const std::function<void (int)> &func, int grainSize)
+{
+    if(count <= 0)
+        return;
+    if(grainSize < 1)
+        grainSize = 1;
+
+    QThreadPool *pool = QThreadPool::globalInstance();
+    int chunks = qMin(qMax(pool->maxThreadCount(), 1), (count + grainSize - 1) / grainSize);
+
+    // not worth it / already running on a worker... do it here
+    if(chunks <= 1 || insideWorker_) {
+        runChunk(func, 0, count);
+        return;
+    }
+
+    int chunkSize = (count + chunks - 1) / chunks;
+    QSemaphore done;
+    int started = 0;
+
+    // hand out all but the first chunk; whatever the pool cannot take right now is done here
+    for(int begin = chunkSize; begin < count; begin += chunkSize) {
+        int end = qMin(count, begin + chunkSize);
+        KVListChunkRunnable *r = new KVListChunkRunnable(func, begin, end, &done);
+        if(pool->tryStart(r))
+            started++;
+        else {
+            delete r;
+            runChunk(func, begin, end);
+        }
+    }
+
+    runChunk(func, 0, qMin(count, chunkSize));
+    done.acquire(started);
+}
+
+bool KVListParallel::isWorkerThread()
+{
+    return insideWorker_;
+}
@@ -0,0 +1,34 @@
+#ifndef KVLISTPARALLEL_H
+#define KVLISTPARALLEL_H
+
+#include <functional>
+#include "kvlist_global.h"
+
+/**
+ * @brief The KVListParallel class
+ *
+ * Small helper to spread independent work items (e.g. the entry blocks of a model during
+ * (de)serialization) over QThreadPool::globalInstance().
+ *
+ * The calling thread takes part in the work and forEach() only returns once every item has
+ * been processed. Calls made from within a work item run sequentially, so nesting is safe.
+ *
+ * <code>
+ * QVector<QByteArray> blocks(model->size());
+ * QByteArray *out = blocks.data();
+ * KVListParallel::forEach(blocks.size(), [&](int i){
+ *     out[i] = encode(model->begin()[i]);
+ * });
+ * </code>
+ */
+class KVLIST_EXPORT KVListParallel
+{
+public:
+    // call func(i) for each i in [0 .. count-1]; items are handed out in chunks of at least 'grainSize'
+    static void forEach(int count, const std::function<void (int)> &func, int grainSize = 8);
+
+    // true in case the current thread is executing work on behalf of forEach()
+    static bool isWorkerThread();
+};
+
+#endif // KVLISTPARALLEL_H
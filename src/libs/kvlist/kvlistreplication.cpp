@@ -0,0 +1,652 @@
+#include "kvlistreplication.h"
+#include "kvlistserializer.h"
+#include <QDataStream>
+#include <QTimer>
+#include <QDebug>
+
+using namespace KVListReplication;
+
+// both sides are built against the same Qt... but be explicit
+static const QDataStream::Version StreamVersion = QDataStream::Qt_5_12;
+// waiting for an answer on the server name before a (stale) socket is removed
+static const int ProbeTimeout = 200;
+
+enum ValueKind : quint8 { PlainValue, ModelValue };
+
+static bool isIgnoredKey(const QByteArray &keyName)
+{
+    return keyName.endsWith("_noserialize") || keyName.endsWith("_ns");
+}
+
+static KVListModel *childModel(const QVariant &value)
+{
+    return value.canConvert<KVListModel*>() ? value.value<KVListModel*>() : nullptr;
+}
+
+static bool isReplicated(const QVariant &value)
+{
+    // never send pointers... except child models, which are sent by value
+    return childModel(value) || !(value.canConvert<QObject*>() || value.canConvert<void*>());
+}
+
+static void writeModel(QDataStream &out, const KVListModel *model);
+
+static void writeValue(QDataStream &out, const QVariant &value)
+{
+    if(KVListModel *m = childModel(value)) {
+        out << quint8(ModelValue);
+        writeModel(out, m);
+    } else {
+        out << quint8(PlainValue) << value;
+    }
+}
+
+static void writeEntry(QDataStream &out, const KVListEntry *entry)
+{
+    QHash<int, QByteArray> roleNames = entry->getParentModel() ? entry->getParentModel()->roleNames() : QHash<int, QByteArray>();
+
+    QVector<QPair<KVListEntry::Key, QVariant>> values;
+    for(KVListEntry::Key key : entry->keys()) {
+        QVariant value = entry->getValue(key);
+        if(!isIgnoredKey(roleNames.value(key)) && isReplicated(value))
+            values << qMakePair(key, value);
+    }
+
+    out << QString(entry->metaObject()->className()) << qint32(values.size());
+    for(const auto &v : values) {
+        out << qint32(v.first);
+        writeValue(out, v.second);
+    }
+}
+
+static void writeModel(QDataStream &out, const KVListModel *model)
+{
+    out << QString(model->metaObject()->className()) << qint32(model->size());
+    for(const KVListEntry *e : *model)
+        writeEntry(out, e);
+}
+
+static KVListEntry *readEntry(QDataStream &in);
+
+// read the entries into 'model' (replacing the existing ones); with model == nullptr they are only skipped
+static bool readEntries(QDataStream &in, KVListModel *model)
+{
+    qint32 count;
+    in >> count;
+
+    QVector<KVListEntry*> entries;
+    for(int i=0; i<count && in.status() == QDataStream::Ok; i++) {
+        KVListEntry *e = readEntry(in);
+        if(e && model)
+            entries << e;
+        else
+            delete e;
+    }
+    if(!model || in.status() != QDataStream::Ok) {
+        qDeleteAll(entries);
+        return false;
+    }
+
+    // one insertion for the whole snapshot
+    model->beginUpdateBatch();
+    model->deleteAll();
+    model->appendEntries(entries);
+    model->endUpdateBatch();
+    return true;
+}
+
+// fill an existing model; fails in case the type does not match
+static bool fillModel(QDataStream &in, KVListModel *model)
+{
+    QString type;
+    in >> type;
+    if(type != model->metaObject()->className()) {
+        qWarning(kvlist) << "replication: model type mismatch" << type << model->metaObject()->className();
+        readEntries(in, nullptr);
+        return false;
+    }
+    return readEntries(in, model);
+}
+
+// fill 'destination' or create a new model in case there is none (of the right type)
+static KVListModel *readModel(QDataStream &in, KVListModel *destination)
+{
+    QString type;
+    in >> type;
+
+    KVListModel *m = destination;
+    bool created = false;
+    if(!m || type != m->metaObject()->className()) {
+        KVListBase *b = KVListSerializer::createRegisteredItem(type);
+        m = dynamic_cast<KVListModel*>(b);
+        if(!m)
+            delete b;
+        created = (m != nullptr);
+    }
+
+    if(!readEntries(in, m)) {
+        if(created)
+            delete m;
+        return nullptr;
+    }
+    return m;
+}
+
+static bool readValue(QDataStream &in, KVListEntry *entry, KVListEntry::Key key, QVariant &value)
+{
+    quint8 kind;
+    in >> kind;
+    if(kind == PlainValue) {
+        in >> value;
+        return in.status() == QDataStream::Ok;
+    }
+
+    // child models are filled in place (e.g. a lazily created one)
+    KVListModel *existing = entry ? entry->getChildModel(key) : nullptr;
+    KVListModel *m = readModel(in, existing);
+    if(!m)
+        return false;
+    if(!entry) {
+        if(m != existing)
+            delete m;
+        return false;
+    }
+    if(m != existing)
+        m->setParent(entry);
+    value = QVariant::fromValue(m);
+    return true;
+}
+
+static KVListEntry *readEntry(QDataStream &in)
+{
+    QString type;
+    qint32 count;
+    in >> type >> count;
+
+    KVListBase *b = KVListSerializer::createRegisteredItem(type);
+    KVListEntry *e = dynamic_cast<KVListEntry*>(b);
+    if(!e) {
+        qWarning(kvlist) << "replication: cannot create entry of type" << type;
+        delete b;
+    }
+
+    KVListEntry::KeyValueMap values;
+    for(int i=0; i<count && in.status() == QDataStream::Ok; i++) {
+        qint32 key;
+        QVariant value;
+        in >> key;
+        if(readValue(in, e, key, value))
+            values.insert(key, value);
+    }
+
+    if(e && in.status() != QDataStream::Ok) {
+        delete e;
+        return nullptr;
+    }
+    if(e)
+        e->setValues(values);
+    return e;
+}
+
+static void writeMessage(QIODevice *device, const QByteArray &message)
+{
+    QDataStream out(device);
+    out.setVersion(StreamVersion);
+    out << message;
+}
+
+
+KVListReplicaSource::KVListReplicaSource(KVListModel *model, const QString &serverName) :
+    QObject(model),
+    root_(model)
+{
+    Q_ASSERT(model);
+    watch(model, nullptr, -1);
+
+    connect(&server_, &QLocalServer::newConnection, this, [this](){
+        while(QLocalSocket *c = server_.nextPendingConnection()) {
+            clients_ << c;
+            connect(c, &QLocalSocket::readyRead, this, [this, c](){ readClient(c); });
+            connect(c, &QLocalSocket::disconnected, this, [this, c](){
+                clients_.removeAll(c);
+                c->deleteLater();
+            });
+            sendSnapshot(c);
+        }
+    });
+
+    // a previous instance might have crashed and left the socket behind: only removed if nobody answers
+    QLocalSocket probe;
+    probe.connectToServer(serverName);
+    if(probe.waitForConnected(ProbeTimeout)) {
+        qWarning(kvlist) << "replication: another source is listening on" << serverName;
+        probe.abort();
+        return;
+    }
+    QLocalServer::removeServer(serverName);
+    if(!server_.listen(serverName))
+        qWarning(kvlist) << "replication: cannot listen on" << serverName << server_.errorString();
+}
+
+KVListReplicaSource::~KVListReplicaSource()
+{
+    // destroyed models have been removed already
+    for(auto i = models_.begin(); i != models_.end(); ++i)
+        i.key()->removeObserver(this);
+}
+
+void KVListReplicaSource::entryInserted(KVListModel *model, int row, KVListEntry *entry)
+{
+    watchChildren(entry);
+
+    Path p;
+    if(!path(model, p))
+        return;
+
+    QByteArray rec;
+    QDataStream out(&rec, QIODevice::WriteOnly);
+    out.setVersion(StreamVersion);
+    out << quint8(Insert) << p << qint32(row);
+    writeEntry(out, entry);
+    record(rec);
+}
+
+void KVListReplicaSource::entryAboutToBeRemoved(KVListModel *model, int row, KVListEntry *entry)
+{
+    unwatchChildren(entry);
+
+    Path p;
+    if(!path(model, p))
+        return;
+
+    QByteArray rec;
+    QDataStream out(&rec, QIODevice::WriteOnly);
+    out.setVersion(StreamVersion);
+    out << quint8(Remove) << p << qint32(row);
+    record(rec);
+}
+
+void KVListReplicaSource::modelAboutToBeReset(KVListModel *model)
+{
+    // the child models may go away with the entries
+    for(KVListEntry *e : *model)
+        unwatchChildren(e);
+}
+
+void KVListReplicaSource::modelReset(KVListModel *model)
+{
+    // send the whole model
+    for(KVListEntry *e : *model)
+        watchChildren(e);
+
+    Path p;
+    if(!path(model, p))
+        return;
+
+    QByteArray rec;
+    QDataStream out(&rec, QIODevice::WriteOnly);
+    out.setVersion(StreamVersion);
+    out << quint8(ResetModel) << p;
+    writeModel(out, model);
+    record(rec);
+}
+
+void KVListReplicaSource::entryMoved(KVListModel *model, int from, int to)
+{
+    Path p;
+    if(!path(model, p))
+        return;
+
+    QByteArray rec;
+    QDataStream out(&rec, QIODevice::WriteOnly);
+    out.setVersion(StreamVersion);
+    out << quint8(Move) << p << qint32(from) << qint32(to);
+    record(rec);
+}
+
+void KVListReplicaSource::entriesReordered(KVListModel *model, const QVector<int> &order)
+{
+    Path p;
+    if(!path(model, p))
+        return;
+
+    QByteArray rec;
+    QDataStream out(&rec, QIODevice::WriteOnly);
+    out.setVersion(StreamVersion);
+    out << quint8(Reorder) << p << order;
+    record(rec);
+}
+
+void KVListReplicaSource::valueChanged(KVListModel *model, KVListEntry *entry, KVListEntry::Key key,
+                                       const QVariant &oldValue, const QVariant &newValue)
+{
+    if(isIgnoredKey(model->roleNames().value(key)))
+        return;
+
+    if(KVListModel *m = childModel(oldValue))
+        unwatch(m);
+    if(KVListModel *m = childModel(newValue))
+        watch(m, entry, key);
+
+    if(!isReplicated(newValue))
+        return;
+
+    Path p;
+    int row = model->indexOf(entry);
+    if(row < 0 || !path(model, p))
+        return;
+
+    QByteArray rec;
+    QDataStream out(&rec, QIODevice::WriteOnly);
+    out.setVersion(StreamVersion);
+    out << quint8(SetValue) << p << qint32(row) << qint32(key);
+    writeValue(out, newValue);
+    record(rec);
+}
+
+void KVListReplicaSource::watch(KVListModel *model, KVListEntry *owner, KVListEntry::Key key)
+{
+    auto i = models_.find(model);
+    if(i != models_.end()) {
+        i->entry = owner;
+        i->key = key;
+        return;
+    }
+
+    Owner o;
+    o.entry = owner;
+    o.key = key;
+    models_.insert(model, o);
+    model->addObserver(this);
+    connect(model, &QObject::destroyed, this, [this, model](){
+        models_.remove(model);
+    });
+
+    for(KVListEntry *e : *model)
+        watchChildren(e);
+}
+
+void KVListReplicaSource::watchChildren(KVListEntry *entry)
+{
+    for(KVListEntry::Key key : entry->keys()) {
+        if(KVListModel *m = childModel(entry->getValue(key)))
+            watch(m, entry, key);
+    }
+}
+
+void KVListReplicaSource::unwatch(KVListModel *model)
+{
+    if(!models_.remove(model))
+        return;
+
+    model->removeObserver(this);
+    disconnect(model, nullptr, this, nullptr);
+    for(KVListEntry *e : *model)
+        unwatchChildren(e);
+}
+
+void KVListReplicaSource::unwatchChildren(KVListEntry *entry)
+{
+    for(KVListEntry::Key key : entry->keys()) {
+        if(KVListModel *m = childModel(entry->getValue(key)))
+            unwatch(m);
+    }
+}
+
+bool KVListReplicaSource::path(const KVListModel *model, Path &result) const
+{
+    result.clear();
+    while(model != root_) {
+        auto i = models_.constFind(const_cast<KVListModel*>(model));
+        if(i == models_.constEnd() || !i->entry)
+            return false;
+
+        KVListModel *parent = i->entry->getParentModel();
+        int row = parent ? parent->indexOf(i->entry) : -1;
+        if(row < 0)
+            return false;
+
+        result.prepend(qMakePair(qint32(row), qint32(i->key)));
+        model = parent;
+    }
+    return true;
+}
+
+void KVListReplicaSource::record(const QByteArray &data)
+{
+    sequence_++;
+    if(clients_.isEmpty())
+        return;
+
+    if(pending_.isEmpty())
+        pendingFirst_ = sequence_;
+    pending_ << data;
+
+    // all records of this event loop iteration are sent as one batch
+    if(!flushScheduled_) {
+        flushScheduled_ = true;
+        QTimer::singleShot(0, this, [this](){
+            flushScheduled_ = false;
+            flush();
+        });
+    }
+}
+
+void KVListReplicaSource::flush()
+{
+    if(pending_.isEmpty())
+        return;
+
+    QByteArray msg;
+    QDataStream out(&msg, QIODevice::WriteOnly);
+    out.setVersion(StreamVersion);
+    out << quint8(Batch) << pendingFirst_ << pending_;
+    pending_.clear();
+
+    for(QLocalSocket *c : clients_)
+        writeMessage(c, msg);
+}
+
+void KVListReplicaSource::sendSnapshot(QLocalSocket *client)
+{
+    // records which are still pending are part of the snapshot; the replica skips them by their sequence
+    QByteArray msg;
+    QDataStream out(&msg, QIODevice::WriteOnly);
+    out.setVersion(StreamVersion);
+    out << quint8(Snapshot) << sequence_;
+    if(root_)
+        writeModel(out, root_);
+    writeMessage(client, msg);
+}
+
+void KVListReplicaSource::readClient(QLocalSocket *client)
+{
+    QDataStream in(client);
+    in.setVersion(StreamVersion);
+    for(;;) {
+        in.startTransaction();
+        QByteArray msg;
+        in >> msg;
+        if(!in.commitTransaction())
+            break;
+
+        if(!msg.isEmpty() && quint8(msg.at(0)) == ResyncRequest)
+            sendSnapshot(client);
+    }
+}
+
+
+KVListReplica::KVListReplica(KVListModel *model, const QString &serverName) :
+    QObject(model),
+    model_(model),
+    serverName_(serverName)
+{
+    Q_ASSERT(model);
+    connect(&socket_, &QLocalSocket::readyRead, this, &KVListReplica::read);
+    connect(&socket_, &QLocalSocket::stateChanged, this, [this](QLocalSocket::LocalSocketState state){
+        if(state == QLocalSocket::ConnectedState || state == QLocalSocket::UnconnectedState)
+            emit connectedChanged();
+
+        // source not (yet) there or gone: try again later
+        if(state == QLocalSocket::UnconnectedState) {
+            synced_ = false;
+            QTimer::singleShot(1000, this, &KVListReplica::connectToSource);
+        }
+    });
+    connectToSource();
+}
+
+void KVListReplica::connectToSource()
+{
+    if(socket_.state() == QLocalSocket::UnconnectedState)
+        socket_.connectToServer(serverName_);
+}
+
+void KVListReplica::read()
+{
+    QDataStream in(&socket_);
+    in.setVersion(StreamVersion);
+    for(;;) {
+        in.startTransaction();
+        QByteArray msg;
+        in >> msg;
+        if(!in.commitTransaction())
+            break;
+
+        if(!model_)
+            continue;
+
+        QDataStream m(msg);
+        m.setVersion(StreamVersion);
+        quint8 type;
+        m >> type;
+        if(type == Snapshot)
+            applySnapshot(m);
+        else if(type == Batch)
+            applyBatch(m);
+    }
+}
+
+void KVListReplica::applySnapshot(QDataStream &in)
+{
+    quint64 sequence;
+    in >> sequence;
+    if(!fillModel(in, model_))
+        return;
+
+    sequence_ = sequence;
+    synced_ = true;
+    emit synchronized();
+}
+
+void KVListReplica::applyBatch(QDataStream &in)
+{
+    quint64 first;
+    QVector<QByteArray> records;
+    in >> first >> records;
+
+    // still waiting for the snapshot
+    if(!synced_)
+        return;
+
+    if(first > sequence_ + 1) {
+        qWarning(kvlist) << "replication: missed records" << sequence_ + 1 << "-" << first - 1;
+        requestResync();
+        return;
+    }
+
+    model_->beginUpdateBatch();
+    for(int i=0; i<records.size(); i++) {
+        quint64 sequence = first + quint64(i);
+        if(sequence <= sequence_) // part of the snapshot already
+            continue;
+
+        QDataStream r(records[i]);
+        r.setVersion(StreamVersion);
+        if(!applyRecord(r)) {
+            qWarning(kvlist) << "replication: cannot apply record" << sequence;
+            model_->endUpdateBatch();
+            requestResync();
+            return;
+        }
+        sequence_ = sequence;
+    }
+    model_->endUpdateBatch();
+
+    emit synchronized();
+}
+
+bool KVListReplica::applyRecord(QDataStream &in)
+{
+    quint8 type;
+    Path p;
+    in >> type >> p;
+
+    KVListModel *m = model_;
+    for(const auto &step : p) {
+        if(step.first < 0 || step.first >= m->size())
+            return false;
+        m = m->at(step.first)->getChildModel(step.second);
+        if(!m)
+            return false;
+    }
+
+    qint32 row, other;
+    switch(type) {
+    case Insert: {
+        in >> row;
+        KVListEntry *e = readEntry(in);
+        if(!e)
+            return false;
+        m->insert(row, e);
+        break;
+    }
+    case Remove:
+        in >> row;
+        if(row < 0 || row >= m->size())
+            return false;
+        m->deleteAt(row);
+        break;
+    case Move:
+        in >> row >> other;
+        if(row < 0 || row >= m->size() || other < 0 || other >= m->size())
+            return false;
+        m->move(row, other);
+        break;
+    case Reorder: {
+        QVector<int> order;
+        in >> order;
+        if(!m->applyPermutation(order))
+            return false;
+        break;
+    }
+    case SetValue: {
+        in >> row >> other;
+        if(row < 0 || row >= m->size())
+            return false;
+        KVListEntry *e = m->at(row);
+        QVariant value;
+        if(!readValue(in, e, other, value))
+            return false;
+        e->setValue(other, value);
+        break;
+    }
+    case ResetModel:
+        if(!fillModel(in, m))
+            return false;
+        break;
+    default:
+        return false;
+    }
+
+    return in.status() == QDataStream::Ok;
+}
+
+void KVListReplica::requestResync()
+{
+    synced_ = false;
+
+    QByteArray msg;
+    msg.append(char(ResyncRequest));
+    writeMessage(&socket_, msg);
+}
@@ -0,0 +1,142 @@
+#ifndef KVLISTREPLICATION_H
+#define KVLISTREPLICATION_H
+
+#include <QObject>
+#include <QPointer>
+#include <QHash>
+#include <QVector>
+#include <QPair>
+#include <QByteArray>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include "kvlistentry.h"
+#include "kvlistmodel.h"
+#include "kvlistmodelobserver.h"
+#include "kvlist_global.h"
+
+/**
+ * @brief Replication of a KVListModel (including its child models) to other processes
+ *
+ * KVListReplicaSource publishes a change feed of a model tree via QLocalServer:
+ * every client gets a snapshot first, afterwards only sequence numbered change records
+ * (insert, remove, move, reorder, set value, reset of a (child) model). Records of one
+ * event loop iteration are sent as one batch.
+ *
+ * KVListReplica connects to the source and applies the feed to a local model of the same
+ * type. Each batch is applied within KVListModel::beginUpdateBatch() / endUpdateBatch().
+ * In case of a gap in the sequence (or a record which does not fit the local model) a new
+ * snapshot is requested.
+ *
+ * <code>
+ * // daemon
+ * new KVListReplicaSource(friendsModel, "friends");
+ *
+ * // ui
+ * new KVListReplica(friendsModel, "friends");
+ * </code>
+ *
+ * Notes:
+ * - entry and model types are created via the serialization factory (see REGISTER_2_SERIALIZATION_FACTORY)
+ * - like for serialization, keys ending in '_noserialize' / '_ns' and pointer values (other than
+ *   child models) are not replicated
+ * - child models are addressed by their path (row, key, row, key...), i.e. finding the row of an
+ *   entry is O(rows of its model)
+ * - replication is one-way; changes made to the replica are overwritten by the next snapshot
+ * - a source does not take over the server name of a running one (isListening() is false); a socket
+ *   left behind by a crashed one is removed
+ */
+namespace KVListReplication {
+    enum MessageType : quint8 { Snapshot, Batch, ResyncRequest };
+    enum RecordType : quint8 { Insert, Remove, Move, Reorder, SetValue, ResetModel };
+    typedef QVector<QPair<qint32, qint32>> Path; // (row, key) from the root model down to a child model
+}
+
+class KVLIST_EXPORT KVListReplicaSource : public QObject, public KVListModelObserver
+{
+    Q_OBJECT
+
+public:
+    // the source is owned by the model
+    KVListReplicaSource(KVListModel *model, const QString &serverName);
+    virtual ~KVListReplicaSource();
+
+    bool isListening() const { return server_.isListening(); }
+    QString errorString() const { return server_.errorString(); }
+    int clientCount() const { return clients_.size(); }
+
+    // sequence number of the last record
+    quint64 sequence() const { return sequence_; }
+
+protected:
+    // KVListModelObserver
+    void entryInserted(KVListModel *model, int row, KVListEntry *entry) override;
+    void entryAboutToBeRemoved(KVListModel *model, int row, KVListEntry *entry) override;
+    void entryMoved(KVListModel *model, int from, int to) override;
+    void entriesReordered(KVListModel *model, const QVector<int> &order) override;
+    void modelAboutToBeReset(KVListModel *model) override;
+    void modelReset(KVListModel *model) override;
+    void valueChanged(KVListModel *model, KVListEntry *entry, KVListEntry::Key key,
+                      const QVariant &oldValue, const QVariant &newValue) override;
+
+private:
+    struct Owner {
+        QPointer<KVListEntry> entry;    // entry holding the model (null for the root model)
+        KVListEntry::Key key = -1;
+    };
+
+    void watch(KVListModel *model, KVListEntry *owner, KVListEntry::Key key);
+    void watchChildren(KVListEntry *entry);
+    void unwatch(KVListModel *model);
+    void unwatchChildren(KVListEntry *entry);
+    bool path(const KVListModel *model, KVListReplication::Path &result) const;
+    void record(const QByteArray &data);
+    void flush();
+    void sendSnapshot(QLocalSocket *client);
+    void readClient(QLocalSocket *client);
+
+    QPointer<KVListModel> root_;
+    QHash<KVListModel*, Owner> models_;
+    QLocalServer server_;
+    QVector<QLocalSocket*> clients_;
+
+    quint64 sequence_ = 0;
+    // records not sent yet; the first one has sequence number 'pendingFirst_'
+    quint64 pendingFirst_ = 1;
+    QVector<QByteArray> pending_;
+    bool flushScheduled_ = false;
+};
+
+class KVLIST_EXPORT KVListReplica : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool connected READ isConnected NOTIFY connectedChanged)
+
+public:
+    // the replica is owned by the model; connects right away and reconnects when the connection is lost
+    KVListReplica(KVListModel *model, const QString &serverName);
+
+    bool isConnected() const { return socket_.state() == QLocalSocket::ConnectedState; }
+    // sequence number of the last applied record
+    quint64 sequence() const { return sequence_; }
+
+signals:
+    void connectedChanged();
+    // a snapshot or a batch of changes has been applied
+    void synchronized();
+
+private:
+    void connectToSource();
+    void read();
+    void applySnapshot(QDataStream &in);
+    void applyBatch(QDataStream &in);
+    bool applyRecord(QDataStream &in);
+    void requestResync();
+
+    QPointer<KVListModel> model_;
+    QString serverName_;
+    QLocalSocket socket_;
+    quint64 sequence_ = 0;
+    bool synced_ = false;
+};
+
+#endif // KVLISTREPLICATION_H
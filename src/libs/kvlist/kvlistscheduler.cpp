@@ -0,0 +1,248 @@
+#include "kvlistscheduler.h"
+#include "kvlistmodel.h"
+#include <QCoreApplication>
+#include <QPointer>
+#include <QSet>
+#include <climits>
+
+static KVListScheduler *instance_ = nullptr;
+
+KVListScheduler::KVListScheduler(int tickMs, QObject *parent) :
+    QObject(parent),
+    tickMs_(tickMs)
+{
+    for(int level=0; level<Levels; level++) {
+        occupied_[level] = 0;
+        for(int slot=0; slot<Slots; slot++)
+            slots_[level][slot] = nullptr;
+    }
+
+    clock_.start();
+    timer_.setSingleShot(true);
+    connect(&timer_, &QTimer::timeout, this, &KVListScheduler::onTimeout);
+}
+
+KVListScheduler::~KVListScheduler()
+{
+    if(instance_ == this)
+        instance_ = nullptr;
+
+    for(auto &perEntry : timers_)
+        qDeleteAll(perEntry);
+}
+
+KVListScheduler *KVListScheduler::instance()
+{
+    if(!instance_)
+        instance_ = new KVListScheduler(1000, QCoreApplication::instance());
+    return instance_;
+}
+
+bool KVListScheduler::hasInstance()
+{
+    return instance_ != nullptr;
+}
+
+void KVListScheduler::schedule(KVListEntry *entry, KVListEntry::Key key, qint64 msecs, Callback func)
+{
+    Q_ASSERT(entry);
+    cancel(entry, key);
+
+    // the wheel is empty: nothing to cascade, so we can simply jump to the current time
+    qint64 elapsed = clock_.elapsed();
+    if(count_ == 0 && !running_)
+        currentTick_ = elapsed / tickMs_;
+
+    Timer *t = new Timer;
+    t->entry = entry;
+    t->key = key;
+    t->func = func;
+    // round up: never run early
+    t->due = qMax(currentTick_ + 1, (elapsed + qMax(msecs, qint64(0)) + tickMs_ - 1) / tickMs_);
+
+    timers_[entry].insert(key, t);
+    link(t);
+
+    if(!running_ && (!timer_.isActive() || t->due < wakeTick_))
+        rearm();
+}
+
+void KVListScheduler::cancel(const KVListEntry *entry, KVListEntry::Key key)
+{
+    auto i = timers_.find(entry);
+    if(i == timers_.end())
+        return;
+
+    Timer *t = i->take(key);
+    if(i->isEmpty())
+        timers_.erase(i);
+    if(t)
+        remove(t);
+}
+
+void KVListScheduler::cancelAll(const KVListEntry *entry)
+{
+    QHash<KVListEntry::Key, Timer*> perEntry = timers_.take(entry);
+    for(Timer *t : perEntry)
+        remove(t);
+}
+
+bool KVListScheduler::isScheduled(const KVListEntry *entry, KVListEntry::Key key) const
+{
+    return timers_.value(entry).contains(key);
+}
+
+void KVListScheduler::link(Timer *t)
+{
+    // choose the level by the distance: level n covers 64^(n+1) ticks; everything further away
+    // is parked at the top level and moved down again when its slot comes up
+    qint64 delta = qMax(t->due - currentTick_, qint64(0));
+    int level = 0;
+    while(level < Levels-1 && delta >= (qint64(1) << (SlotBits*(level+1))))
+        level++;
+    qint64 placeAt = currentTick_ + qMin(delta, (qint64(1) << (SlotBits*Levels)) - 1);
+
+    t->level = level;
+    t->slot = int(placeAt >> (SlotBits*level)) & (Slots-1);
+    t->prev = nullptr;
+    t->next = slots_[level][t->slot];
+    if(t->next)
+        t->next->prev = t;
+    slots_[level][t->slot] = t;
+    occupied_[level] |= quint64(1) << t->slot;
+    count_++;
+}
+
+void KVListScheduler::unlink(Timer *t)
+{
+    if(t->level < 0)
+        return;
+
+    if(t->prev)
+        t->prev->next = t->next;
+    else
+        slots_[t->level][t->slot] = t->next;
+    if(t->next)
+        t->next->prev = t->prev;
+    if(!slots_[t->level][t->slot])
+        occupied_[t->level] &= ~(quint64(1) << t->slot);
+
+    t->level = t->slot = -1;
+    t->prev = t->next = nullptr;
+    count_--;
+}
+
+void KVListScheduler::remove(Timer *t)
+{
+    // timers which are due are deleted by run()
+    if(t->level < 0) {
+        t->cancelled = true;
+        return;
+    }
+    unlink(t);
+    delete t;
+}
+
+void KVListScheduler::cascade(int level, int slot)
+{
+    Timer *t = slots_[level][slot];
+    slots_[level][slot] = nullptr;
+    occupied_[level] &= ~(quint64(1) << slot);
+
+    while(t) {
+        Timer *next = t->next;
+        t->level = -1;
+        count_--;
+        link(t);
+        t = next;
+    }
+}
+
+void KVListScheduler::advanceTo(qint64 tick, QVector<Timer*> &expired)
+{
+    while(currentTick_ < tick) {
+        currentTick_++;
+
+        // a lower level wrapped around: move the timers of the next slot one level down
+        for(int level=1; level<Levels; level++) {
+            if(currentTick_ & ((qint64(1) << (SlotBits*level)) - 1))
+                break;
+            cascade(level, int(currentTick_ >> (SlotBits*level)) & (Slots-1));
+        }
+
+        int slot = int(currentTick_) & (Slots-1);
+        while(Timer *t = slots_[0][slot]) {
+            unlink(t);
+            expired << t;
+        }
+    }
+}
+
+void KVListScheduler::run(const QVector<Timer*> &expired)
+{
+    // one update batch per affected model, so all values refreshed within this tick
+    // are reported via coalesced dataChanged() notifications
+    QSet<KVListModel*> seen;
+    QVector<QPointer<KVListModel>> models;
+    for(Timer *t : expired) {
+        KVListModel *m = t->entry->getParentModel();
+        if(m && !seen.contains(m)) {
+            seen.insert(m);
+            models << m;
+            m->beginUpdateBatch();
+        }
+    }
+
+    running_ = true;
+    for(Timer *t : expired) {
+        if(!t->cancelled) {
+            // remove it first: the callback is allowed to schedule the next update for the same key
+            auto i = timers_.find(t->entry);
+            if(i != timers_.end()) {
+                i->remove(t->key);
+                if(i->isEmpty())
+                    timers_.erase(i);
+            }
+            t->func();
+        }
+        delete t;
+    }
+    running_ = false;
+
+    for(const QPointer<KVListModel> &m : models) {
+        if(m)
+            m->endUpdateBatch();
+    }
+}
+
+void KVListScheduler::onTimeout()
+{
+    QVector<Timer*> expired;
+    advanceTo(clock_.elapsed() / tickMs_, expired);
+    if(!expired.isEmpty())
+        run(expired);
+    rearm();
+}
+
+void KVListScheduler::rearm()
+{
+    if(count_ == 0) {
+        timer_.stop();
+        wakeTick_ = -1;
+        return;
+    }
+
+    wakeTick_ = nextWakeTick();
+    timer_.start(int(qBound(qint64(0), wakeTick_ * tickMs_ - clock_.elapsed(), qint64(INT_MAX))));
+}
+
+qint64 KVListScheduler::nextWakeTick() const
+{
+    // the next occupied slot of the lowest level; otherwise the next wrap-around, as the higher
+    // levels need to be cascaded then
+    for(int d=1; d<Slots; d++) {
+        if(occupied_[0] & (quint64(1) << (int(currentTick_ + d) & (Slots-1))))
+            return currentTick_ + d;
+    }
+    return (currentTick_ | (Slots-1)) + 1;
+}
@@ -0,0 +1,100 @@
+#ifndef KVLISTSCHEDULER_H
+#define KVLISTSCHEDULER_H
+
+#include <QObject>
+#include <QHash>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <functional>
+#include "kvlistentry.h"
+#include "kvlist_global.h"
+
+/**
+ * @brief The KVListScheduler class
+ *
+ * Shared timer for time based updates of entry values (e.g. "last seen 5 minutes ago").
+ * Instead of one QTimer per entry all pending updates are kept in a hierarchical timer wheel
+ * (4 levels of 64 slots, one tick per second) which is driven by a single QTimer that only
+ * wakes up when a slot is due.
+ *
+ * All updates which become due within the same tick are processed as one batch: the models
+ * of the affected entries are put into an update batch (KVListModel::beginUpdateBatch()), so
+ * the changes result in coalesced dataChanged() notifications.
+ *
+ * Usually it is used via KVListEntry::scheduleUpdate():
+ * <code>
+ * // refresh the displayed age of the entry in one minute
+ * scheduleUpdate(displayAge_ns, 60*1000, [this](){ updateDisplayAge(); });
+ * </code>
+ *
+ * Notes:
+ * - there is one pending update per entry and key; scheduling again replaces it
+ * - updates are never run early but may run up to one tick late
+ * - pending updates of an entry are cancelled when the entry is destroyed
+ * - main thread only
+ */
+class KVLIST_EXPORT KVListScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef std::function<void ()> Callback;
+
+    virtual ~KVListScheduler();
+
+    // the shared instance (created on first use, owned by the application object)
+    static KVListScheduler *instance();
+    static bool hasInstance();
+
+    // run 'func' for 'entry' in 'msecs'; replaces a pending update of the same entry/key
+    void schedule(KVListEntry *entry, KVListEntry::Key key, qint64 msecs, Callback func);
+    void cancel(const KVListEntry *entry, KVListEntry::Key key);
+    void cancelAll(const KVListEntry *entry);
+    bool isScheduled(const KVListEntry *entry, KVListEntry::Key key) const;
+
+    // number of pending updates
+    int size() const { return count_; }
+    int tickInterval() const { return tickMs_; }
+
+private:
+    static constexpr int Levels = 4;
+    static constexpr int SlotBits = 6;
+    static constexpr int Slots = 1 << SlotBits;
+
+    struct Timer {
+        KVListEntry *entry = nullptr;
+        KVListEntry::Key key = -1;
+        qint64 due = 0;             // tick
+        Callback func;
+        int level = -1;             // -1: not linked (due, waiting to be run)
+        int slot = -1;
+        Timer *prev = nullptr, *next = nullptr;
+        bool cancelled = false;
+    };
+
+    explicit KVListScheduler(int tickMs, QObject *parent = nullptr);
+
+    void link(Timer *t);
+    void unlink(Timer *t);
+    void remove(Timer *t);
+    void cascade(int level, int slot);
+    void advanceTo(qint64 tick, QVector<Timer*> &expired);
+    void run(const QVector<Timer*> &expired);
+    void onTimeout();
+    void rearm();
+    qint64 nextWakeTick() const;
+
+    const int tickMs_;
+    QElapsedTimer clock_;
+    QTimer timer_;
+    qint64 currentTick_ = 0;
+    qint64 wakeTick_ = -1;
+    bool running_ = false;
+    int count_ = 0;
+
+    Timer *slots_[Levels][Slots];
+    quint64 occupied_[Levels];
+    QHash<const KVListEntry*, QHash<KVListEntry::Key, Timer*>> timers_;
+};
+
+#endif // KVLISTSCHEDULER_H
@@ -1,26 +1,105 @@
 #include "kvlistserializer.h"
 #include "kvlistmodel.h"
+#include "kvlistcontainer.h"
 #include <QDebug>
+#include <QFile>
 #include <QMetaObject>
 #include <QMetaType>
 
-QMap<QString, std::function<KVListBase* (void)>> KVListSerializer::serializationFactory_;
+QHash<QString, int> KVListSerializer::typeIds_;
+QVector<KVListSerializer::FactoryFunc> KVListSerializer::factories_;
 
-void KVListSerializer::registerFactoryItem(const QString &name, std::function<KVListBase *()> createCallback)
+void KVListSerializer::registerFactoryItem(const QString &name, FactoryFunc createCallback)
 {
-    Q_ASSERT(!serializationFactory_.contains(name)); // cannot allow registering twice!
-    serializationFactory_[name] = createCallback;
+    Q_ASSERT(!typeIds_.contains(name)); // cannot allow registering twice!
+    typeIds_.insert(name, factories_.size());
+    factories_ << createCallback;
 }
 
-KVListBase *KVListSerializer::createItem(const QString &name) const
+int KVListSerializer::registeredType(const QString &name)
 {
-    if(!serializationFactory_.contains(name)) {
+    int typeId = typeIds_.value(name, -1);
+    if(typeId < 0)
         qCritical() << "Serialization:" << name << "not registered to Serializer's factory!";
+    return typeId;
+}
+
+KVListBase *KVListSerializer::createItem(const QString &name) const
+{
+    return createRegisteredItem(name);
+}
+
+KVListBase *KVListSerializer::createItem(int typeId) const
+{
+    return createRegisteredItem(typeId);
+}
+
+KVListBase *KVListSerializer::createRegisteredItem(const QString &name)
+{
+    return createRegisteredItem(registeredType(name));
+}
+
+KVListBase *KVListSerializer::createRegisteredItem(int typeId)
+{
+    if(typeId < 0 || typeId >= factories_.size())
         return nullptr;
+
+    return factories_[typeId]();
+}
+
+bool KVListSerializer::serializeToContainer(KVListModel *model, const QString &filename)
+{
+    QByteArray data = KVListContainer::pack(formatName(), serializeToBlocks(model));
+
+    QFile file(filename);
+    if(!file.open(QIODevice::WriteOnly)) {
+        qWarning(kvlist) << "Open the file for writing failed";
+        return false;
     }
+    bool res = file.write(data) == data.size();
+    file.close();
+    return res;
+}
 
-    return serializationFactory_[name]();
+bool KVListSerializer::deserializeContainerToExistingModel(KVListModel *model, const QString &filename)
+{
+    QByteArray data;
+    if(!readData(filename, true, data))
+        return false;
+
+    return deserializeDataToExistingModel(model, data);
 }
 
+bool KVListSerializer::readData(const QString &filename, bool isContainer, QByteArray &data) const
+{
+    QFile file(filename);
+    if(!file.open(QIODevice::ReadOnly)) {
+        qWarning(kvlist) << "Failed to open the file for reading.";
+        return false;
+    }
 
+    if(!isContainer) {
+        data = file.readAll();
+        return true;
+    }
+
+    KVListContainer container;
+    if(!container.open(file.readAll())) {
+        qWarning(kvlist) << "Failed to load the container:" << container.errorString();
+        return false;
+    }
+    file.close();
 
+    if(container.format() != formatName()) {
+        qWarning(kvlist) << "container holds format" << container.format() << "instead of" << formatName();
+        return false;
+    }
+
+    bool ok;
+    data = container.readAll(&ok);
+    if(!ok) {
+        qWarning(kvlist) << "Failed to load the container:" << container.errorString();
+        return false;
+    }
+    return true;
+}
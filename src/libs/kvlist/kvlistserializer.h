@@ -3,6 +3,9 @@
 
 #include <QObject>
 #include <QMap>
+#include <QHash>
+#include <QVector>
+#include <QByteArray>
 #include <QDebug>
 #include <functional>
 #include "kvlist_global.h"
@@ -38,8 +41,36 @@ public:
     // de-serialize from file: exsting model will be filled
     virtual bool deserializeToExistingModel(KVListModel* model, const QString &filename) = 0;
 
+    // short name of the format (e.g. "xml"); stored in containers to pick the right backend on load
+    virtual QString formatName() const = 0;
+
+    // serialize model into independent blocks; concatenating all blocks gives the complete document
+    // the first block carries the document header, each top level entry gets a block of its own
+    virtual QVector<QByteArray> serializeToBlocks(const KVListModel *model) const = 0;
+
+    // same as deserializeToNewModel() / deserializeToExistingModel(), but from memory
+    virtual KVListModel* deserializeDataToNewModel(const QByteArray &data) = 0;
+    virtual bool deserializeDataToExistingModel(KVListModel* model, const QByteArray &data) = 0;
+
+    // (de)serialize via the chunked and compressed container format (see KVListContainer)
+    bool serializeToContainer(KVListModel *model, const QString &filename);
+    bool deserializeContainerToExistingModel(KVListModel* model, const QString &filename);
+
+    // read the document from a file, or from a container in case 'isContainer' is set; thread safe
+    bool readData(const QString &filename, bool isContainer, QByteArray &data) const;
+
+    typedef std::function<KVListBase* (void)> FactoryFunc;
+
     // register you class here, so that deserializer can create an object of your class when necessary
-    static void registerFactoryItem(const QString &name, std::function<KVListBase* (void)> createCallback);
+    static void registerFactoryItem(const QString &name, FactoryFunc createCallback);
+
+    // id of a registered class (or -1 in case it is not registered); resolve the name once and
+    // create all objects of that type via the id, so there is no string lookup per object
+    static int registeredType(const QString &name);
+
+    // create an object of a registered class (or nullptr in case it is not registered)
+    static KVListBase *createRegisteredItem(const QString &name);
+    static KVListBase *createRegisteredItem(int typeId);
 
     // alloc handling e.g. handline an old xml with a newer KVListSerializer
     int versionMinor() const {return versionMinor_;}
@@ -47,18 +78,22 @@ public:
 
 protected:
     KVListBase *createItem(const QString &name) const;
+    KVListBase *createItem(int typeId) const;
     int versionMajor_ = 1, versionMinor_  = 0;
 
 private:
-    static QMap<QString, std::function<KVListBase* (void)>> serializationFactory_;
+    // name -> index into factories_
+    static QHash<QString, int> typeIds_;
+    static QVector<FactoryFunc> factories_;
 };
 
 
 // this is bullshit..  __COUNTER__ macro is not being incremented on clang...
+// the class name is taken from the static meta object, so no object is created during registration
 #define GLUE2(x,y,z) x##y##z
 #define GLUE(x,y,z) GLUE2(x,y,z)
 #define REGISTER_2_SERIALIZATION_FACTORY(_classname_) \
-    KVListSerializerRegistrar<_classname_> GLUE(tmp_, __COUNTER__, __LINE__)(_classname_().metaObject()->className())
+    KVListSerializerRegistrar<_classname_> GLUE(tmp_, __COUNTER__, __LINE__)(QString::fromLatin1(_classname_::staticMetaObject.className()))
 
 template<class T>
 class KVListSerializerRegistrar {
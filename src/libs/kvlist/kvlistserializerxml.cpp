@@ -1,13 +1,15 @@
 #include "kvlistserializerxml.h"
-#include <QDomDocument>
+#include <QXmlStreamReader>
 #include <QDebug>
 #include <QMetaObject>
 #include <QFile>
 #include <QVersionNumber>
 #include <QDateTime>
+#include <algorithm>
 
 #include "kvlistmodel.h"
 #include "kvlistentry.h"
+#include "kvlistparallel.h"
 #include "kvlist_global.h"
 
 static const char* NAME_KEY = "Key";
@@ -18,9 +20,67 @@ static const char* NAME_VALUE = "Value";
 static const char* NAME_CONTENT = "KVListSerializerXml";
 static const char* NAME_VERSION = "Version";
 static const char* NAME_DATE = "Date";
+static const char* NAME_ENCODING = "Encoding";
+static const char* ENCODING_BASE64 = "base64";
 static const char* PREFIX_SERIALIZE_IGNORE = "_noserialize";
 static const char* PREFIX_SERIALIZE_IGNORE2 = "_ns";
 
+// entries of the top level model are handed out to the thread pool in chunks of this size
+static const int SERIALIZE_GRAIN_SIZE = 4;
+static const int CONVERT_GRAIN_SIZE = 16;
+
+
+static bool isIgnoredKey(const QString &keyStr)
+{
+    return keyStr.endsWith(PREFIX_SERIALIZE_IGNORE) || keyStr.endsWith(PREFIX_SERIALIZE_IGNORE2);
+}
+
+static void appendIndent(QString &out, int depth)
+{
+    out += QString(depth, QLatin1Char(' '));
+}
+
+// line breaks and tabs are written as character references, a parser would normalize them otherwise
+static void appendAttribute(QString &out, const char *name, const QString &value)
+{
+    out += QLatin1Char(' ');
+    out += QLatin1String(name);
+    out += QLatin1String("=\"");
+    for(const QChar c : value) {
+        switch(c.unicode()) {
+        case '&':  out += QLatin1String("&amp;"); break;
+        case '<':  out += QLatin1String("&lt;"); break;
+        case '>':  out += QLatin1String("&gt;"); break;
+        case '"':  out += QLatin1String("&quot;"); break;
+        case '\n': out += QLatin1String("&#xa;"); break;
+        case '\r': out += QLatin1String("&#xd;"); break;
+        case '\t': out += QLatin1String("&#x9;"); break;
+        default:   out += c;
+        }
+    }
+    out += QLatin1Char('"');
+}
+
+static void appendStartTag(QString &out, const char *name, int depth)
+{
+    appendIndent(out, depth);
+    out += QLatin1Char('<');
+    out += QLatin1String(name);
+}
+
+static void appendEndTag(QString &out, const char *name, int depth)
+{
+    appendIndent(out, depth);
+    out += QLatin1String("</");
+    out += QLatin1String(name);
+    out += QLatin1String(">\n");
+}
+
+static QString attribute(const QXmlStreamReader &xml, const char *name)
+{
+    return xml.attributes().value(QLatin1String(name)).toString();
+}
+
 
 KVListSerializerXml::KVListSerializerXml(QObject *parent) : KVListSerializer(parent)
 {
@@ -28,182 +88,362 @@ KVListSerializerXml::KVListSerializerXml(QObject *parent) : KVListSerializer(par
 
 bool KVListSerializerXml::serialize(KVListModel *model, const QString &filename)
 {
-    QDomDocument document;
-    QDomElement el = document.createElement(NAME_CONTENT);
-    document.appendChild(el);
-
-    // in case xml layout changes later, we want to have a version stored...
-    el.setAttribute(NAME_VERSION, QVersionNumber(versionMajor(), versionMinor()).toString());
-    el.setAttribute(NAME_DATE, QDateTime::currentDateTime().toString());
-    el.appendChild(serialize(document, model));
+    QByteArray data = serializeToData(model);
 
     // Writing to a file
     QFile file(filename);
-    if(!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+    if(!file.open(QIODevice::WriteOnly)) {
         qWarning(kvlist) << "Open the file for writing failed";
         return false;
     } else {
-        QTextStream stream(&file);
-        stream << document.toString();
+        bool res = file.write(data) == data.size();
         file.close();
-        return true;
+        return res;
     }
 }
 
+QByteArray KVListSerializerXml::serializeToData(const KVListModel *model) const
+{
+    QVector<QByteArray> blocks = serializeToBlocks(model);
+
+    int size = 0;
+    for(const QByteArray &b : blocks)
+        size += b.size();
 
+    QByteArray data;
+    data.reserve(size);
+    for(const QByteArray &b : blocks)
+        data += b;
+    return data;
+}
 
-QDomElement KVListSerializerXml::serialize(QDomDocument &document, KVListModel *model)
+QVector<QByteArray> KVListSerializerXml::serializeToBlocks(const KVListModel *model) const
 {
     Q_ASSERT(model);
 
-    QDomElement el = document.createElement(NAME_MODEL);
-    el.setAttribute(NAME_TYPE, model->metaObject()->className());
-    el.setAttribute(NAME_VERSION, QVersionNumber(model->versionMajor(), model->versionMinor()).toString());
+    QString head;
+    head += QLatin1String("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
 
-    for(KVListEntry *entry : *model)
-        el.appendChild(serialize(document, entry));
-
-    return el;
+    // in case xml layout changes later, we want to have a version stored...
+    appendStartTag(head, NAME_CONTENT, 0);
+    appendAttribute(head, NAME_VERSION, QVersionNumber(versionMajor(), versionMinor()).toString());
+    appendAttribute(head, NAME_DATE, QDateTime::currentDateTime().toString());
+    head += QLatin1String(">\n");
+
+    appendStartTag(head, NAME_MODEL, 1);
+    appendAttribute(head, NAME_TYPE, model->metaObject()->className());
+    appendAttribute(head, NAME_VERSION, QVersionNumber(model->versionMajor(), model->versionMinor()).toString());
+
+    QString tail;
+    if(model->size() == 0)
+        head += QLatin1String("/>\n");
+    else {
+        head += QLatin1String(">\n");
+        appendEndTag(tail, NAME_MODEL, 1);
+    }
+    appendEndTag(tail, NAME_CONTENT, 0);
+
+    // head, one block per entry, tail
+    QVector<QByteArray> blocks(model->size() + 2);
+    blocks.first() = head.toUtf8();
+    blocks.last() = tail.toUtf8();
+
+    // each entry block (including its child models) is independent from the others
+    QByteArray *out = blocks.data() + 1;
+    QVector<KVListEntry*>::const_iterator entries = model->begin();
+    KVListParallel::forEach(model->size(), [&](int i){
+        // entries the model re-creates by itself stay empty
+        if(model->isDefaultEntry(entries[i]))
+            return;
+        QString block;
+        writeEntry(block, entries[i], 2);
+        out[i] = block.toUtf8();
+    }, SERIALIZE_GRAIN_SIZE);
+
+    return blocks;
 }
 
-QDomElement KVListSerializerXml::serialize(QDomDocument &document, KVListEntry *entry)
+void KVListSerializerXml::writeModel(QString &out, const KVListModel *model, int depth) const
 {
-    QDomElement el = document.createElement(NAME_ENTRY);
-    el.setAttribute(NAME_TYPE, entry->metaObject()->className());
+    appendStartTag(out, NAME_MODEL, depth);
+    appendAttribute(out, NAME_TYPE, model->metaObject()->className());
+    appendAttribute(out, NAME_VERSION, QVersionNumber(model->versionMajor(), model->versionMinor()).toString());
+
+    QString entries;
+    for(const KVListEntry *entry : *model) {
+        if(!model->isDefaultEntry(entry))
+            writeEntry(entries, entry, depth+1);
+    }
+
+    if(entries.isEmpty()) {
+        out += QLatin1String("/>\n");
+        return;
+    }
+
+    out += QLatin1String(">\n");
+    out += entries;
+    appendEndTag(out, NAME_MODEL, depth);
+}
 
+void KVListSerializerXml::writeEntry(QString &out, const KVListEntry *entry, int depth) const
+{
     QHash<int, QByteArray> roleNames = entry->getParentModel()->roleNames();
 
+    // values equal to the defaults of the type are restored from there on load
+    const KVListEntry::KeyValueMap defaults = entry->defaultValues();
+
+    QString values;
     for(KVListEntry::Key key : entry->keys()) {
         QString keyStr = roleNames.value(key);
-        if(!keyStr.endsWith(PREFIX_SERIALIZE_IGNORE) || keyStr.endsWith(PREFIX_SERIALIZE_IGNORE2)) {
-        QDomElement el2 = serialize(document, keyStr, entry->getValue(key));
-        if(!el2.isNull())
-            el.appendChild(el2);
-        }
+        if(isIgnoredKey(keyStr))
+            continue;
+
+        QVariant value = entry->getValue(key);
+        auto d = defaults.constFind(key);
+        if(d != defaults.constEnd() && d.value() == value)
+            continue;
+
+        writeValue(values, keyStr, value, depth+1);
     }
 
-    return el;
+    appendStartTag(out, NAME_ENTRY, depth);
+    appendAttribute(out, NAME_TYPE, entry->metaObject()->className());
+    if(values.isEmpty()) {
+        out += QLatin1String("/>\n");
+    } else {
+        out += QLatin1String(">\n");
+        out += values;
+        appendEndTag(out, NAME_ENTRY, depth);
+    }
 }
 
-QDomElement KVListSerializerXml::serialize(QDomDocument &document, const QString key, const QVariant &value)
+void KVListSerializerXml::writeValue(QString &out, const QString &key, const QVariant &value, int depth) const
 {
-    QDomElement el = document.createElement(NAME_VALUE);
-    el.setAttribute(NAME_KEY, key);
-
     if(value.canConvert<KVListModel*>())
     {
-        el.setAttribute(NAME_TYPE, NAME_MODEL);
-        el.appendChild(serialize(document, value.value<KVListModel*>()));
+        const KVListModel *model = value.value<KVListModel*>();
+        if(!model)
+            return;
+
+        // the model re-creates all of its entries by itself, nothing to store
+        if(model->size() > 0 && std::all_of(model->begin(), model->end(), [model](const KVListEntry *e){ return model->isDefaultEntry(e); }))
+            return;
+
+        appendStartTag(out, NAME_VALUE, depth);
+        appendAttribute(out, NAME_KEY, key);
+        appendAttribute(out, NAME_TYPE, NAME_MODEL);
+        out += QLatin1String(">\n");
+        writeModel(out, model, depth+1);
+        appendEndTag(out, NAME_VALUE, depth);
     }
     else if(value.canConvert<QObject*>() || value.canConvert<void*>())
     {
         // never serialize pointers... this will only cause errer!
-        return QDomElement();
+        return;
     }
     else
     {
-        el.setAttribute(NAME_TYPE, value.typeName());
-        el.setAttribute(NAME_VALUE, value.toString());
+        appendStartTag(out, NAME_VALUE, depth);
+        appendAttribute(out, NAME_KEY, key);
+        appendAttribute(out, NAME_TYPE, value.typeName());
+        // binary data (e.g. small blobs) would not survive the utf-8 string; marked, files written before
+        // hold the text as is
+        if(value.userType() == QMetaType::QByteArray) {
+            appendAttribute(out, NAME_ENCODING, ENCODING_BASE64);
+            appendAttribute(out, NAME_VALUE, QString::fromLatin1(value.toByteArray().toBase64()));
+        }
+        else
+            appendAttribute(out, NAME_VALUE, value.toString());
+        out += QLatin1String("/>\n");
     }
-    return el;
 }
 
 
 
 KVListModel *KVListSerializerXml::deserializeToNewModel(const QString &filename)
 {
-    QDomDocument document;
-
     // Open a file for reading
     QFile file(filename);
-    if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    if(!file.open(QIODevice::ReadOnly))
     {
         qWarning() << "Failed to open the file for reading.";
         return nullptr;
     }
-    else
-    {
-        // loading
-        if(!document.setContent(&file))
-        {
-            qWarning() << "Failed to load the file for reading.";
-            return nullptr;
-        }
-        file.close();
-    }
+    QByteArray data = file.readAll();
+    file.close();
 
-    QDomElement root = document.firstChildElement();
-
-    if(root.tagName() != NAME_CONTENT) {
-        qWarning() << "xml supposed to start with another tag";
-        return nullptr;
-    }
-
-    QVersionNumber version = QVersionNumber::fromString(root.attribute(NAME_VERSION));
-    if((version.majorVersion() != versionMajor()) ||
-            (version.minorVersion() != versionMinor())) {
-        qWarning() << "xml must have version" << QVersionNumber(versionMajor(), versionMinor()).toString();
-        return nullptr;
-    }
-
-    return deserializeChildModel(root.firstChildElement());
+    return deserializeDataToNewModel(data);
 }
 
 bool KVListSerializerXml::deserializeToExistingModel(KVListModel *model, const QString &filename)
 {
-    QDomDocument document;
-
     // Open a file for reading
     QFile file(filename);
-    if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    if(!file.open(QIODevice::ReadOnly))
     {
         qWarning() << "Failed to open the file for reading.";
         return false;
     }
-    else
-    {
-        // loading
-        if(!document.setContent(&file))
-        {
-            qWarning() << "Failed to load the file for reading.";
-            return false;
-        }
-        file.close();
-    }
+    QByteArray data = file.readAll();
+    file.close();
+
+    return deserializeDataToExistingModel(model, data);
+}
+
+KVListModel *KVListSerializerXml::deserializeDataToNewModel(const QByteArray &data)
+{
+    ModelData root;
+    if(!parse(data, root))
+        return nullptr;
+
+    return attachChildModel(root);
+}
+
+bool KVListSerializerXml::deserializeDataToExistingModel(KVListModel *model, const QByteArray &data)
+{
+    ModelData root;
+    if(!parse(data, root))
+        return false;
 
-    QDomElement root = document.firstChildElement();
+    return attachModel(root, model);
+}
+
+bool KVListSerializerXml::parse(const QByteArray &data, ModelData &root) const
+{
+    QXmlStreamReader xml(data);
 
-    if(root.tagName() != NAME_CONTENT) {
+    if(!xml.readNextStartElement() || xml.name() != QLatin1String(NAME_CONTENT)) {
         qWarning() << "xml supposed to start with another tag";
         return false;
     }
 
-    QVersionNumber version = QVersionNumber::fromString(root.attribute(NAME_VERSION));
+    QVersionNumber version = QVersionNumber::fromString(attribute(xml, NAME_VERSION));
     if((version.majorVersion() != versionMajor()) ||
             (version.minorVersion() != versionMinor())) {
         qWarning() << "xml must have version" << QVersionNumber(versionMajor(), versionMinor()).toString();
         return false;
     }
 
-    return deserializeModel(root.firstChildElement(), model);
+    if(!xml.readNextStartElement() || xml.name() != QLatin1String(NAME_MODEL) || !parseModel(xml, root)) {
+        qWarning() << "Failed to load the file for reading." << xml.errorString();
+        return false;
+    }
+
+    // the expensive part (string -> value conversion) is done per entry block on the thread pool
+    EntryData *entries = root.entries.data();
+    KVListParallel::forEach(root.entries.size(), [&](int i){
+        convertEntry(entries[i]);
+    }, CONVERT_GRAIN_SIZE);
+
+    return true;
 }
 
+bool KVListSerializerXml::parseModel(QXmlStreamReader &xml, ModelData &model) const
+{
+    // reader is positioned on the model's start element
+    model.type = attribute(xml, NAME_TYPE);
+    model.version = QVersionNumber::fromString(attribute(xml, NAME_VERSION));
+
+    // entries of a model are usually of the same type: resolve the factory only when the type changes
+    QString lastType;
+    int lastTypeId = -1;
 
-KVListModel *KVListSerializerXml::deserializeChildModel(const QDomElement &el, KVListModel *destination)
+    while(xml.readNextStartElement())
+    {
+        if(xml.name() != QLatin1String(NAME_ENTRY)) {
+            xml.skipCurrentElement();
+            continue;
+        }
+
+        EntryData entry;
+        entry.type = attribute(xml, NAME_TYPE);
+        if(entry.type == lastType)
+            entry.type = lastType; // share the string
+        else {
+            lastType = entry.type;
+            lastTypeId = registeredType(entry.type);
+        }
+        entry.typeId = lastTypeId;
+
+        while(xml.readNextStartElement())
+        {
+            if(xml.name() != QLatin1String(NAME_VALUE)) {
+                xml.skipCurrentElement();
+                continue;
+            }
+
+            ValueData value;
+            value.key = attribute(xml, NAME_KEY);
+            value.type = attribute(xml, NAME_TYPE);
+
+            if(value.type == QLatin1String(NAME_MODEL)) // another model!
+            {
+                if(xml.readNextStartElement()) {
+                    if(xml.name() == QLatin1String(NAME_MODEL)) {
+                        value.model.reset(new ModelData);
+                        if(!parseModel(xml, *value.model))
+                            return false;
+                    }
+                    else
+                        xml.skipCurrentElement();
+
+                    xml.skipCurrentElement(); // rest of the value element
+                }
+            }
+            else
+            {
+                value.text = attribute(xml, NAME_VALUE);
+                value.base64 = attribute(xml, NAME_ENCODING) == QLatin1String(ENCODING_BASE64);
+                xml.skipCurrentElement();
+            }
+
+            entry.values << value;
+        }
+
+        model.entries << entry;
+    }
+
+    return !xml.hasError();
+}
+
+void KVListSerializerXml::convertEntry(EntryData &entry) const
 {
-    if(el.tagName() != NAME_MODEL)
-        return nullptr;
+    for(ValueData &value : entry.values)
+    {
+        if(value.model) {
+            for(EntryData &childEntry : value.model->entries)
+                convertEntry(childEntry);
+            continue;
+        }
+
+        // also registered types, e.g. KVListBlob (stored as reference)
+        int typeId = QMetaType::type(value.type.toLocal8Bit().data());
+        if(typeId == QMetaType::UnknownType)
+            continue;
+        if(typeId == QMetaType::QByteArray && value.base64) {
+            value.value = QByteArray::fromBase64(value.text.toLatin1());
+            continue;
+        }
 
+        QVariant v(value.text);
+        if(v.convert(typeId))
+            value.value = v;
+    }
+}
+
+
+KVListModel *KVListSerializerXml::attachChildModel(const ModelData &data, KVListModel *destination)
+{
     KVListModel *m = nullptr;
     if(destination) {
-        if(destination->metaObject()->className() != el.attribute(NAME_TYPE))
+        if(destination->metaObject()->className() != data.type)
             return nullptr;
         else
             m = destination;
     }
     else {
 
-        KVListBase *b = createItem(el.attribute(NAME_TYPE));
+        KVListBase *b = createItem(data.type);
         if(!b)
             return nullptr;
         m = dynamic_cast<KVListModel*>(b);
@@ -212,53 +452,57 @@ KVListModel *KVListSerializerXml::deserializeChildModel(const QDomElement &el, K
             return nullptr;
         }
     }
-    if(!deserializeModel(el, m)) {
-        delete m;
+    if(!attachModel(data, m)) {
+        if(m != destination)
+            delete m;
         return nullptr;
     }
 
     return m;
 }
 
-bool KVListSerializerXml::deserializeModel(const QDomElement &el, KVListModel *model)
+bool KVListSerializerXml::attachModel(const ModelData &data, KVListModel *model)
 {
-    if(el.tagName() != NAME_MODEL)
+    if(!canAttach(data, model))
         return false;
 
-    if(el.attribute(NAME_TYPE) != model->metaObject()->className())
+    model->appendEntries(createEntries(data, model, 0, data.entries.size()));
+    return true;
+}
+
+bool KVListSerializerXml::canAttach(const ModelData &data, const KVListModel *model) const
+{
+    if(data.type != model->metaObject()->className())
         return false;
 
-    QVersionNumber version = QVersionNumber::fromString(el.attribute(NAME_VERSION));
-    if((version.majorVersion() != model->versionMajor()) ||
-            (version.minorVersion() != model->versionMinor())) {
+    if((data.version.majorVersion() != model->versionMajor()) ||
+            (data.version.minorVersion() != model->versionMinor())) {
         qWarning() << "xml must have version" << QVersionNumber(model->versionMajor(), model->versionMinor()).toString();
         return false;
     }
 
-    QDomNodeList nodes = el.childNodes();
-    for(int i = 0; i < nodes.count(); i++)
-    {
-        QDomNode elm = nodes.at(i);
-        if(elm.isElement())
-        {
-            QDomElement e = elm.toElement();
-            KVListEntry * entry = deserializeEntry(e, model, version);
-
-            if(entry)
-                model->append(entry);
-        }
-    }
-
     return true;
 }
 
-KVListEntry *KVListSerializerXml::deserializeEntry(const QDomElement &el, KVListModel *model, const QVersionNumber &modelVersion)
+QVector<KVListEntry*> KVListSerializerXml::createEntries(const ModelData &data, KVListModel *model, int first, int count)
 {
-    if(el.tagName() != NAME_ENTRY)
-        return nullptr;
+    QVector<KVListEntry*> entries;
+    const int last = qMin(first + count, data.entries.size());
+    entries.reserve(qMax(0, last - first));
 
+    for(int i=first; i<last; i++)
+    {
+        KVListEntry *entry = attachEntry(data.entries[i], model, data.version);
+        if(entry)
+            entries << entry;
+    }
+
+    return entries;
+}
 
-    KVListBase *b = createItem(el.attribute(NAME_TYPE));
+KVListEntry *KVListSerializerXml::attachEntry(const EntryData &data, KVListModel *model, const QVersionNumber &modelVersion)
+{
+    KVListBase *b = createItem(data.typeId);
     if(!b)
         return nullptr;
 
@@ -269,47 +513,38 @@ KVListEntry *KVListSerializerXml::deserializeEntry(const QDomElement &el, KVList
         return nullptr;
     }
 
-    QDomNodeList nodes = el.childNodes();
-    QMap<KVListEntry::Key, QVariant> values;
-
-    for(int i = 0; i < nodes.count(); i++)
+    // values equal to the defaults have not been stored
+    QMap<KVListEntry::Key, QVariant> values = e->defaultValues();
+    for(const ValueData &valueData : data.values)
     {
-        QDomNode elm = nodes.at(i);
-        if(elm.isElement())
-        {
-            QDomElement el = elm.toElement();
-            QPair<KVListEntry::Key, QVariant> value = deserializeValue(el, model, e, modelVersion);
-            if(value.first >= 0)
-                values.insert(value.first, value.second);
-        }
+        QPair<KVListEntry::Key, QVariant> value = attachValue(valueData, model, e, modelVersion);
+        if(value.first >= 0)
+            values.insert(value.first, value.second);
     }
     e->setValues(values);
 
     return e;
 }
 
-QPair<KVListEntry::Key, QVariant> KVListSerializerXml::deserializeValue(const QDomElement &el, KVListModel *model, KVListEntry *entry, const QVersionNumber &modelVersion)
+QPair<KVListEntry::Key, QVariant> KVListSerializerXml::attachValue(const ValueData &data, KVListModel *model, KVListEntry *entry, const QVersionNumber &modelVersion)
 {
-    if(el.tagName() != NAME_VALUE)
-        return qMakePair(-1, QVariant());
-
-    QString typeStr = el.attribute(NAME_TYPE);
-    QString keyStr = el.attribute(NAME_KEY);
-
-    if(keyStr.endsWith(PREFIX_SERIALIZE_IGNORE) || keyStr.endsWith(PREFIX_SERIALIZE_IGNORE2)) {
+    if(isIgnoredKey(data.key)) {
         return qMakePair(-1, QVariant());
     }
 
-    KVListEntry::Key key = model->lookupKey(keyStr, modelVersion);
+    KVListEntry::Key key = model->lookupKey(data.key, modelVersion);
     if(key < 0) {
-        qWarning() << "unknown key in xml found:" << el.attribute(NAME_KEY);
+        qWarning() << "unknown key in xml found:" << data.key;
         return qMakePair(-1, QVariant());
     }
 
-    if(typeStr == NAME_MODEL) // another model!
+    if(data.type == QLatin1String(NAME_MODEL)) // another model!
     {
+        if(!data.model)
+            return qMakePair(-1, QVariant());
+
         // in case the childmodel has already been added to the entry, we just use the existing one!
-        KVListModel* childmodel = deserializeChildModel(el.firstChildElement(), entry->getChildModel(key));
+        KVListModel* childmodel = attachChildModel(*data.model, entry->getChildModel(key));
         if(!childmodel)
             return qMakePair(-1, QVariant());
 
@@ -321,13 +556,8 @@ QPair<KVListEntry::Key, QVariant> KVListSerializerXml::deserializeValue(const QD
     }
     else
     {
-        QVariant::Type typeId = QVariant::nameToType(typeStr.toLocal8Bit().data());
-        if(typeId == QVariant::Invalid)
-            return qMakePair(-1, QVariant());
-
-        QVariant v(el.attribute(NAME_VALUE));
-        if(!v.convert(typeId))
+        if(!data.value.isValid())
             return qMakePair(-1, QVariant());
-        return qMakePair(key, v);
+        return qMakePair(key, data.value);
     }
 }
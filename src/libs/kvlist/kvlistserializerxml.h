@@ -3,11 +3,24 @@
 
 #include "kvlistserializer.h"
 #include "kvlistentry.h"
-#include <QDomElement>
-#include <QDomDocument>
-
+#include <QVector>
+#include <QVariant>
+#include <QSharedPointer>
+#include <QVersionNumber>
 
+class QXmlStreamReader;
 
+/**
+ * @brief The KVListSerializerXml class
+ *
+ * Saving: every entry of the top level model (including its child models) is encoded into its own
+ * buffer on the thread pool; the buffers are concatenated in order afterwards. The output does
+ * not depend on the number of threads.
+ *
+ * Loading: the file is parsed into a detached tree (ModelData) that only holds plain values.
+ * Converting the values of the entry blocks happens in parallel; entries are created and attached
+ * to the models on the calling thread.
+ */
 class KVListSerializerXml : public KVListSerializer
 {
     Q_OBJECT
@@ -20,15 +33,55 @@ public:
     KVListModel* deserializeToNewModel(const QString &filename) override;
     bool deserializeToExistingModel(KVListModel* model, const QString &filename) override;
 
+    QString formatName() const override { return "xml"; }
+    QVector<QByteArray> serializeToBlocks(const KVListModel *model) const override;
+    KVListModel* deserializeDataToNewModel(const QByteArray &data) override;
+    bool deserializeDataToExistingModel(KVListModel* model, const QByteArray &data) override;
+
+    // the complete document (all blocks joined)
+    QByteArray serializeToData(const KVListModel *model) const;
+
+    // detached representation of a file; contains no QObjects and can be used on any thread
+    struct ModelData;
+    struct ValueData {
+        QString key, type, text;
+        bool base64 = false;                // 'text' is base64 encoded binary data
+        QVariant value;                     // 'text' converted to 'type' (invalid on error)
+        QSharedPointer<ModelData> model;    // set in case the value holds another model
+    };
+    struct EntryData {
+        QString type;
+        int typeId = -1;                    // 'type' resolved via KVListSerializer::registeredType()
+        QVector<ValueData> values;
+    };
+    struct ModelData {
+        QString type;
+        QVersionNumber version;
+        QVector<EntryData> entries;
+    };
+
+    // parse the file content and convert all values; thread safe
+    bool parse(const QByteArray &data, ModelData &root) const;
+
+    // create the entries for the parsed data and add them to model; must be called from the models thread
+    KVListModel* attachChildModel(const ModelData &data, KVListModel *destination=nullptr);
+    bool attachModel(const ModelData &data, KVListModel* model);
+
+    // attaching piece by piece (e.g. KVListModel::deSerializeAsync()): check type and version once,
+    // then create the entries [first .. first+count-1]; the caller adds them to the model
+    bool canAttach(const ModelData &data, const KVListModel *model) const;
+    QVector<KVListEntry*> createEntries(const ModelData &data, KVListModel *model, int first, int count);
+
 private:
-    QDomElement serialize(QDomDocument &document, KVListModel *model);
-    QDomElement serialize(QDomDocument &document, KVListEntry *entry);
-    QDomElement serialize(QDomDocument &document, const QString key, const QVariant  &value);
-
-    KVListModel* deserializeChildModel(const QDomElement &el, KVListModel *destination=nullptr);
-    bool deserializeModel(const QDomElement &el, KVListModel* model);
-    KVListEntry *deserializeEntry(const QDomElement &el, KVListModel *model, const QVersionNumber &modelVersion);
-    QPair<KVListEntry::Key, QVariant> deserializeValue(const QDomElement &el, KVListModel *model, KVListEntry *entry, const QVersionNumber &modelVersion);
+    void writeModel(QString &out, const KVListModel *model, int depth) const;
+    void writeEntry(QString &out, const KVListEntry *entry, int depth) const;
+    void writeValue(QString &out, const QString &key, const QVariant &value, int depth) const;
+
+    bool parseModel(QXmlStreamReader &xml, ModelData &model) const;
+    void convertEntry(EntryData &entry) const;
+
+    KVListEntry *attachEntry(const EntryData &data, KVListModel *model, const QVersionNumber &modelVersion);
+    QPair<KVListEntry::Key, QVariant> attachValue(const ValueData &data, KVListModel *model, KVListEntry *entry, const QVersionNumber &modelVersion);
 };
 
 #endif // KVLISTSERIALIZERXML_H
@@ -0,0 +1,209 @@
+#include "kvlisttextindex.h"
+
+
+KVListTextIndex::KVListTextIndex(KVListModel *model, const QVector<KVListEntry::Key> &keys) :
+    QObject(model),
+    model_(model),
+    keys_(keys)
+{
+    Q_ASSERT(model);
+    model->addObserver(this);
+    rebuild();
+}
+
+KVListTextIndex::~KVListTextIndex()
+{
+    if(model_)
+        model_->removeObserver(this);
+}
+
+QStringList KVListTextIndex::words(const QString &text)
+{
+    // decompose, so that accents are separate marks which can be dropped ("é" -> "e")
+    const QString decomposed = text.normalized(QString::NormalizationForm_KD);
+
+    QStringList words;
+    QString word;
+    for(const QChar c : decomposed) {
+        if(c.isMark())
+            continue;
+        if(c.isLetterOrNumber()) {
+            word += c.toCaseFolded();
+        } else if(!word.isEmpty()) {
+            words << word;
+            word.clear();
+        }
+    }
+    if(!word.isEmpty())
+        words << word;
+    return words;
+}
+
+QStringList KVListTextIndex::wordsOf(const KVListEntry *entry) const
+{
+    QStringList result;
+    for(KVListEntry::Key key : keys_)
+        result += words(entry->getValue(key).toString());
+    result.removeDuplicates();
+    return result;
+}
+
+void KVListTextIndex::rebuild()
+{
+    dictionary_.clear();
+    entryWords_.clear();
+    lastValid_ = false;
+    lastResult_.clear();
+
+    if(!model_)
+        return;
+    entryWords_.reserve(model_->size());
+    for(KVListEntry *e : *model_)
+        addEntry(e);
+}
+
+void KVListTextIndex::addEntry(KVListEntry *entry)
+{
+    QStringList w = wordsOf(entry);
+    for(const QString &word : w)
+        dictionary_[word].insert(entry);
+    entryWords_.insert(entry, w);
+}
+
+void KVListTextIndex::removeEntry(KVListEntry *entry)
+{
+    const QStringList w = entryWords_.take(entry);
+    for(const QString &word : w) {
+        auto i = dictionary_.find(word);
+        if(i == dictionary_.end())
+            continue;
+        i->second.remove(entry);
+        if(i->second.isEmpty())
+            dictionary_.erase(i);
+    }
+}
+
+void KVListTextIndex::updateLastResult(KVListEntry *entry)
+{
+    if(!lastValid_)
+        return;
+    if(matches(entry, lastWords_))
+        lastResult_.insert(entry);
+    else
+        lastResult_.remove(entry);
+}
+
+bool KVListTextIndex::matches(const KVListEntry *entry, const QStringList &words) const
+{
+    if(words.isEmpty())
+        return true;
+
+    // entries which have not been reported yet (e.g. asked from rowsInserted) are tokenized on the fly
+    auto i = entryWords_.constFind(entry);
+    const QStringList entryWords = i != entryWords_.constEnd() ? *i : wordsOf(entry);
+
+    for(const QString &q : words) {
+        bool found = false;
+        for(const QString &w : entryWords) {
+            if(w.startsWith(q)) {
+                found = true;
+                break;
+            }
+        }
+        if(!found)
+            return false;
+    }
+    return true;
+}
+
+QSet<KVListEntry*> KVListTextIndex::search(const QString &text)
+{
+    const QStringList w = words(text);
+    QSet<KVListEntry*> result;
+
+    if(w.isEmpty()) {
+        lastValid_ = false;
+        lastResult_.clear();
+        if(model_) {
+            result.reserve(model_->size());
+            for(KVListEntry *e : *model_)
+                result.insert(e);
+        }
+        return result;
+    }
+
+    // the next keystroke: every word of the previous query is the prefix of the new one at the same
+    // position, so the new result is a subset of the previous one
+    bool refinement = lastValid_ && w.size() >= lastWords_.size();
+    for(int i=0; refinement && i<lastWords_.size(); i++)
+        refinement = w.at(i).startsWith(lastWords_.at(i));
+
+    if(refinement) {
+        for(KVListEntry *e : lastResult_) {
+            if(matches(e, w))
+                result.insert(e);
+        }
+    } else {
+        // collect the candidates of the longest (most selective) word from the dictionary
+        const QString *longest = &w.first();
+        for(const QString &q : w) {
+            if(q.size() > longest->size())
+                longest = &q;
+        }
+
+        QSet<KVListEntry*> candidates;
+        for(auto i = dictionary_.lower_bound(*longest); i != dictionary_.end() && i->first.startsWith(*longest); ++i)
+            candidates.unite(i->second);
+
+        if(w.size() == 1) {
+            result.swap(candidates);
+        } else {
+            for(KVListEntry *e : candidates) {
+                if(matches(e, w))
+                    result.insert(e);
+            }
+        }
+    }
+
+    lastWords_ = w;
+    lastResult_ = result;
+    lastValid_ = true;
+    return result;
+}
+
+void KVListTextIndex::modelAboutToBeReset(KVListModel * /*model*/)
+{
+    // the entries may be deleted or recycled before the reset is done
+    dictionary_.clear();
+    entryWords_.clear();
+    lastValid_ = false;
+    lastResult_.clear();
+}
+
+void KVListTextIndex::modelReset(KVListModel * /*model*/)
+{
+    rebuild();
+}
+
+void KVListTextIndex::entryInserted(KVListModel * /*model*/, int /*row*/, KVListEntry *entry)
+{
+    addEntry(entry);
+    updateLastResult(entry);
+}
+
+void KVListTextIndex::entryAboutToBeRemoved(KVListModel * /*model*/, int /*row*/, KVListEntry *entry)
+{
+    removeEntry(entry);
+    lastResult_.remove(entry);
+}
+
+void KVListTextIndex::valueChanged(KVListModel * /*model*/, KVListEntry *entry, KVListEntry::Key key,
+                                   const QVariant & /*oldValue*/, const QVariant & /*newValue*/)
+{
+    if(!keys_.contains(key))
+        return;
+
+    removeEntry(entry);
+    addEntry(entry);
+    updateLastResult(entry);
+}
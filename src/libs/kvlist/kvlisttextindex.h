@@ -0,0 +1,94 @@
+#ifndef KVLISTTEXTINDEX_H
+#define KVLISTTEXTINDEX_H
+
+#include <QObject>
+#include <QPointer>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <map>
+#include "kvlistentry.h"
+#include "kvlistmodel.h"
+#include "kvlistmodelobserver.h"
+#include "kvlist_global.h"
+
+/**
+ * @brief The KVListTextIndex class
+ *
+ * Prefix search over the string values of some keys of a KVListModel, e.g. for a live search
+ * while the user types.
+ *
+ * Values are normalized (case folded, accents removed) and split into words; the words are kept in
+ * a sorted dictionary pointing to the entries. A query is split the same way and matches an entry
+ * if every query word is the prefix of one of the entry's words ("jo sm" matches "John Smith",
+ * "jo@ex" matches "john@example.com").
+ *
+ * The index is maintained incrementally via KVListModelObserver. A query which extends the previous
+ * one (the next keystroke) only checks the previous result instead of looking up the dictionary.
+ *
+ * <code>
+ * new KVListTextIndex(friendsModel, { FriendsEntry::firstname, FriendsEntry::surname, FriendsEntry::email });
+ * filtered->setSearchText("jo");   // KVListFilteredModel picks up the index of its source model
+ * </code>
+ *
+ * Notes:
+ * - shadowed values are not indexed
+ * - values which are not strings are converted via QVariant::toString()
+ */
+class KVLIST_EXPORT KVListTextIndex : public QObject, public KVListModelObserver
+{
+    Q_OBJECT
+
+public:
+    // the index is owned by the model
+    KVListTextIndex(KVListModel *model, const QVector<KVListEntry::Key> &keys);
+    virtual ~KVListTextIndex();
+
+    KVListModel *model() const { return model_; }
+    QVector<KVListEntry::Key> keys() const { return keys_; }
+
+    // entries matching all words of 'text'; all entries for an empty text
+    QSet<KVListEntry*> search(const QString &text);
+    // same for single entries, 'words' as returned by words()
+    bool matches(const KVListEntry *entry, const QStringList &words) const;
+
+    // normalized words of a text
+    static QStringList words(const QString &text);
+
+    // rebuild the whole index (done on model resets)
+    void rebuild();
+
+    // distinct words / indexed entries
+    int wordCount() const { return int(dictionary_.size()); }
+    int entryCount() const { return entryWords_.size(); }
+
+protected:
+    // KVListModelObserver
+    void entryInserted(KVListModel *model, int row, KVListEntry *entry) override;
+    void entryAboutToBeRemoved(KVListModel *model, int row, KVListEntry *entry) override;
+    void valueChanged(KVListModel *model, KVListEntry *entry, KVListEntry::Key key,
+                      const QVariant &oldValue, const QVariant &newValue) override;
+    void modelAboutToBeReset(KVListModel *model) override;
+    void modelReset(KVListModel *model) override;
+
+private:
+    QStringList wordsOf(const KVListEntry *entry) const;
+    void addEntry(KVListEntry *entry);
+    void removeEntry(KVListEntry *entry);
+    void updateLastResult(KVListEntry *entry);
+
+    QPointer<KVListModel> model_;
+    QVector<KVListEntry::Key> keys_;
+
+    // word -> entries containing it
+    std::map<QString, QSet<KVListEntry*>> dictionary_;
+    // entry -> its words
+    QHash<const KVListEntry*, QStringList> entryWords_;
+
+    // result of the previous query, kept up to date for refinements
+    QStringList lastWords_;
+    QSet<KVListEntry*> lastResult_;
+    bool lastValid_ = false;
+};
+
+#endif // KVLISTTEXTINDEX_H
@@ -0,0 +1,440 @@
+#include "kvlisttrace.h"
+#include "kvlistserializer.h"
+#include "kvlistserializerxml.h"
+#include <QCoreApplication>
+#include <QThread>
+#include <QDebug>
+
+using namespace KVListTrace;
+
+static const quint32 TraceMagic = 0x4B564C54; // "KVLT"
+static const quint16 TraceVersion = 1;
+static const QDataStream::Version StreamVersion = QDataStream::Qt_5_12;
+
+// records are collected in memory and written in blocks of this size
+static const int FLUSH_SIZE = 64*1024;
+
+static bool isIgnoredKey(const QByteArray &keyName)
+{
+    return keyName.endsWith("_noserialize") || keyName.endsWith("_ns");
+}
+
+QString KVListTrace::opName(Op op)
+{
+    switch(op) {
+    case Insert:         return "insert";
+    case Remove:         return "remove";
+    case Move:           return "move";
+    case Reorder:        return "reorder";
+    case SetValue:       return "setValue";
+    case SetData:        return "setData";
+    case SetShadowed:    return "setShadowed";
+    case ApplyShadowed:  return "applyShadowed";
+    case RevertShadowed: return "revertShadowed";
+    case Read:           return "read";
+    case Callbacks:      return "callbacks";
+    case Reset:          return "reset";
+    default:             return QString();
+    }
+}
+
+
+KVListTraceRecorder::KVListTraceRecorder(KVListModel *model, const QString &fileName, bool recordReads) :
+    QObject(model),
+    model_(model),
+    file_(fileName),
+    recordReads_(recordReads)
+{
+    Q_ASSERT(model);
+    buffer_.open(QIODevice::WriteOnly);
+    out_.setDevice(&buffer_);
+    out_.setVersion(StreamVersion);
+
+    if(!file_.open(QIODevice::WriteOnly)) {
+        qWarning(kvlist) << "trace: cannot open" << fileName << file_.errorString();
+        return;
+    }
+
+    if(model->recorder_)
+        qWarning(kvlist) << "trace: model is already being recorded, replacing the recorder";
+    model->recorder_ = this;
+    model->addObserver(this);
+
+    out_ << TraceMagic << TraceVersion << QString(model->metaObject()->className());
+    writeSnapshot();
+
+    clock_.start();
+}
+
+KVListTraceRecorder::~KVListTraceRecorder()
+{
+    if(model_) {
+        model_->removeObserver(this);
+        if(model_->recorder_ == this)
+            model_->recorder_ = nullptr;
+    }
+    flush();
+}
+
+void KVListTraceRecorder::flush()
+{
+    if(file_.isOpen() && buffer_.size() > 0) {
+        file_.write(buffer_.data());
+        file_.flush();
+    }
+    buffer_.buffer().clear();
+    buffer_.seek(0);
+}
+
+void KVListTraceRecorder::writeSnapshot()
+{
+    KVListSerializerXml s;
+    out_ << s.serializeToData(model_);
+}
+
+void KVListTraceRecorder::writeHead(Op op, int row)
+{
+    // time since the previous record in microseconds
+    qint64 now = clock_.isValid() ? clock_.nsecsElapsed() / 1000 : 0;
+    quint32 delta = quint32(qMin<qint64>(now - lastUs_, 0xffffffff));
+    lastUs_ = now;
+
+    out_ << quint8(op) << delta << qint32(row);
+    records_++;
+}
+
+bool KVListTraceRecorder::isRecorded(KVListEntry::Key key, const QVariant &value) const
+{
+    if(key >= KVListEntry::ShadowedKeysStartAt)
+        key -= KVListEntry::ShadowedKeysStartAt;
+    if(isIgnoredKey(model_->roleNames().value(key)))
+        return false;
+
+    // pointers (e.g. child models) cannot be replayed
+    return !(value.canConvert<QObject*>() || value.canConvert<void*>());
+}
+
+void KVListTraceRecorder::record(Op op, int row, int key, const QVariant &value)
+{
+    if(!file_.isOpen() || depth_ > 0)
+        return;
+
+    switch(op) {
+    case SetValue:
+    case SetData:
+    case SetShadowed:
+        if(!isRecorded(key, value))
+            return;
+        writeHead(op, row);
+        out_ << qint32(key) << value;
+        break;
+    case Move:
+        writeHead(op, row);
+        out_ << qint32(key);
+        break;
+    default:
+        writeHead(op, row);
+        break;
+    }
+
+    if(buffer_.size() >= FLUSH_SIZE)
+        flush();
+}
+
+void KVListTraceRecorder::beginOp(Op op, int row, int key, const QVariant &value)
+{
+    record(op, row, key, value);
+    depth_++;
+}
+
+void KVListTraceRecorder::recordRead(int row, const int *roles, int count)
+{
+    if(!file_.isOpen() || !recordReads_)
+        return;
+
+    writeHead(Read, row);
+    out_ << quint16(count);
+    for(int i=0; i<count; i++)
+        out_ << qint16(roles[i]);
+
+    if(buffer_.size() >= FLUSH_SIZE)
+        flush();
+}
+
+void KVListTraceRecorder::recordCallbacks(int row, const QVector<KVListEntry::Key> &keys)
+{
+    if(!file_.isOpen())
+        return;
+
+    writeHead(Callbacks, row);
+    out_ << quint16(keys.size());
+    for(KVListEntry::Key key : keys)
+        out_ << qint16(key);
+}
+
+void KVListTraceRecorder::entryInserted(KVListModel * /*model*/, int row, KVListEntry *entry)
+{
+    if(!file_.isOpen() || depth_ > 0)
+        return;
+
+    QVector<QPair<KVListEntry::Key, QVariant>> values;
+    for(KVListEntry::Key key : entry->keys()) {
+        QVariant value = entry->getValue(key);
+        if(isRecorded(key, value))
+            values << qMakePair(key, value);
+    }
+
+    writeHead(Insert, row);
+    out_ << QString(entry->metaObject()->className()) << qint32(values.size());
+    for(const auto &v : values)
+        out_ << qint32(v.first) << v.second;
+}
+
+void KVListTraceRecorder::entryAboutToBeRemoved(KVListModel * /*model*/, int row, KVListEntry * /*entry*/)
+{
+    record(Remove, row);
+}
+
+void KVListTraceRecorder::entryMoved(KVListModel * /*model*/, int from, int to)
+{
+    record(Move, from, to);
+}
+
+void KVListTraceRecorder::entriesReordered(KVListModel * /*model*/, const QVector<int> &order)
+{
+    if(!file_.isOpen() || depth_ > 0)
+        return;
+
+    writeHead(Reorder, -1);
+    out_ << order;
+}
+
+void KVListTraceRecorder::modelReset(KVListModel * /*model*/)
+{
+    if(!file_.isOpen() || depth_ > 0)
+        return;
+
+    // start over with a new snapshot
+    writeHead(Reset, -1);
+    writeSnapshot();
+}
+
+void KVListTraceRecorder::valueChanged(KVListModel *model, KVListEntry *entry, KVListEntry::Key key,
+                                       const QVariant & /*oldValue*/, const QVariant &newValue)
+{
+    if(!file_.isOpen() || depth_ > 0)
+        return;
+    record(SetValue, model->indexOf(entry), key, newValue);
+}
+
+
+bool KVListTracePlayer::open(const QString &fileName)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly))
+        return fail(file.errorString());
+
+    QByteArray data = file.readAll();
+    QDataStream in(data);
+    in.setVersion(StreamVersion);
+
+    quint32 magic;
+    quint16 version;
+    in >> magic >> version >> modelType_ >> snapshot_;
+    if(in.status() != QDataStream::Ok || magic != TraceMagic)
+        return fail("not a trace file");
+    if(version != TraceVersion)
+        return fail(QString("unsupported trace version %1").arg(version));
+
+    records_ = data.mid(int(in.device()->pos()));
+    return true;
+}
+
+KVListModel *KVListTracePlayer::createModel()
+{
+    KVListBase *b = KVListSerializer::createRegisteredItem(modelType_);
+    KVListModel *m = dynamic_cast<KVListModel*>(b);
+    if(!m) {
+        delete b;
+        fail("cannot create model " + modelType_);
+        return nullptr;
+    }
+
+    KVListSerializerXml s;
+    if(!s.deserializeDataToExistingModel(m, snapshot_)) {
+        delete m;
+        fail("cannot load the snapshot");
+        return nullptr;
+    }
+    return m;
+}
+
+bool KVListTracePlayer::replay(KVListModel *model, bool realTime)
+{
+    stats_ = QVector<OpStats>(OpCount);
+    recordedUs_ = 0;
+    replayNs_ = 0;
+
+    QDataStream in(records_);
+    in.setVersion(StreamVersion);
+
+    QElapsedTimer clock, opClock;
+    clock.start();
+
+    while(!in.atEnd())
+    {
+        quint8 op;
+        quint32 delta;
+        qint32 row;
+        in >> op >> delta >> row;
+        if(in.status() != QDataStream::Ok || op >= OpCount)
+            return fail("corrupt trace");
+
+        recordedUs_ += delta;
+        if(realTime) {
+            // wait for the recorded point in time; timers etc. keep running meanwhile
+            while(clock.nsecsElapsed() / 1000 < recordedUs_) {
+                QCoreApplication::processEvents(QEventLoop::AllEvents, 1);
+                qint64 left = recordedUs_ - clock.nsecsElapsed() / 1000;
+                if(left > 1000)
+                    QThread::usleep(qMin<qint64>(left - 1000, 10000));
+            }
+        }
+
+        opClock.start();
+        if(!replayRecord(in, Op(op), row, model))
+            return false;
+        qint64 ns = opClock.nsecsElapsed();
+
+        stats_[op].count++;
+        stats_[op].replayNs += ns;
+        replayNs_ += ns;
+    }
+
+    QCoreApplication::processEvents();
+    return true;
+}
+
+bool KVListTracePlayer::replayRecord(QDataStream &in, Op op, int row, KVListModel *model)
+{
+    const bool rowValid = row >= 0 && row < model->size();
+    auto mismatch = [&](){ return fail(QString("%1 of row %2 does not fit the model").arg(opName(op)).arg(row)); };
+
+    switch(op) {
+    case Insert: {
+        QString type;
+        qint32 count;
+        in >> type >> count;
+        KVListEntry::KeyValueMap values;
+        for(int i=0; i<count && in.status() == QDataStream::Ok; i++) {
+            qint32 key;
+            QVariant value;
+            in >> key >> value;
+            values.insert(key, value);
+        }
+        if(row < 0 || row > model->size())
+            return mismatch();
+        KVListBase *b = KVListSerializer::createRegisteredItem(type);
+        KVListEntry *e = dynamic_cast<KVListEntry*>(b);
+        if(!e) {
+            delete b;
+            return fail("cannot create entry " + type);
+        }
+        e->setValues(values);
+        model->insert(row, e);
+        break;
+    }
+    case Remove:
+        if(!rowValid)
+            return mismatch();
+        model->deleteAt(row);
+        break;
+    case Move: {
+        qint32 to;
+        in >> to;
+        if(!rowValid || to < 0 || to >= model->size())
+            return mismatch();
+        model->move(row, to);
+        break;
+    }
+    case Reorder: {
+        QVector<int> order;
+        in >> order;
+        if(!model->applyPermutation(order))
+            return mismatch();
+        break;
+    }
+    case SetValue:
+    case SetData:
+    case SetShadowed: {
+        qint32 key;
+        QVariant value;
+        in >> key >> value;
+        if(!rowValid)
+            return mismatch();
+        if(op == SetValue)
+            model->at(row)->setValue(key, value);
+        else if(op == SetData)
+            model->setData(model->index(row), value, key);
+        else
+            model->at(row)->setShadowedValue(key, value);
+        break;
+    }
+    case ApplyShadowed:
+    case RevertShadowed:
+        if(!rowValid)
+            return mismatch();
+        if(op == ApplyShadowed)
+            model->at(row)->applyShadowedChanges();
+        else
+            model->at(row)->revertShadowedChanges();
+        break;
+    case Read: {
+        quint16 count;
+        in >> count;
+        QVector<int> roles(count);
+        for(int i=0; i<count; i++) {
+            qint16 role;
+            in >> role;
+            roles[i] = role;
+        }
+        // reads of rows which do not exist (anymore) are fine for a view
+        if(count == 1) {
+            model->data(model->index(row), roles[0]);
+        } else {
+            QVector<QVariant> values;
+            model->multiData(model->index(row), roles, values);
+        }
+        break;
+    }
+    case Callbacks: {
+        // caused by the other operations... only counted
+        quint16 count;
+        in >> count;
+        in.skipRawData(count * int(sizeof(qint16)));
+        break;
+    }
+    case Reset: {
+        QByteArray snapshot;
+        in >> snapshot;
+        model->deleteAll();
+        KVListSerializerXml s;
+        if(!s.deserializeDataToExistingModel(model, snapshot))
+            return fail("cannot load the snapshot");
+        break;
+    }
+    default:
+        return fail("corrupt trace");
+    }
+
+    if(in.status() != QDataStream::Ok)
+        return fail("corrupt trace");
+    return true;
+}
+
+bool KVListTracePlayer::fail(const QString &error)
+{
+    errorString_ = error;
+    qWarning(kvlist) << "trace:" << error;
+    return false;
+}
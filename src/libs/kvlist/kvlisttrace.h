@@ -0,0 +1,146 @@
+#ifndef KVLISTTRACE_H
+#define KVLISTTRACE_H
+
+#include <QObject>
+#include <QPointer>
+#include <QVector>
+#include <QVariant>
+#include <QFile>
+#include <QBuffer>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include "kvlistentry.h"
+#include "kvlistmodel.h"
+#include "kvlistmodelobserver.h"
+#include "kvlist_global.h"
+
+/**
+ * @brief Recording and replay of the operations on a KVListModel
+ *
+ * KVListTraceRecorder writes a compact binary trace: a snapshot of the model (xml) followed by
+ * one record per operation with the time passed since the previous record:
+ * - mutations: insert, remove, move, reorder, set value, setData() (e.g. qml editors),
+ *   set shadowed value, apply / revert shadowed changes, model reset (with a new snapshot)
+ * - reads: data() / multiData() / rowValues()
+ * - dispatch of onValueChanged() callbacks
+ *
+ * Operations caused by a recorded operation (e.g. the value changes of applyShadowedChanges())
+ * are not recorded again, replaying the operation causes them.
+ *
+ * KVListTracePlayer rebuilds the model from the snapshot and replays the records, either as
+ * fast as possible or with the recorded timing, and measures the time spent per operation.
+ * See the 'kvlist_replay' tool.
+ *
+ * <code>
+ * new KVListTraceRecorder(friendsModel, "friends.kvlt");   // owned by the model
+ *
+ * KVListTracePlayer player;
+ * if(player.open("friends.kvlt")) {
+ *     KVListModel *m = player.createModel();
+ *     player.replay(m);
+ *     qDebug() << player.stats(KVListTrace::Read).replayNs;
+ * }
+ * </code>
+ *
+ * Notes:
+ * - only the top level model is traced; child models are part of the snapshots
+ * - like for serialization, keys ending in '_noserialize' / '_ns' and pointer values are not recorded
+ * - entry and model types are created via the serialization factory (see REGISTER_2_SERIALIZATION_FACTORY)
+ */
+namespace KVListTrace {
+    enum Op : quint8 { Insert, Remove, Move, Reorder, SetValue, SetData, SetShadowed,
+                       ApplyShadowed, RevertShadowed, Read, Callbacks, Reset, OpCount };
+    QString opName(Op op);
+}
+
+class KVLIST_EXPORT KVListTraceRecorder : public QObject, public KVListModelObserver
+{
+    Q_OBJECT
+
+public:
+    // starts recording right away; the recorder is owned by the model
+    KVListTraceRecorder(KVListModel *model, const QString &fileName, bool recordReads = true);
+    virtual ~KVListTraceRecorder();
+
+    bool isRecording() const { return file_.isOpen(); }
+    QString errorString() const { return file_.errorString(); }
+    qint64 recordCount() const { return records_; }
+
+    // write the buffered records to the file
+    void flush();
+
+    // hooks for KVListModel / KVListEntry: record an operation; beginOp() additionally
+    // suppresses everything it causes up to endOp()
+    void record(KVListTrace::Op op, int row, int key = -1, const QVariant &value = QVariant());
+    void beginOp(KVListTrace::Op op, int row, int key = -1, const QVariant &value = QVariant());
+    void endOp() { depth_--; }
+    void recordRead(int row, const int *roles, int count);
+    void recordCallbacks(int row, const QVector<KVListEntry::Key> &keys);
+
+protected:
+    // KVListModelObserver
+    void entryInserted(KVListModel *model, int row, KVListEntry *entry) override;
+    void entryAboutToBeRemoved(KVListModel *model, int row, KVListEntry *entry) override;
+    void entryMoved(KVListModel *model, int from, int to) override;
+    void entriesReordered(KVListModel *model, const QVector<int> &order) override;
+    void modelReset(KVListModel *model) override;
+    void valueChanged(KVListModel *model, KVListEntry *entry, KVListEntry::Key key,
+                      const QVariant &oldValue, const QVariant &newValue) override;
+
+private:
+    void writeHead(KVListTrace::Op op, int row);
+    void writeSnapshot();
+    bool isRecorded(KVListEntry::Key key, const QVariant &value) const;
+
+    QPointer<KVListModel> model_;
+    QFile file_;
+    QBuffer buffer_;
+    QDataStream out_;
+    QElapsedTimer clock_;
+    qint64 lastUs_ = 0;
+    qint64 records_ = 0;
+    int depth_ = 0;
+    bool recordReads_;
+};
+
+class KVLIST_EXPORT KVListTracePlayer
+{
+public:
+    struct OpStats {
+        qint64 count = 0;
+        qint64 replayNs = 0;    // time spent replaying the operations
+    };
+
+    // read the trace into memory
+    bool open(const QString &fileName);
+    QString errorString() const { return errorString_; }
+
+    // type of the traced model
+    QString modelType() const { return modelType_; }
+    // new model filled with the snapshot; nullptr on errors
+    KVListModel *createModel();
+
+    // replay all records on a model created by createModel(); with 'realTime' the recorded pauses are
+    // kept (events are processed meanwhile), otherwise events are only processed at the end.
+    // Returns false in case a record does not fit the model
+    bool replay(KVListModel *model, bool realTime = false);
+
+    OpStats stats(KVListTrace::Op op) const { return stats_.value(op); }
+    // duration of the recording / of the last replay
+    qint64 recordedUs() const { return recordedUs_; }
+    qint64 replayNs() const { return replayNs_; }
+
+private:
+    bool replayRecord(QDataStream &in, KVListTrace::Op op, int row, KVListModel *model);
+    bool fail(const QString &error);
+
+    QString modelType_;
+    QByteArray snapshot_;
+    QByteArray records_;
+    QString errorString_;
+    QVector<OpStats> stats_;
+    qint64 recordedUs_ = 0;
+    qint64 replayNs_ = 0;
+};
+
+#endif // KVLISTTRACE_H
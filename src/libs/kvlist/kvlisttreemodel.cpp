@@ -0,0 +1,492 @@
+#include "kvlisttreemodel.h"
+
+// one per expanded (child) model; indexes of the rows of 'model' point to it
+struct KVListTreeModel::Node
+{
+    KVListModel *model;
+    Node *parent;                           // nullptr for the root
+    KVListEntry *owner;                     // entry of 'parent' holding 'model'
+    mutable int ownerRow = -1;              // cached row of 'owner', verified on use
+    int fetched = 0;                        // rows visible in the tree
+    QHash<KVListEntry*, Node*> children;    // expanded rows
+    QVector<QMetaObject::Connection> connections;
+
+    // pending removal between rowsAboutToBeRemoved and rowsRemoved
+    int removeFirst = -1, removeLast = -1;
+    QVector<Node*> removedChildren;
+    bool resetting = false;
+
+    // persistent indexes of this node during layout changes
+    QModelIndexList layoutIndexes;
+    QVector<KVListEntry*> layoutEntries;
+};
+
+
+KVListTreeModel::KVListTreeModel(QObject *parent) :
+    QAbstractItemModel(parent)
+{
+}
+
+KVListTreeModel::KVListTreeModel(KVListModel *source, const QVector<KVListEntry::Key> &childKeys, QObject *parent) :
+    QAbstractItemModel(parent),
+    childKeys_(childKeys)
+{
+    setSourceModel(source);
+}
+
+KVListTreeModel::~KVListTreeModel()
+{
+    if(root_)
+        deleteNode(root_);
+}
+
+void KVListTreeModel::setSourceModel(KVListModel *model)
+{
+    if(model == source_)
+        return;
+
+    beginResetModel();
+    if(root_)
+        deleteNode(root_);
+    root_ = nullptr;
+    roleNames_.clear();
+
+    source_ = model;
+    if(model)
+        root_ = createNode(model, nullptr, nullptr);
+    endResetModel();
+
+    emit sourceModelChanged();
+}
+
+void KVListTreeModel::setChildKeys(const QVector<KVListEntry::Key> &keys)
+{
+    beginResetModel();
+    childKeys_ = keys;
+    if(root_) {
+        for(Node *n : root_->children)
+            deleteNode(n);
+        root_->children.clear();
+    }
+    roleNames_.clear();
+    endResetModel();
+}
+
+KVListEntry *KVListTreeModel::entry(const QModelIndex &index) const
+{
+    Node *n = nodeOf(index);
+    return n && index.row() < n->model->size() ? n->model->at(index.row()) : nullptr;
+}
+
+KVListModel *KVListTreeModel::model(const QModelIndex &index) const
+{
+    Node *n = nodeOf(index);
+    return n ? n->model : nullptr;
+}
+
+KVListTreeModel::Node *KVListTreeModel::nodeOf(const QModelIndex &index) const
+{
+    if(!index.isValid() || index.model() != this)
+        return nullptr;
+    return static_cast<Node*>(index.internalPointer());
+}
+
+KVListTreeModel::Node *KVListTreeModel::childNode(const QModelIndex &parent) const
+{
+    if(!parent.isValid())
+        return root_;
+
+    Node *n = nodeOf(parent);
+    if(!n || parent.column() > 0 || parent.row() >= n->model->size())
+        return nullptr;
+    return n->children.value(n->model->at(parent.row()));
+}
+
+int KVListTreeModel::ownerRow(const Node *node) const
+{
+    // rows only change on inserts / removals / moves before the owner: check the cached row first
+    KVListModel *m = node->parent->model;
+    if(node->ownerRow < 0 || node->ownerRow >= m->size() || m->at(node->ownerRow) != node->owner)
+        node->ownerRow = m->indexOf(node->owner);
+    return node->ownerRow;
+}
+
+QModelIndex KVListTreeModel::indexOfNode(const Node *node) const
+{
+    if(!node->parent)
+        return QModelIndex();
+    int row = ownerRow(node);
+    return row >= 0 ? createIndex(row, 0, node->parent) : QModelIndex();
+}
+
+bool KVListTreeModel::mayHaveChildren(const KVListEntry *entry) const
+{
+    for(KVListEntry::Key key : childKeys_) {
+        // don't create lazy child models just to draw the expand indicator
+        if(entry->isLazy(key))
+            return true;
+        if(KVListModel *m = entry->getChildModel(key))
+            return m->size() > 0;
+    }
+    return false;
+}
+
+KVListModel *KVListTreeModel::childModel(KVListEntry *entry) const
+{
+    for(KVListEntry::Key key : childKeys_) {
+        if(KVListModel *m = entry->getChildModel(key))
+            return m;
+    }
+    return nullptr;
+}
+
+KVListTreeModel::Node *KVListTreeModel::createNode(KVListModel *model, Node *parent, KVListEntry *owner)
+{
+    Node *n = new Node;
+    n->model = model;
+    n->parent = parent;
+    n->owner = owner;
+    if(parent)
+        parent->children.insert(owner, n);
+
+    // role names of new levels are added, the ones known so far win
+    if(!roleNames_.isEmpty()) {
+        const QHash<int, QByteArray> names = model->roleNames();
+        for(auto i = names.constBegin(); i != names.constEnd(); ++i) {
+            if(!roleNames_.contains(i.key()))
+                roleNames_.insert(i.key(), i.value());
+        }
+    }
+
+    connectNode(n);
+    return n;
+}
+
+void KVListTreeModel::deleteNode(Node *node)
+{
+    for(Node *c : node->children)
+        deleteNode(c);
+    for(const QMetaObject::Connection &c : node->connections)
+        disconnect(c);
+    delete node;
+}
+
+void KVListTreeModel::disconnectNode(Node *node)
+{
+    for(Node *c : node->children)
+        disconnectNode(c);
+    for(const QMetaObject::Connection &c : node->connections)
+        disconnect(c);
+    node->connections.clear();
+}
+
+void KVListTreeModel::collapse(Node *node)
+{
+    Q_ASSERT(node->parent);
+
+    // the rows go away, the node has to stay reachable until views have dropped their indexes
+    QModelIndex parent = indexOfNode(node);
+    const bool visible = parent.isValid() && node->fetched > 0;
+    if(visible)
+        beginRemoveRows(parent, 0, node->fetched - 1);
+    node->fetched = 0;
+    if(visible)
+        endRemoveRows();
+
+    node->parent->children.remove(node->owner);
+    deleteNode(node);
+}
+
+void KVListTreeModel::connectNode(Node *n)
+{
+    KVListModel *m = n->model;
+    n->connections
+        << connect(m, &QAbstractItemModel::dataChanged, this,
+                   [this, n](const QModelIndex &tl, const QModelIndex &br, const QVector<int> &roles) {
+                       sourceDataChanged(n, tl.row(), br.row(), roles); })
+        << connect(m, &QAbstractItemModel::rowsInserted, this,
+                   [this, n](const QModelIndex &, int first, int last) { sourceRowsInserted(n, first, last); })
+        << connect(m, &QAbstractItemModel::rowsAboutToBeRemoved, this,
+                   [this, n](const QModelIndex &, int first, int last) { sourceRowsAboutToBeRemoved(n, first, last); })
+        << connect(m, &QAbstractItemModel::rowsRemoved, this,
+                   [this, n]() { sourceRowsRemoved(n); })
+        << connect(m, &QAbstractItemModel::rowsAboutToBeMoved, this,
+                   [this, n]() { sourceLayoutAboutToBeChanged(n); })
+        << connect(m, &QAbstractItemModel::rowsMoved, this,
+                   [this, n]() { sourceLayoutChanged(n); })
+        << connect(m, &QAbstractItemModel::layoutAboutToBeChanged, this,
+                   [this, n]() { sourceLayoutAboutToBeChanged(n); })
+        << connect(m, &QAbstractItemModel::layoutChanged, this,
+                   [this, n]() { sourceLayoutChanged(n); })
+        << connect(m, &QAbstractItemModel::modelAboutToBeReset, this,
+                   [this, n]() { sourceAboutToBeReset(n); })
+        << connect(m, &QAbstractItemModel::modelReset, this,
+                   [this, n]() { sourceReset(n); });
+
+    // child models usually go away with their entry (handled by the removal of the row, which
+    // disconnects the branch); a model deleted while its entry is still there only takes its branch
+    if(n->parent) {
+        n->connections << connect(m, &QObject::destroyed, this, [this, n]() {
+            collapse(n);
+        });
+    } else {
+        n->connections << connect(m, &QObject::destroyed, this, [this]() {
+            beginResetModel();
+            deleteNode(root_);
+            root_ = nullptr;
+            endResetModel();
+            emit sourceModelChanged();
+        });
+    }
+}
+
+QModelIndex KVListTreeModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if(row < 0 || column != 0)
+        return QModelIndex();
+
+    Node *n = childNode(parent);
+    if(!n || row >= n->fetched)
+        return QModelIndex();
+    return createIndex(row, column, n);
+}
+
+QModelIndex KVListTreeModel::parent(const QModelIndex &child) const
+{
+    Node *n = nodeOf(child);
+    return n ? indexOfNode(n) : QModelIndex();
+}
+
+int KVListTreeModel::rowCount(const QModelIndex &parent) const
+{
+    if(parent.column() > 0)
+        return 0;
+    Node *n = childNode(parent);
+    return n ? n->fetched : 0;
+}
+
+int KVListTreeModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent)
+    return 1;
+}
+
+bool KVListTreeModel::hasChildren(const QModelIndex &parent) const
+{
+    if(!parent.isValid())
+        return root_ && root_->model->size() > 0;
+
+    if(Node *c = childNode(parent))
+        return c->model->size() > 0;
+
+    KVListEntry *e = entry(parent);
+    return e && parent.column() == 0 && mayHaveChildren(e);
+}
+
+bool KVListTreeModel::canFetchMore(const QModelIndex &parent) const
+{
+    if(Node *c = childNode(parent))
+        return c->fetched < c->model->size();
+    return parent.isValid() && hasChildren(parent);
+}
+
+void KVListTreeModel::fetchMore(const QModelIndex &parent)
+{
+    Node *n = childNode(parent);
+    if(!n) {
+        // expanding a row for the first time
+        KVListEntry *e = entry(parent);
+        KVListModel *m = e && parent.column() == 0 ? childModel(e) : nullptr;
+        if(!m)
+            return;
+        n = createNode(m, nodeOf(parent), e);
+        n->ownerRow = parent.row();
+    }
+
+    const int count = qMin(fetchBatchSize_, n->model->size() - n->fetched);
+    if(count <= 0)
+        return;
+
+    beginInsertRows(parent, n->fetched, n->fetched + count - 1);
+    n->fetched += count;
+    endInsertRows();
+}
+
+QVariant KVListTreeModel::data(const QModelIndex &index, int role) const
+{
+    Node *n = nodeOf(index);
+    if(!n || index.row() >= n->model->size())
+        return QVariant();
+    return n->model->data(n->model->index(index.row()), role);
+}
+
+bool KVListTreeModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    // the change comes back via dataChanged() of the source
+    Node *n = nodeOf(index);
+    if(!n || index.row() >= n->model->size())
+        return false;
+    return n->model->setData(n->model->index(index.row()), value, role);
+}
+
+Qt::ItemFlags KVListTreeModel::flags(const QModelIndex &index) const
+{
+    Node *n = nodeOf(index);
+    if(!n || index.row() >= n->model->size())
+        return Qt::NoItemFlags;
+    return n->model->flags(n->model->index(index.row()));
+}
+
+QHash<int, QByteArray> KVListTreeModel::roleNames() const
+{
+    if(roleNames_.isEmpty() && source_)
+        roleNames_ = source_->roleNames();
+    return roleNames_;
+}
+
+void KVListTreeModel::sourceDataChanged(Node *node, int first, int last, const QVector<int> &roles)
+{
+    // another child model set for a row: the old branch is gone
+    bool childChanged = roles.isEmpty();
+    for(int i=0; i<roles.size() && !childChanged; i++)
+        childChanged = childKeys_.contains(roles.at(i));
+    if(childChanged && !node->children.isEmpty()) {
+        for(int row = first; row <= last && row < node->model->size(); row++) {
+            KVListEntry *e = node->model->at(row);
+            Node *c = node->children.value(e);
+            if(c && childModel(e) != c->model)
+                collapse(c);
+        }
+    }
+
+    last = qMin(last, node->fetched - 1);
+    if(first <= last)
+        emit dataChanged(createIndex(first, 0, node), createIndex(last, 0, node), roles);
+}
+
+void KVListTreeModel::sourceRowsInserted(Node *node, int first, int last)
+{
+    const int count = last - first + 1;
+    const bool fullyFetched = node->fetched == node->model->size() - count;
+
+    // rows behind the fetched ones appear with the next fetchMore()
+    if(first < node->fetched || (first == node->fetched && fullyFetched)) {
+        beginInsertRows(indexOfNode(node), first, last);
+        node->fetched += count;
+        endInsertRows();
+    }
+}
+
+void KVListTreeModel::sourceRowsAboutToBeRemoved(Node *node, int first, int last)
+{
+    if(node->resetting || first >= node->fetched)
+        return;
+
+    node->removeFirst = first;
+    node->removeLast = qMin(last, node->fetched - 1);
+
+    // expanded rows: the nodes are deleted after the views have dropped their indexes; their models
+    // may go away with the entries before that
+    for(int row = first; row <= node->removeLast; row++) {
+        KVListEntry *e = node->model->at(row);
+        if(Node *c = node->children.take(e)) {
+            disconnectNode(c);
+            node->removedChildren << c;
+        }
+    }
+
+    beginRemoveRows(indexOfNode(node), node->removeFirst, node->removeLast);
+}
+
+void KVListTreeModel::sourceRowsRemoved(Node *node)
+{
+    if(node->removeFirst < 0) {
+        node->fetched = qMin(node->fetched, node->model->size());
+        return;
+    }
+
+    node->fetched -= node->removeLast - node->removeFirst + 1;
+    node->removeFirst = node->removeLast = -1;
+    endRemoveRows();
+
+    for(Node *c : node->removedChildren)
+        deleteNode(c);
+    node->removedChildren.clear();
+}
+
+void KVListTreeModel::sourceLayoutAboutToBeChanged(Node *node)
+{
+    emit layoutAboutToBeChanged();
+
+    // remember the entries of the persistent indexes of this level
+    node->layoutIndexes.clear();
+    node->layoutEntries.clear();
+    for(const QModelIndex &i : persistentIndexList()) {
+        if(i.internalPointer() == node && i.row() < node->model->size()) {
+            node->layoutIndexes << i;
+            node->layoutEntries << node->model->at(i.row());
+        }
+    }
+}
+
+void KVListTreeModel::sourceLayoutChanged(Node *node)
+{
+    QModelIndexList to;
+    to.reserve(node->layoutIndexes.size());
+    for(int i=0; i<node->layoutIndexes.size(); i++) {
+        int row = node->model->indexOf(node->layoutEntries.at(i));
+        to << (row >= 0 && row < node->fetched ? createIndex(row, node->layoutIndexes.at(i).column(), node) : QModelIndex());
+    }
+    changePersistentIndexList(node->layoutIndexes, to);
+
+    node->layoutIndexes.clear();
+    node->layoutEntries.clear();
+    emit layoutChanged();
+}
+
+void KVListTreeModel::sourceAboutToBeReset(Node *node)
+{
+    // the entries (and with them the child models) may be deleted before the reset is done
+    for(Node *c : node->children)
+        disconnectNode(c);
+
+    if(node == root_) {
+        beginResetModel();
+        return;
+    }
+
+    // a reset of a child model only affects its branch
+    node->resetting = true;
+    node->removedChildren += node->children.values().toVector();
+    node->children.clear();
+    if(node->fetched > 0) {
+        node->removeFirst = 0;
+        node->removeLast = node->fetched - 1;
+        beginRemoveRows(indexOfNode(node), 0, node->removeLast);
+    }
+}
+
+void KVListTreeModel::sourceReset(Node *node)
+{
+    if(node == root_) {
+        for(Node *c : root_->children)
+            deleteNode(c);
+        root_->children.clear();
+        root_->fetched = 0;
+        endResetModel();
+        return;
+    }
+
+    node->resetting = false;
+    if(node->removeFirst >= 0) {
+        node->fetched = 0;
+        node->removeFirst = node->removeLast = -1;
+        endRemoveRows();
+    }
+    for(Node *c : node->removedChildren)
+        deleteNode(c);
+    node->removedChildren.clear();
+
+    // the new rows are fetched again when the view asks for them
+    node->fetched = 0;
+}
@@ -0,0 +1,108 @@
+#ifndef KVLISTTREEMODEL_H
+#define KVLISTTREEMODEL_H
+
+#include <QAbstractItemModel>
+#include <QPointer>
+#include <QVector>
+#include "kvlistentry.h"
+#include "kvlistmodel.h"
+#include "kvlist_global.h"
+
+/**
+ * @brief The KVListTreeModel class
+ *
+ * Presents a KVListModel and its nested child models as one tree, e.g. for a tree view:
+ * the children of a row are the entries of the child model stored under one of 'childKeys'
+ * (the first key holding a model wins), on every level.
+ *
+ * No objects are created per row: the tree keeps one small node per expanded child model
+ * (the model, its parent node and the owning entry); indexes point to the node of their model.
+ * Rows are fetched lazily (canFetchMore() / fetchMore()) in chunks of 'fetchBatchSize', so child
+ * models, including lazily created ones, are only touched once a branch is expanded. Collapsed
+ * branches cost nothing, not even signal connections.
+ *
+ * <code>
+ * KVListTreeModel *tree = new KVListTreeModel(friendsModel, { FriendsEntry::activitiesAll });
+ * treeView->setModel(tree);
+ * </code>
+ *
+ * Notes:
+ * - role ids are passed to the model of the respective level unchanged; roleNames() is the union
+ *   of the root model's role names and the ones of the child models fetched so far (the root wins)
+ * - moves and layout changes of a model are reported as layout change of the tree
+ * - replacing a child model (setting another one for the key) collapses the branch
+ */
+class KVLIST_EXPORT KVListTreeModel : public QAbstractItemModel
+{
+    Q_OBJECT
+    Q_PROPERTY(KVListModel* sourceModel READ sourceModel WRITE setSourceModel NOTIFY sourceModelChanged)
+
+public:
+    explicit KVListTreeModel(QObject *parent = nullptr);
+    KVListTreeModel(KVListModel *source, const QVector<KVListEntry::Key> &childKeys, QObject *parent = nullptr);
+    virtual ~KVListTreeModel();
+
+    KVListModel *sourceModel() const { return source_; }
+    void setSourceModel(KVListModel *model);
+
+    QVector<KVListEntry::Key> childKeys() const { return childKeys_; }
+    void setChildKeys(const QVector<KVListEntry::Key> &keys);
+
+    int fetchBatchSize() const { return fetchBatchSize_; }
+    void setFetchBatchSize(int rows) { fetchBatchSize_ = qMax(1, rows); }
+
+    // entry / model of a row
+    Q_INVOKABLE KVListEntry *entry(const QModelIndex &index) const;
+    Q_INVOKABLE KVListModel *model(const QModelIndex &index) const;
+
+    // QAbstractItemModel impl
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    bool setData(const QModelIndex &index, const QVariant &value, int role) override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+signals:
+    void sourceModelChanged();
+
+private:
+    struct Node;
+
+    Node *nodeOf(const QModelIndex &index) const;
+    Node *childNode(const QModelIndex &parent) const;
+    QModelIndex indexOfNode(const Node *node) const;
+    int ownerRow(const Node *node) const;
+    bool mayHaveChildren(const KVListEntry *entry) const;
+    KVListModel *childModel(KVListEntry *entry) const;
+
+    Node *createNode(KVListModel *model, Node *parent, KVListEntry *owner);
+    void deleteNode(Node *node);
+    // no more signals from the models of 'node' and its descendants
+    void disconnectNode(Node *node);
+    void collapse(Node *node);
+    void connectNode(Node *node);
+
+    // source model signals
+    void sourceDataChanged(Node *node, int first, int last, const QVector<int> &roles);
+    void sourceRowsInserted(Node *node, int first, int last);
+    void sourceRowsAboutToBeRemoved(Node *node, int first, int last);
+    void sourceRowsRemoved(Node *node);
+    void sourceLayoutAboutToBeChanged(Node *node);
+    void sourceLayoutChanged(Node *node);
+    void sourceAboutToBeReset(Node *node);
+    void sourceReset(Node *node);
+
+    QPointer<KVListModel> source_;
+    QVector<KVListEntry::Key> childKeys_;
+    Node *root_ = nullptr;
+    int fetchBatchSize_ = 256;
+    mutable QHash<int, QByteArray> roleNames_;
+};
+
+#endif // KVLISTTREEMODEL_H
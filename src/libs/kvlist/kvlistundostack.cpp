@@ -0,0 +1,320 @@
+#include "kvlistundostack.h"
+#include "kvlistserializer.h"
+#include <QStringList>
+#include <QTimer>
+#include <QDebug>
+
+KVListUndoStack::KVListUndoStack(KVListModel *model, qint64 byteBudget) :
+    QObject(model),
+    model_(model),
+    byteBudget_(byteBudget)
+{
+    Q_ASSERT(model);
+    model->addObserver(this);
+}
+
+KVListUndoStack::~KVListUndoStack()
+{
+    if(model_)
+        model_->removeObserver(this);
+}
+
+void KVListUndoStack::beginTransaction()
+{
+    transactionDepth_++;
+}
+
+void KVListUndoStack::endTransaction()
+{
+    Q_ASSERT(transactionDepth_ > 0);
+    if(--transactionDepth_ == 0)
+        commit();
+}
+
+bool KVListUndoStack::undo()
+{
+    commit();
+    if(undo_.isEmpty() || !model_)
+        return false;
+
+    Transaction t = undo_.takeLast();
+    replay(t, true);
+    redo_ << t;
+
+    emit changed();
+    return true;
+}
+
+bool KVListUndoStack::redo()
+{
+    commit();
+    if(redo_.isEmpty() || !model_)
+        return false;
+
+    Transaction t = redo_.takeLast();
+    replay(t, false);
+    undo_ << t;
+
+    emit changed();
+    return true;
+}
+
+void KVListUndoStack::clear()
+{
+    if(replaying_)
+        return;
+
+    undo_.clear();
+    redo_.clear();
+    current_ = Transaction();
+    bytesUsed_ = 0;
+    emit changed();
+}
+
+void KVListUndoStack::setByteBudget(qint64 budget)
+{
+    if(byteBudget_ == budget)
+        return;
+    byteBudget_ = budget;
+    enforceBudget();
+    emit changed();
+}
+
+qint64 KVListUndoStack::estimateSize(const QVariant &value)
+{
+    qint64 size = sizeof(QVariant);
+    switch(value.userType()) {
+    case QMetaType::QString:
+        size += value.toString().size() * qint64(sizeof(QChar));
+        break;
+    case QMetaType::QByteArray:
+        size += value.toByteArray().size();
+        break;
+    case QMetaType::QStringList:
+        for(const QString &s : value.toStringList())
+            size += sizeof(QString) + s.size() * qint64(sizeof(QChar));
+        break;
+    case QMetaType::QVariantList:
+        for(const QVariant &v : value.toList())
+            size += estimateSize(v);
+        break;
+    case QMetaType::QVariantMap: {
+        QVariantMap map = value.toMap();
+        for(auto i = map.constBegin(); i != map.constEnd(); ++i)
+            size += sizeof(QString) + i.key().size() * qint64(sizeof(QChar)) + estimateSize(i.value());
+        break;
+    }
+    default:
+        break;
+    }
+    return size;
+}
+
+void KVListUndoStack::entryInserted(KVListModel *model, int row, KVListEntry *entry)
+{
+    Q_UNUSED(model);
+    Delta d;
+    d.type = Delta::Insert;
+    d.row = row;
+    d.entryType = entry->metaObject()->className();
+    d.values = snapshot(entry);
+    record(d);
+}
+
+void KVListUndoStack::entryAboutToBeRemoved(KVListModel *model, int row, KVListEntry *entry)
+{
+    Q_UNUSED(model);
+    Delta d;
+    d.type = Delta::Remove;
+    d.row = row;
+    d.entryType = entry->metaObject()->className();
+    d.values = snapshot(entry);
+    record(d);
+}
+
+void KVListUndoStack::entryMoved(KVListModel *model, int from, int to)
+{
+    Q_UNUSED(model);
+    Delta d;
+    d.type = Delta::Move;
+    d.row = from;
+    d.to = to;
+    record(d);
+}
+
+void KVListUndoStack::entriesReordered(KVListModel *model, const QVector<int> &order)
+{
+    Q_UNUSED(model);
+    Delta d;
+    d.type = Delta::Reorder;
+    d.order = order;
+    record(d);
+}
+
+void KVListUndoStack::modelReset(KVListModel *model)
+{
+    Q_UNUSED(model);
+    // rows recorded so far are meaningless after a reset
+    clear();
+}
+
+void KVListUndoStack::valueChanged(KVListModel *model, KVListEntry *entry, KVListEntry::Key key, const QVariant &oldValue, const QVariant &newValue)
+{
+    // pointers (e.g. child models) are part of the structure, not of the data
+    if(oldValue.canConvert<QObject*>() || newValue.canConvert<QObject*>())
+        return;
+
+    Delta d;
+    d.type = Delta::SetValue;
+    d.row = model->indexOf(entry);
+    d.key = key;
+    d.oldValue = oldValue;
+    d.newValue = newValue;
+    if(d.row >= 0)
+        record(d);
+}
+
+void KVListUndoStack::record(Delta delta)
+{
+    if(replaying_)
+        return;
+
+    // a new change invalidates everything that could have been redone
+    if(!redo_.isEmpty()) {
+        for(const Transaction &t : redo_)
+            bytesUsed_ -= t.bytes;
+        redo_.clear();
+    }
+
+    // without explicit transaction all changes of this event loop iteration form one step
+    if(transactionDepth_ == 0 && !commitScheduled_) {
+        commitScheduled_ = true;
+        QTimer::singleShot(0, this, [this](){
+            commitScheduled_ = false;
+            if(transactionDepth_ == 0)
+                commit();
+        });
+    }
+
+    // merge consecutive changes of the same value
+    if(delta.type == Delta::SetValue && !current_.deltas.isEmpty()) {
+        Delta &last = current_.deltas.last();
+        if(last.type == Delta::SetValue && last.row == delta.row && last.key == delta.key) {
+            current_.bytes -= last.bytes;
+            last.newValue = delta.newValue;
+            last.bytes = estimateSize(last);
+            current_.bytes += last.bytes;
+            return;
+        }
+    }
+
+    delta.bytes = estimateSize(delta);
+    current_.bytes += delta.bytes;
+    current_.deltas << delta;
+}
+
+void KVListUndoStack::commit()
+{
+    if(current_.deltas.isEmpty())
+        return;
+
+    bytesUsed_ += current_.bytes;
+    undo_ << current_;
+    current_ = Transaction();
+    enforceBudget();
+    emit changed();
+}
+
+void KVListUndoStack::replay(const Transaction &t, bool backwards)
+{
+    replaying_ = true;
+    model_->beginUpdateBatch();
+
+    for(int n=0; n<t.deltas.size(); n++) {
+        const Delta &d = t.deltas[backwards ? t.deltas.size()-1-n : n];
+
+        switch(d.type) {
+        case Delta::SetValue:
+            if(d.row >= 0 && d.row < model_->size())
+                model_->at(d.row)->setValue(d.key, backwards ? d.oldValue : d.newValue);
+            break;
+        case Delta::Insert:
+            if(backwards)
+                model_->deleteAt(d.row);
+            else
+                insertEntry(d);
+            break;
+        case Delta::Remove:
+            if(backwards)
+                insertEntry(d);
+            else
+                model_->deleteAt(d.row);
+            break;
+        case Delta::Move:
+            if(backwards)
+                model_->move(d.to, d.row);
+            else
+                model_->move(d.row, d.to);
+            break;
+        case Delta::Reorder:
+            if(backwards) {
+                QVector<int> inverse(d.order.size());
+                for(int row=0; row<d.order.size(); row++)
+                    inverse[d.order[row]] = row;
+                model_->applyPermutation(inverse);
+            }
+            else
+                model_->applyPermutation(d.order);
+            break;
+        }
+    }
+
+    model_->endUpdateBatch();
+    replaying_ = false;
+}
+
+void KVListUndoStack::insertEntry(const Delta &delta)
+{
+    KVListBase *b = KVListSerializer::createRegisteredItem(delta.entryType);
+    KVListEntry *e = dynamic_cast<KVListEntry*>(b);
+    if(!e) {
+        qWarning(kvlist) << "undo: cannot re-create entry of type" << delta.entryType;
+        delete b;
+        return;
+    }
+    e->setValues(delta.values);
+    model_->insert(delta.row, e);
+}
+
+void KVListUndoStack::enforceBudget()
+{
+    // drop the oldest steps first; redo steps are further away than any undo step
+    while(bytesUsed_ > byteBudget_ && !redo_.isEmpty())
+        bytesUsed_ -= redo_.takeFirst().bytes;
+    while(bytesUsed_ > byteBudget_ && !undo_.isEmpty())
+        bytesUsed_ -= undo_.takeFirst().bytes;
+}
+
+KVListEntry::KeyValueMap KVListUndoStack::snapshot(const KVListEntry *entry)
+{
+    KVListEntry::KeyValueMap values;
+    for(KVListEntry::Key key : entry->keys()) {
+        QVariant v = entry->getValue(key);
+        if(!v.canConvert<QObject*>())
+            values.insert(key, v);
+    }
+    return values;
+}
+
+qint64 KVListUndoStack::estimateSize(const Delta &delta)
+{
+    // map nodes carry roughly three pointers of overhead
+    static const qint64 mapNodeOverhead = 3 * sizeof(void*);
+
+    qint64 size = sizeof(Delta) + estimateSize(delta.oldValue) + estimateSize(delta.newValue);
+    size += delta.entryType.size() * qint64(sizeof(QChar));
+    size += delta.order.size() * qint64(sizeof(int));
+    for(auto i = delta.values.constBegin(); i != delta.values.constEnd(); ++i)
+        size += mapNodeOverhead + sizeof(KVListEntry::Key) + estimateSize(i.value());
+    return size;
+}
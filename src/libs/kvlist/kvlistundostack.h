@@ -0,0 +1,123 @@
+#ifndef KVLISTUNDOSTACK_H
+#define KVLISTUNDOSTACK_H
+
+#include <QObject>
+#include <QList>
+#include <QPointer>
+#include <QVector>
+#include <QVariant>
+#include "kvlistentry.h"
+#include "kvlistmodel.h"
+#include "kvlistmodelobserver.h"
+#include "kvlist_global.h"
+
+/**
+ * @brief The KVListUndoStack class
+ *
+ * Undo/redo history for a KVListModel. Instead of snapshots it records compact deltas
+ * (row, key, old value, new value and insert/remove/move/reorder operations) via KVListModelObserver.
+ *
+ * All changes made within one event loop iteration form one undo step. Use beginTransaction() /
+ * endTransaction() to group changes explicitly. Consecutive changes of the same value within a
+ * step are merged. The history is capped by 'byteBudget' (estimated bytes); the oldest steps are
+ * dropped first.
+ *
+ * <code>
+ * KVListUndoStack *undo = new KVListUndoStack(addressbook);
+ * undo->beginTransaction();
+ * addressbook->at(0)->setValue(Person::age, 31);
+ * addressbook->deleteAt(1);
+ * undo->endTransaction();
+ *
+ * undo->undo(); // age is 30 again and the deleted person is back
+ * </code>
+ *
+ * Notes:
+ * - the stack is owned by the model
+ * - removed entries are re-created via the serialization factory (see REGISTER_2_SERIALIZATION_FACTORY)
+ *   from their stored values; values holding pointers (e.g. child models) are not restored
+ * - a model reset clears the history
+ */
+class KVLIST_EXPORT KVListUndoStack : public QObject, public KVListModelObserver
+{
+    Q_OBJECT
+    Q_PROPERTY(bool canUndo READ canUndo NOTIFY changed)
+    Q_PROPERTY(bool canRedo READ canRedo NOTIFY changed)
+    Q_PROPERTY(qint64 bytesUsed READ bytesUsed NOTIFY changed)
+    Q_PROPERTY(qint64 byteBudget READ byteBudget WRITE setByteBudget NOTIFY changed)
+
+public:
+    explicit KVListUndoStack(KVListModel *model, qint64 byteBudget = 1024*1024);
+    virtual ~KVListUndoStack();
+
+    KVListModel *model() const { return model_; }
+
+    // group all following changes into one undo step; calls can be nested
+    Q_INVOKABLE void beginTransaction();
+    Q_INVOKABLE void endTransaction();
+
+    // undo / redo one step; returns false in case there is nothing to do
+    Q_INVOKABLE bool undo();
+    Q_INVOKABLE bool redo();
+    Q_INVOKABLE void clear();
+
+    bool canUndo() const { return !undo_.isEmpty() || !current_.deltas.isEmpty(); }
+    bool canRedo() const { return !redo_.isEmpty(); }
+
+    qint64 bytesUsed() const { return bytesUsed_ + current_.bytes; }
+    qint64 byteBudget() const { return byteBudget_; }
+    void setByteBudget(qint64 budget);
+
+    // rough estimation of the memory a value occupies
+    static qint64 estimateSize(const QVariant &value);
+
+signals:
+    void changed();
+
+protected:
+    // KVListModelObserver
+    void entryInserted(KVListModel *model, int row, KVListEntry *entry) override;
+    void entryAboutToBeRemoved(KVListModel *model, int row, KVListEntry *entry) override;
+    void entryMoved(KVListModel *model, int from, int to) override;
+    void entriesReordered(KVListModel *model, const QVector<int> &order) override;
+    void modelReset(KVListModel *model) override;
+    void valueChanged(KVListModel *model, KVListEntry *entry, KVListEntry::Key key,
+                      const QVariant &oldValue, const QVariant &newValue) override;
+
+private:
+    struct Delta {
+        enum Type { SetValue, Insert, Remove, Move, Reorder };
+        Type type = SetValue;
+        int row = -1;
+        int to = -1;                        // Move only
+        KVListEntry::Key key = -1;          // SetValue only
+        QVariant oldValue, newValue;        // SetValue only
+        QString entryType;                  // Insert/Remove: class to re-create the entry
+        KVListEntry::KeyValueMap values;    // Insert/Remove: values of the entry
+        QVector<int> order;                 // Reorder only
+        qint64 bytes = 0;
+    };
+    struct Transaction {
+        QVector<Delta> deltas;
+        qint64 bytes = 0;
+    };
+
+    void record(Delta delta);
+    void commit();
+    void replay(const Transaction &t, bool backwards);
+    void insertEntry(const Delta &delta);
+    void enforceBudget();
+    static KVListEntry::KeyValueMap snapshot(const KVListEntry *entry);
+    static qint64 estimateSize(const Delta &delta);
+
+    QPointer<KVListModel> model_;
+    QList<Transaction> undo_, redo_;
+    Transaction current_;
+    int transactionDepth_ = 0;
+    bool commitScheduled_ = false;
+    bool replaying_ = false;
+    qint64 byteBudget_;
+    qint64 bytesUsed_ = 0;
+};
+
+#endif // KVLISTUNDOSTACK_H
@@ -0,0 +1,245 @@
+#include "kvlistwindowmodel.h"
+
+
+KVListWindowModel::KVListWindowModel(QObject *parent) :
+    QAbstractListModel(parent)
+{
+    connect(this, &QAbstractItemModel::rowsInserted, this, &KVListWindowModel::countChanged);
+    connect(this, &QAbstractItemModel::rowsRemoved, this, &KVListWindowModel::countChanged);
+    connect(this, &QAbstractItemModel::modelReset, this, &KVListWindowModel::countChanged);
+}
+
+KVListWindowModel::KVListWindowModel(KVListModel *source, int offset, int limit, QObject *parent) :
+    KVListWindowModel(parent)
+{
+    offset_ = qMax(0, offset);
+    limit_ = qMax(0, limit);
+    setSourceModel(source);
+}
+
+void KVListWindowModel::setSourceModel(KVListModel *model)
+{
+    if(model == source_)
+        return;
+
+    beginResetModel();
+    if(source_)
+        disconnect(source_, nullptr, this, nullptr);
+
+    source_ = model;
+    if(source_) {
+        connect(source_, &QAbstractItemModel::dataChanged, this,
+                [this](const QModelIndex &tl, const QModelIndex &br, const QVector<int> &roles) {
+                    sourceDataChanged(tl.row(), br.row(), roles); });
+        connect(source_, &QAbstractItemModel::rowsInserted, this,
+                [this](const QModelIndex &, int first, int last) { sourceRowsInserted(first, last); });
+        connect(source_, &QAbstractItemModel::rowsAboutToBeRemoved, this,
+                [this](const QModelIndex &, int first, int last) { sourceRowsAboutToBeRemoved(first, last); });
+        connect(source_, &QAbstractItemModel::rowsRemoved, this, &KVListWindowModel::sourceRowsRemoved);
+        connect(source_, &QAbstractItemModel::rowsAboutToBeMoved, this, &KVListWindowModel::sourceLayoutAboutToBeChanged);
+        connect(source_, &QAbstractItemModel::rowsMoved, this, &KVListWindowModel::sourceLayoutChanged);
+        connect(source_, &QAbstractItemModel::layoutAboutToBeChanged, this, &KVListWindowModel::sourceLayoutAboutToBeChanged);
+        connect(source_, &QAbstractItemModel::layoutChanged, this, &KVListWindowModel::sourceLayoutChanged);
+        connect(source_, &QAbstractItemModel::modelAboutToBeReset, this, &KVListWindowModel::beginResetModel);
+        connect(source_, &QAbstractItemModel::modelReset, this, [this]() {
+            rows_ = targetRows();
+            endResetModel();
+        });
+        connect(source_, &QObject::destroyed, this, [this]() {
+            beginResetModel();
+            rows_ = 0;
+            endResetModel();
+            emit sourceModelChanged();
+        });
+    }
+    rows_ = targetRows();
+    endResetModel();
+
+    emit sourceModelChanged();
+}
+
+void KVListWindowModel::setOffset(int offset)
+{
+    offset = qMax(0, offset);
+    if(offset == offset_)
+        return;
+
+    // rows which stay visible are shifted instead of resetting the whole window
+    const int delta = offset - offset_;
+    if(delta > 0) {
+        // scrolling down: rows leave at the top
+        const int leaving = qMin(delta, rows_);
+        if(leaving > 0)
+            beginRemoveRows(QModelIndex(), 0, leaving - 1);
+        offset_ = offset;
+        rows_ -= leaving;
+        if(leaving > 0)
+            endRemoveRows();
+    } else if(rows_ > 0 && -delta < limit_) {
+        // scrolling up: rows enter at the top; the ones pushed out are dropped by refill()
+        const int entering = -delta;
+        beginInsertRows(QModelIndex(), 0, entering - 1);
+        offset_ = offset;
+        rows_ += entering;
+        endInsertRows();
+    } else {
+        // no overlap
+        if(rows_ > 0) {
+            beginRemoveRows(QModelIndex(), 0, rows_ - 1);
+            rows_ = 0;
+            endRemoveRows();
+        }
+        offset_ = offset;
+    }
+    refill();
+
+    emit offsetChanged();
+}
+
+void KVListWindowModel::setLimit(int limit)
+{
+    limit = qMax(0, limit);
+    if(limit == limit_)
+        return;
+
+    limit_ = limit;
+    refill();
+    emit limitChanged();
+}
+
+int KVListWindowModel::targetRows() const
+{
+    return source_ ? qBound(0, source_->size() - offset_, limit_) : 0;
+}
+
+void KVListWindowModel::refill()
+{
+    const int target = targetRows();
+    if(target > rows_) {
+        beginInsertRows(QModelIndex(), rows_, target - 1);
+        rows_ = target;
+        endInsertRows();
+    } else if(target < rows_) {
+        beginRemoveRows(QModelIndex(), target, rows_ - 1);
+        rows_ = target;
+        endRemoveRows();
+    }
+}
+
+int KVListWindowModel::mapFromSource(int sourceRow) const
+{
+    const int row = sourceRow - offset_;
+    return row >= 0 && row < rows_ ? row : -1;
+}
+
+KVListEntry *KVListWindowModel::at(int row) const
+{
+    return source_ && row >= 0 && row < rows_ ? source_->at(offset_ + row) : nullptr;
+}
+
+int KVListWindowModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : rows_;
+}
+
+QVariant KVListWindowModel::data(const QModelIndex &index, int role) const
+{
+    if(!source_ || !index.isValid() || index.row() >= rows_)
+        return QVariant();
+    return source_->data(source_->index(offset_ + index.row()), role);
+}
+
+bool KVListWindowModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    // the change comes back via dataChanged() of the source
+    if(!source_ || !index.isValid() || index.row() >= rows_)
+        return false;
+    return source_->setData(source_->index(offset_ + index.row()), value, role);
+}
+
+Qt::ItemFlags KVListWindowModel::flags(const QModelIndex &index) const
+{
+    if(!source_ || !index.isValid() || index.row() >= rows_)
+        return Qt::NoItemFlags;
+    return source_->flags(source_->index(offset_ + index.row()));
+}
+
+QHash<int, QByteArray> KVListWindowModel::roleNames() const
+{
+    return source_ ? source_->roleNames() : QHash<int, QByteArray>();
+}
+
+void KVListWindowModel::sourceDataChanged(int first, int last, const QVector<int> &roles)
+{
+    first = qMax(first - offset_, 0);
+    last = qMin(last - offset_, rows_ - 1);
+    if(first <= last)
+        emit dataChanged(index(first), index(last), roles);
+}
+
+void KVListWindowModel::sourceRowsInserted(int first, int last)
+{
+    // rows in front of the window push the window's rows down: they enter at the top
+    const int row = qMax(first - offset_, 0);
+    if(row >= limit_ || row > rows_)
+        return;
+
+    // (the window may also start behind the end of the source)
+    const int count = qMin(qMin(last - first + 1, limit_ - row), source_->size() - offset_ - rows_);
+    if(count <= 0)
+        return;
+
+    beginInsertRows(QModelIndex(), row, row + count - 1);
+    rows_ += count;
+    endInsertRows();
+
+    // the ones pushed out at the bottom
+    refill();
+}
+
+void KVListWindowModel::sourceRowsAboutToBeRemoved(int first, int last)
+{
+    // rows removed in front of the window pull the window's rows up: they leave at the top
+    const int row = qMax(first - offset_, 0);
+    removeCount_ = row < rows_ ? qMin(last - first + 1, rows_ - row) : 0;
+    if(removeCount_ > 0)
+        beginRemoveRows(QModelIndex(), row, row + removeCount_ - 1);
+}
+
+void KVListWindowModel::sourceRowsRemoved()
+{
+    if(removeCount_ > 0) {
+        rows_ -= removeCount_;
+        removeCount_ = 0;
+        endRemoveRows();
+    }
+
+    // rows following the window move up into it
+    refill();
+}
+
+void KVListWindowModel::sourceLayoutAboutToBeChanged()
+{
+    emit layoutAboutToBeChanged();
+
+    layoutIndexes_ = persistentIndexList();
+    layoutEntries_.clear();
+    layoutEntries_.reserve(layoutIndexes_.size());
+    for(const QModelIndex &i : layoutIndexes_)
+        layoutEntries_ << at(i.row());
+}
+
+void KVListWindowModel::sourceLayoutChanged()
+{
+    QModelIndexList to;
+    to.reserve(layoutIndexes_.size());
+    for(KVListEntry *e : layoutEntries_) {
+        int row = e ? mapFromSource(source_->indexOf(e)) : -1;
+        to << (row >= 0 ? index(row) : QModelIndex());
+    }
+    changePersistentIndexList(layoutIndexes_, to);
+
+    layoutIndexes_.clear();
+    layoutEntries_.clear();
+    emit layoutChanged();
+}
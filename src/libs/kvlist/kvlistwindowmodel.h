@@ -0,0 +1,98 @@
+#ifndef KVLISTWINDOWMODEL_H
+#define KVLISTWINDOWMODEL_H
+
+#include <QAbstractListModel>
+#include <QPointer>
+#include "kvlistentry.h"
+#include "kvlistmodel.h"
+#include "kvlist_global.h"
+
+/**
+ * @brief The KVListWindowModel class
+ *
+ * Shows the rows [offset, offset + limit) of a KVListModel, e.g. for dashboards or exports which
+ * only need a part of a large model.
+ *
+ * Rows are mapped by adding the offset (O(1), no mapping tables). Changes of the source are only
+ * forwarded if they touch the window: rows inserted / removed in front of the window shift it, which
+ * is reported as rows entering at the top and leaving at the bottom (or the other way round).
+ * Changing the offset is reported the same way, so the rows which stay visible keep their
+ * (persistent) indexes and delegates instead of a reset.
+ *
+ * From QML (after qmlRegisterType<KVListWindowModel>()):
+ * <code>
+ * KVListWindowModel { id: page; sourceModel: FriendsModel; offset: pageNo * 100; limit: 100 }
+ * </code>
+ *
+ * Notes:
+ * - moves and layout changes of the source are reported as layout change of the window
+ */
+class KVLIST_EXPORT KVListWindowModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(KVListModel* sourceModel READ sourceModel WRITE setSourceModel NOTIFY sourceModelChanged)
+    Q_PROPERTY(int offset READ offset WRITE setOffset NOTIFY offsetChanged)
+    Q_PROPERTY(int limit READ limit WRITE setLimit NOTIFY limitChanged)
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+
+public:
+    explicit KVListWindowModel(QObject *parent = nullptr);
+    KVListWindowModel(KVListModel *source, int offset, int limit, QObject *parent = nullptr);
+
+    KVListModel *sourceModel() const { return source_; }
+    void setSourceModel(KVListModel *model);
+
+    int offset() const { return offset_; }
+    void setOffset(int offset);
+    int limit() const { return limit_; }
+    void setLimit(int limit);
+
+    // rows currently in the window (<= limit)
+    int count() const { return rows_; }
+
+    int mapToSource(int row) const { return row + offset_; }
+    // -1 if the source row is outside of the window
+    int mapFromSource(int sourceRow) const;
+
+    Q_INVOKABLE KVListEntry *at(int row) const;
+
+    // QAbstractListModel impl
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    bool setData(const QModelIndex &index, const QVariant &value, int role) override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+signals:
+    void sourceModelChanged();
+    void offsetChanged();
+    void limitChanged();
+    void countChanged();
+
+private:
+    // rows the window should have for the current source / offset / limit
+    int targetRows() const;
+    // add / drop rows at the bottom to reach targetRows()
+    void refill();
+
+    void sourceDataChanged(int first, int last, const QVector<int> &roles);
+    void sourceRowsInserted(int first, int last);
+    void sourceRowsAboutToBeRemoved(int first, int last);
+    void sourceRowsRemoved();
+    void sourceLayoutAboutToBeChanged();
+    void sourceLayoutChanged();
+
+    QPointer<KVListModel> source_;
+    int offset_ = 0;
+    int limit_ = 100;
+    int rows_ = 0;
+
+    // pending removal between rowsAboutToBeRemoved and rowsRemoved
+    int removeCount_ = 0;
+
+    // persistent indexes during layout changes of the source
+    QModelIndexList layoutIndexes_;
+    QVector<KVListEntry*> layoutEntries_;
+};
+
+#endif // KVLISTWINDOWMODEL_H
@@ -0,0 +1,45 @@
+#ifndef KVLISTTESTTYPES_H
+#define KVLISTTESTTYPES_H
+
+#include "kvlistentry.h"
+#include "kvlistmodel.h"
+#include "kvlistserializer.h"
+
+// minimal entry / model types shared by the tests
+class ContactEntry : public KVListEntry
+{
+    Q_OBJECT
+
+public:
+    enum EnKey { name, email, age, lastseen, children, display_ns };
+    Q_ENUM(EnKey)
+
+    explicit ContactEntry(QObject *parent = nullptr) : KVListEntry(parent) {}
+
+    static ContactEntry *create(const QString &n, const QString &mail, int a = 0) {
+        ContactEntry *e = new ContactEntry();
+        e->setValues({ {name, n}, {email, mail}, {age, a} });
+        return e;
+    }
+};
+
+class ContactModel : public KVListModel
+{
+    Q_OBJECT
+
+public:
+    explicit ContactModel(QObject *parent = nullptr) : KVListModel(QMetaEnum::fromType<ContactEntry::EnKey>(), parent) {}
+};
+
+inline void registerContactTypes()
+{
+    static bool registered = false;
+    if(registered)
+        return;
+    registered = true;
+
+    REGISTER_2_SERIALIZATION_FACTORY(ContactModel);
+    REGISTER_2_SERIALIZATION_FACTORY(ContactEntry);
+}
+
+#endif // KVLISTTESTTYPES_H
@@ -0,0 +1,190 @@
+#include <QtTest>
+#include <functional>
+#include "kvlistfilterexpression.h"
+#include "kvlistfilteredmodel.h"
+#include "kvlisttesttypes.h"
+
+typedef KVListFilterExpression F;
+typedef std::function<bool (const KVListEntry *e)> Predicate;
+
+// more than one block, so that blocks are evaluated in parallel
+static const int ROWS = 10000;
+
+class tst_KVListFilterExpression : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void evaluate_data();
+    void evaluate();
+    void fromVariant();
+    void fromVariantErrors();
+    void filteredModel();
+
+private:
+    // compares the plan of 'expression' (batch and single entry) with 'expected'
+    void check(const F &expression, const Predicate &expected);
+
+    ContactModel *model_ = nullptr;
+    QDateTime now_;
+};
+
+Q_DECLARE_METATYPE(KVListFilterExpression)
+Q_DECLARE_METATYPE(Predicate)
+
+void tst_KVListFilterExpression::initTestCase()
+{
+    registerContactTypes();
+
+    now_ = QDateTime::currentDateTime();
+    model_ = new ContactModel();
+    QVector<KVListEntry*> entries;
+    for(int i=0; i<ROWS; i++) {
+        // seen i hours ago, every 7th without email
+        ContactEntry *e = new ContactEntry();
+        e->setValues({ {ContactEntry::name, QString("%1 %2").arg(i % 3 ? "Jo" : "Anna").arg(i)},
+                       {ContactEntry::age, i % 100},
+                       {ContactEntry::lastseen, now_.addSecs(-3600 * i)} });
+        if(i % 7)
+            e->setValue(ContactEntry::email, QString("user%1@example.com").arg(i));
+        entries << e;
+    }
+    model_->appendEntries(entries);
+}
+
+void tst_KVListFilterExpression::cleanupTestCase()
+{
+    delete model_;
+}
+
+static int age(const KVListEntry *e) { return e->getValue(ContactEntry::age).toInt(); }
+static QString name(const KVListEntry *e) { return e->getValue(ContactEntry::name).toString(); }
+static bool hasEmail(const KVListEntry *e) { return e->getValue(ContactEntry::email).isValid(); }
+
+void tst_KVListFilterExpression::evaluate_data()
+{
+    QTest::addColumn<KVListFilterExpression>("expression");
+    QTest::addColumn<Predicate>("expected");
+
+    QTest::newRow("null") << F() << Predicate([](const KVListEntry *) { return true; });
+    QTest::newRow("equal") << F::equals(ContactEntry::age, 42) << Predicate([](const KVListEntry *e) { return age(e) == 42; });
+    QTest::newRow("less") << F::compare(ContactEntry::age, F::Less, 10) << Predicate([](const KVListEntry *e) { return age(e) < 10; });
+    QTest::newRow("between") << F::between(ContactEntry::age, 20, 29)
+                             << Predicate([](const KVListEntry *e) { return age(e) >= 20 && age(e) <= 29; });
+    QTest::newRow("startsWith") << F::startsWith(ContactEntry::name, "jo")
+                                << Predicate([](const KVListEntry *e) { return name(e).startsWith("Jo"); });
+    QTest::newRow("startsWith case sensitive") << F::startsWith(ContactEntry::name, "jo", Qt::CaseSensitive)
+                                               << Predicate([](const KVListEntry *) { return false; });
+    QTest::newRow("contains") << F::contains(ContactEntry::name, "99")
+                              << Predicate([](const KVListEntry *e) { return name(e).contains("99"); });
+    QTest::newRow("isNull") << F::isNull(ContactEntry::email) << Predicate([](const KVListEntry *e) { return !hasEmail(e); });
+    QTest::newRow("isNotNull") << F::isNotNull(ContactEntry::email) << Predicate(hasEmail);
+    QTest::newRow("in") << F::in(ContactEntry::age, { 1, 2, 3 })
+                        << Predicate([](const KVListEntry *e) { return age(e) >= 1 && age(e) <= 3; });
+    QTest::newRow("not") << !F::startsWith(ContactEntry::name, "Anna")
+                         << Predicate([](const KVListEntry *e) { return !name(e).startsWith("Anna"); });
+    QTest::newRow("and / or")
+            << (F::compare(ContactEntry::age, F::GreaterEqual, 50) && (F::startsWith(ContactEntry::name, "Anna") || F::isNull(ContactEntry::email)))
+            << Predicate([](const KVListEntry *e) { return age(e) >= 50 && (name(e).startsWith("Anna") || !hasEmail(e)); });
+
+    // seen within the last week: the i-th entry was seen i hours ago
+    QTest::newRow("date window") << F::compareToNow(ContactEntry::lastseen, F::Greater, -7*24*3600)
+                                 << Predicate([](const KVListEntry *e) {
+                                        return e->getValue(ContactEntry::name).toString().section(' ', 1).toInt() < 7*24; });
+}
+
+void tst_KVListFilterExpression::check(const F &expression, const Predicate &expected)
+{
+    KVListFilterPlan plan(expression);
+    const QVector<KVListEntry*> entries(model_->begin(), model_->end());
+    const QVector<char> result = plan.evaluate(entries);
+    QCOMPARE(result.size(), entries.size());
+
+    for(int i=0; i<entries.size(); i++) {
+        const bool exp = expected(entries[i]);
+        if((result[i] != 0) != exp || plan.matches(entries[i]) != exp)
+            QFAIL(qPrintable(QString("row %1: %2 expected").arg(i).arg(exp)));
+    }
+}
+
+void tst_KVListFilterExpression::evaluate()
+{
+    QFETCH(KVListFilterExpression, expression);
+    QFETCH(Predicate, expected);
+    check(expression, expected);
+}
+
+void tst_KVListFilterExpression::fromVariant()
+{
+    // the qml form of the "and / or" and "date window" rows
+    const QVariantMap map {
+        { "and", QVariantList {
+              QVariantMap { { "key", "age" }, { "op", ">=" }, { "value", 50 } },
+              QVariantMap { { "or", QVariantList {
+                    QVariantMap { { "key", "name" }, { "op", "startsWith" }, { "value", "Anna" } },
+                    QVariantMap { { "key", "email" }, { "op", "isNull" } } } } },
+              QVariantMap { { "key", "lastseen" }, { "op", ">" }, { "value", "now-7d" } } } }
+    };
+
+    QString error;
+    F f = F::fromVariant(map, model_->roleNames(), &error);
+    QVERIFY2(!f.isNull(), qPrintable(error));
+    check(f, [](const KVListEntry *e) {
+        return age(e) >= 50 && (name(e).startsWith("Anna") || !hasEmail(e))
+                && name(e).section(' ', 1).toInt() < 7*24;
+    });
+
+    f = F::fromVariant(QVariantMap { { "not", QVariantMap { { "key", "age" }, { "op", "between" }, { "value", QVariantList { 10, 89 } } } } },
+                       model_->roleNames(), &error);
+    QVERIFY2(!f.isNull(), qPrintable(error));
+    check(f, [](const KVListEntry *e) { return age(e) < 10 || age(e) > 89; });
+}
+
+void tst_KVListFilterExpression::fromVariantErrors()
+{
+    QString error;
+    QVERIFY(F::fromVariant(QVariantMap { { "key", "unknown" }, { "value", 1 } }, model_->roleNames(), &error).isNull());
+    QVERIFY(error.contains("unknown"));
+
+    error.clear();
+    QVERIFY(F::fromVariant(QVariantMap { { "key", "age" }, { "op", "~" }, { "value", 1 } }, model_->roleNames(), &error).isNull());
+    QVERIFY(!error.isEmpty());
+
+    error.clear();
+    QVERIFY(F::fromVariant(QVariantMap { { "key", "age" }, { "op", "between" }, { "value", 1 } }, model_->roleNames(), &error).isNull());
+    QVERIFY(!error.isEmpty());
+}
+
+void tst_KVListFilterExpression::filteredModel()
+{
+    ContactModel model;
+    for(int i=0; i<20; i++)
+        model << ContactEntry::create(QString("name%1").arg(i), QString(), i);
+
+    KVListFilteredModel filtered(&model);
+    filtered.setFilterExpression(F::compare(ContactEntry::age, F::Less, 5));
+    QCOMPARE(filtered.rowCount(), 5);
+
+    // changed values are re-evaluated
+    model.at(10)->setValue(ContactEntry::age, 1);
+    QCOMPARE(filtered.rowCount(), 6);
+    model.at(0)->setValue(ContactEntry::age, 100);
+    QCOMPARE(filtered.rowCount(), 5);
+
+    // inserted / removed rows
+    model.insert(3, ContactEntry::create("new", QString(), 2));
+    QCOMPARE(filtered.rowCount(), 6);
+    model.deleteAt(2);
+    QCOMPARE(filtered.rowCount(), 5);
+
+    // a filter from qml
+    QVERIFY(filtered.setFilterExpression(QVariantMap { { "key", "name" }, { "op", "startsWith" }, { "value", "name1" } }));
+    QCOMPARE(filtered.rowCount(), 11);
+    QVERIFY(!filtered.setFilterExpression(QVariantMap { { "key", "unknown" } }));
+    QCOMPARE(filtered.rowCount(), 11);
+}
+
+QTEST_GUILESS_MAIN(tst_KVListFilterExpression)
+#include "tst_kvlistfilterexpression.moc"
@@ -0,0 +1,370 @@
+#include <QtTest>
+#include "kvlisttesttypes.h"
+
+static const int ROWS = 5000;
+
+class tst_KVListGeneration : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void generation();
+    void contentHash();
+    void childModels();
+    void diff();
+    void entryOutsideModel();
+    void skipUnchangedSave();
+    void roundTrip();
+    void byteArrays();
+    void asyncLoad();
+    void editDuringAsyncLoad();
+    void serializeDuringAsyncLoad();
+
+private:
+    static void fill(KVListModel &model, int rows);
+    // writes a model with ROWS entries to 'file'
+    static void writeFile(const QString &file);
+
+    QTemporaryDir dir_;
+};
+
+void tst_KVListGeneration::initTestCase()
+{
+    registerContactTypes();
+    QVERIFY(dir_.isValid());
+}
+
+void tst_KVListGeneration::fill(KVListModel &model, int rows)
+{
+    QVector<KVListEntry*> entries;
+    for(int i=0; i<rows; i++)
+        entries << ContactEntry::create(QString("name%1").arg(i), QString("user%1@example.com").arg(i), i % 100);
+    model.appendEntries(entries);
+}
+
+void tst_KVListGeneration::writeFile(const QString &file)
+{
+    ContactModel model;
+    fill(model, ROWS);
+    QVERIFY(model.serialize(file));
+}
+
+void tst_KVListGeneration::generation()
+{
+    ContactModel model;
+    fill(model, 10);
+    quint64 g = model.generation();
+
+    // every change of the content counts
+    model.at(3)->setValue(ContactEntry::age, 1000);
+    QVERIFY(model.generation() > g);
+    g = model.generation();
+    model.insert(0, ContactEntry::create("new", QString()));
+    QVERIFY(model.generation() > g);
+    g = model.generation();
+    model.move(0, 5);
+    QVERIFY(model.generation() > g);
+    g = model.generation();
+    model.deleteAt(2);
+    QVERIFY(model.generation() > g);
+
+    // same value, transient keys
+    g = model.generation();
+    model.at(3)->setValue(ContactEntry::age, model.at(3)->getValue(ContactEntry::age));
+    model.at(3)->setValue(ContactEntry::display_ns, "display");
+    QCOMPARE(model.generation(), g);
+    QVERIFY(model.isTransientKey(ContactEntry::display_ns));
+    QVERIFY(!model.isTransientKey(ContactEntry::name));
+}
+
+void tst_KVListGeneration::contentHash()
+{
+    ContactModel a, b;
+    fill(a, 100);
+    fill(b, 100);
+    QCOMPARE(a.contentHash(), b.contentHash());
+    QVERIFY(KVListModel::differingRows(&a, &b).isEmpty());
+
+    // the hash follows the content, not the history
+    const quint64 hash = a.contentHash();
+    a.at(42)->setValue(ContactEntry::name, "changed");
+    QVERIFY(a.contentHash() != hash);
+    QCOMPARE(KVListModel::differingRows(&a, &b), QVector<int>({ 42 }));
+    a.at(42)->setValue(ContactEntry::name, "name42");
+    QCOMPARE(a.contentHash(), hash);
+
+    // order counts, the hash is updated incrementally
+    a.move(0, 1);
+    QVERIFY(a.contentHash() != hash);
+    QCOMPARE(KVListModel::differingRows(&a, &b), QVector<int>({ 0, 1 }));
+    a.move(1, 0);
+    QCOMPARE(a.contentHash(), hash);
+
+    // display strings do not
+    a.at(7)->setValue(ContactEntry::display_ns, "display");
+    QCOMPARE(a.contentHash(), hash);
+
+    // rows only present in one of the models
+    b.append(ContactEntry::create("extra", QString()));
+    QCOMPARE(KVListModel::differingRows(&a, &b), QVector<int>({ 100 }));
+    QCOMPARE(KVListModel::differingRows(&b, nullptr).size(), 101);
+}
+
+void tst_KVListGeneration::childModels()
+{
+    ContactModel model;
+    fill(model, 3);
+    ContactModel *children = new ContactModel(model.at(1));
+    fill(*children, 5);
+    model.at(1)->setChildModel(ContactEntry::children, children);
+
+    const quint64 g = model.generation();
+    const quint64 entryGeneration = model.at(1)->generation();
+    const quint64 hash = model.contentHash();
+
+    // changes inside a child model are changes of its entry and of the model
+    children->at(4)->setValue(ContactEntry::age, 1000);
+    QVERIFY(model.at(1)->generation() > entryGeneration);
+    QVERIFY(model.generation() > g);
+    QVERIFY(model.contentHash() != hash);
+
+    children->at(4)->setValue(ContactEntry::age, 4);
+    QCOMPARE(model.contentHash(), hash);
+}
+
+void tst_KVListGeneration::diff()
+{
+    ContactModel a, b;
+    fill(a, 100);
+    fill(b, 100);
+
+    // an insert / removal only reports the rows in between the equal ones
+    b.insert(0, ContactEntry::create("first", QString()));
+    QCOMPARE(KVListModel::differingRows(&a, &b), QVector<int>({ 0 }));
+    b.deleteAt(0);
+    b.deleteAt(50);
+    const QVector<KVListModel::Difference> removed = KVListModel::diff(&a, &b);
+    QCOMPARE(removed.size(), 1);
+    QCOMPARE(removed.at(0).row, 50);
+    QCOMPARE(removed.at(0).countA, 1);
+    QCOMPARE(removed.at(0).countB, 0);
+    b.insert(50, ContactEntry::create("name50", QString("user50@example.com"), 50));
+    QVERIFY(KVListModel::diff(&a, &b).isEmpty());
+
+    // changes inside child models: the path to the changed rows
+    for(ContactModel *m : { &a, &b }) {
+        ContactModel *children = new ContactModel(m->at(10));
+        fill(*children, 20);
+        m->at(10)->setChildModel(ContactEntry::children, children);
+    }
+    QVERIFY(KVListModel::diff(&a, &b).isEmpty());
+    b.at(10)->getChildModel(ContactEntry::children)->at(7)->setValue(ContactEntry::age, 1000);
+    const QVector<KVListModel::Difference> nested = KVListModel::diff(&a, &b);
+    QCOMPARE(nested.size(), 1);
+    QCOMPARE(nested.at(0).path, (QVector<QPair<int, KVListEntry::Key>>({ qMakePair(10, KVListEntry::Key(ContactEntry::children)) })));
+    QCOMPARE(nested.at(0).row, 7);
+    QCOMPARE(KVListModel::differingRows(&a, &b), QVector<int>({ 10 }));
+
+    // a changed value of the entry holding the child model is reported for the entry itself
+    b.at(10)->setValue(ContactEntry::name, "changed");
+    QCOMPARE(KVListModel::diff(&a, &b).size(), 1);
+    QVERIFY(KVListModel::diff(&a, &b).at(0).path.isEmpty());
+}
+
+void tst_KVListGeneration::entryOutsideModel()
+{
+    // the same content hashes the same, in a model or not
+    ContactEntry *e = ContactEntry::create("name", QString());
+    e->setValue(ContactEntry::display_ns, "display");
+    const quint64 outside = e->contentHash();
+    QVERIFY(e->isTransientKey(ContactEntry::display_ns));
+
+    ContactModel model;
+    model << e;
+    QCOMPARE(e->contentHash(), outside);
+    e->setValue(ContactEntry::display_ns, "other");
+    QCOMPARE(e->contentHash(), outside);
+
+    model.takeAt(0);
+    QCOMPARE(e->contentHash(), outside);
+    delete e;
+}
+
+void tst_KVListGeneration::skipUnchangedSave()
+{
+    const QString file = dir_.filePath("skip.xml");
+    ContactModel model;
+    fill(model, 10);
+    QVERIFY(model.isModified());
+    QVERIFY(model.serialize(file));
+    QVERIFY(!model.isModified());
+
+    // nothing changed: the file is not written again
+    const QDateTime written = QFileInfo(file).lastModified();
+    QTest::qWait(20);
+    QVERIFY(model.serialize(file));
+    QCOMPARE(QFileInfo(file).lastModified(), written);
+
+    // changed
+    model.at(0)->setValue(ContactEntry::name, "changed");
+    QVERIFY(model.isModified());
+    QVERIFY(model.serialize(file));
+    QVERIFY(!model.isModified());
+    QVERIFY(QFileInfo(file).lastModified() > written);
+
+    // another file, or the file is gone
+    QVERIFY(model.serialize(dir_.filePath("other.xml")));
+    QVERIFY(QFile::exists(dir_.filePath("other.xml")));
+    QVERIFY(QFile::remove(file));
+    QVERIFY(model.serialize(file));
+    QVERIFY(QFile::exists(file));
+}
+
+void tst_KVListGeneration::roundTrip()
+{
+    for(const QString &name : { QString("roundtrip.xml"), QString("roundtrip.xml.kvlc") }) {
+        const QString file = dir_.filePath(name);
+        ContactModel model;
+        fill(model, 100);
+        QVERIFY(model.serialize(file));
+
+        ContactModel loaded;
+        QVERIFY(loaded.deSerialize(file));
+        QVERIFY(!loaded.isModified());
+        QCOMPARE(loaded.contentHash(), model.contentHash());
+        QVERIFY(KVListModel::differingRows(&model, &loaded).isEmpty());
+
+        // appended to existing entries the model is not the file
+        ContactModel appended;
+        fill(appended, 1);
+        QVERIFY(appended.deSerialize(file));
+        QVERIFY(appended.isModified());
+    }
+}
+
+void tst_KVListGeneration::byteArrays()
+{
+    const QString file = dir_.filePath("bytes.xml");
+    const QByteArray binary("\0\x01\xff<\"&", 6);
+    ContactModel model;
+    fill(model, 2);
+    model.at(0)->setValue(ContactEntry::email, binary);
+    model.at(1)->setValue(ContactEntry::email, QByteArray("plain text"));
+    QVERIFY(model.serialize(file));
+
+    ContactModel loaded;
+    QVERIFY(loaded.deSerialize(file));
+    QCOMPARE(loaded.at(0)->getValue(ContactEntry::email).toByteArray(), binary);
+    QCOMPARE(loaded.at(1)->getValue(ContactEntry::email).toByteArray(), QByteArray("plain text"));
+
+    // files written before the encoding was marked hold the text as is
+    QFile f(file);
+    QVERIFY(f.open(QIODevice::ReadOnly));
+    QByteArray xml = f.readAll();
+    f.close();
+    const QByteArray encoded = "Encoding=\"base64\" Value=\"" + QByteArray("plain text").toBase64() + "\"";
+    QVERIFY(xml.contains(encoded));
+    xml.replace(encoded, "Value=\"plain text\"");
+    QVERIFY(f.open(QIODevice::WriteOnly));
+    f.write(xml);
+    f.close();
+
+    ContactModel old;
+    QVERIFY(old.deSerialize(file));
+    QCOMPARE(old.at(1)->getValue(ContactEntry::email).toByteArray(), QByteArray("plain text"));
+}
+
+void tst_KVListGeneration::asyncLoad()
+{
+    const QString file = dir_.filePath("async.xml");
+    writeFile(file);
+
+    ContactModel model;
+    QSignalSpy loaded(&model, &KVListModel::loaded);
+    QVERIFY(model.deSerializeAsync(file));
+    QVERIFY(model.isLoading());
+    QVERIFY(loaded.wait(10000));
+    QCOMPARE(loaded.at(0).at(0).toBool(), true);
+
+    QCOMPARE(model.rowCount(), ROWS);
+    QVERIFY(!model.isModified());
+
+    ContactModel reference;
+    QVERIFY(reference.deSerialize(file));
+    QCOMPARE(model.contentHash(), reference.contentHash());
+}
+
+void tst_KVListGeneration::editDuringAsyncLoad()
+{
+    const QString file = dir_.filePath("edit.xml");
+    writeFile(file);
+
+    // the first rows are edited while the others are still being attached
+    ContactModel model;
+    QSignalSpy loaded(&model, &KVListModel::loaded);
+    connect(&model, &KVListModel::progressChanged, this, [&model]() {
+        if(model.isLoading() && model.rowCount() > 0 && model.at(0)->getValue(ContactEntry::name) != "edited")
+            model.at(0)->setValue(ContactEntry::name, "edited");
+    });
+    QVERIFY(model.deSerializeAsync(file));
+    QVERIFY(loaded.wait(10000));
+
+    QCOMPARE(model.rowCount(), ROWS);
+    QCOMPARE(model.at(0)->getValue(ContactEntry::name).toString(), QString("edited"));
+    QVERIFY(model.isModified());
+
+    // and not skipped as unchanged
+    QVERIFY(model.serialize(file));
+    ContactModel reloaded;
+    QVERIFY(reloaded.deSerialize(file));
+    QCOMPARE(reloaded.at(0)->getValue(ContactEntry::name).toString(), QString("edited"));
+}
+
+void tst_KVListGeneration::serializeDuringAsyncLoad()
+{
+    const QString file = dir_.filePath("pending.xml");
+    writeFile(file);
+
+    // serialize() after an edit while loading: written once all rows are there
+    ContactModel model;
+    QSignalSpy loaded(&model, &KVListModel::loaded);
+    bool saved = false;
+    connect(&model, &KVListModel::progressChanged, this, [&model, &saved, &file]() {
+        if(saved || !model.isLoading() || model.rowCount() == 0)
+            return;
+        model.at(0)->setValue(ContactEntry::name, "edited");
+        saved = model.serialize(file);
+    });
+    QVERIFY(model.deSerializeAsync(file));
+    QVERIFY(loaded.wait(10000));
+    QVERIFY(saved);
+    QVERIFY(!model.isModified());
+
+    ContactModel reloaded;
+    QVERIFY(reloaded.deSerialize(file));
+    QCOMPARE(reloaded.rowCount(), ROWS);
+    QCOMPARE(reloaded.at(0)->getValue(ContactEntry::name).toString(), QString("edited"));
+    QVERIFY(KVListModel::differingRows(&model, &reloaded).isEmpty());
+
+    // a file which cannot be read is not overwritten by the (empty) model
+    const QString broken = dir_.filePath("broken.xml");
+    {
+        QFile f(broken);
+        QVERIFY(f.open(QIODevice::WriteOnly));
+        f.write("<no kvlist");
+    }
+    ContactModel failed;
+    QSignalSpy failedLoaded(&failed, &KVListModel::loaded);
+    QVERIFY(failed.deSerializeAsync(broken));
+    QVERIFY(failed.serialize(broken));
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression("loading failed, not overwriting"));
+    QVERIFY(failedLoaded.wait(10000));
+    QCOMPARE(failedLoaded.at(0).at(0).toBool(), false);
+    QFile f(broken);
+    QVERIFY(f.open(QIODevice::ReadOnly));
+    QCOMPARE(f.readAll(), QByteArray("<no kvlist"));
+}
+
+QTEST_GUILESS_MAIN(tst_KVListGeneration)
+#include "tst_kvlistgeneration.moc"
@@ -0,0 +1,222 @@
+#include <QtTest>
+#include <QAbstractItemModelTester>
+#include "kvlistgroupedmodel.h"
+#include "kvlisttesttypes.h"
+
+typedef KVListGroupedModel G;
+
+class tst_KVListGroupedModel : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void grouping();
+    void groupKeyName();
+    void collapse();
+    void incremental();
+    void valueChanges();
+    void moveAndReset();
+
+private:
+    // the model shows the groups sorted by key, each header followed by its (expanded) members in source order
+    void checkGroups(const KVListGroupedModel &g);
+    static QString firstLetter(const KVListEntry *e);
+
+    ContactModel *source_ = nullptr;
+};
+
+static const QStringList NAMES = { "Bob", "anna", "Carl", "Ben", "Élodie", "Alice", "", "carla", "Eve", "Bert" };
+
+void tst_KVListGroupedModel::init()
+{
+    source_ = new ContactModel();
+    for(int i=0; i<NAMES.size(); i++)
+        *source_ << ContactEntry::create(NAMES.at(i), QString(), i % 3);
+}
+
+void tst_KVListGroupedModel::cleanup()
+{
+    delete source_;
+    source_ = nullptr;
+}
+
+QString tst_KVListGroupedModel::firstLetter(const KVListEntry *e)
+{
+    return G::firstLetter(ContactEntry::name)(e);
+}
+
+void tst_KVListGroupedModel::checkGroups(const KVListGroupedModel &g)
+{
+    // brute force from the source
+    QMap<QString, QVector<int>> groups;
+    for(int row=0; row<source_->size(); row++)
+        groups[firstLetter(source_->at(row))] << row;
+
+    QCOMPARE(g.groupCount(), groups.size());
+    QCOMPARE(g.groups(), groups.keys());
+
+    int row = 0;
+    for(auto i = groups.constBegin(); i != groups.constEnd(); ++i) {
+        const QModelIndex header = g.index(row++);
+        QVERIFY(header.data(G::IS_GROUP_HEADER).toBool());
+        QCOMPARE(header.data(G::GROUP_KEY).toString(), i.key());
+        QCOMPARE(header.data(G::GROUP_COUNT).toInt(), i.value().size());
+        QCOMPARE(header.data(G::GROUP_EXPANDED).toBool(), g.isGroupExpanded(i.key()));
+        QCOMPARE(g.count(i.key()), i.value().size());
+        QCOMPARE(g.at(header.row()), static_cast<KVListEntry*>(nullptr));
+        QCOMPARE(g.mapToSource(header.row()), -1);
+
+        if(!g.isGroupExpanded(i.key()))
+            continue;
+        for(int sourceRow : i.value()) {
+            QVERIFY(!g.index(row).data(G::IS_GROUP_HEADER).toBool());
+            QCOMPARE(g.mapToSource(row), sourceRow);
+            QCOMPARE(g.at(row), source_->at(sourceRow));
+            QCOMPARE(g.index(row).data(ContactEntry::name), source_->at(sourceRow)->getValue(ContactEntry::name));
+            row++;
+        }
+    }
+    QCOMPARE(g.rowCount(), row);
+}
+
+void tst_KVListGroupedModel::grouping()
+{
+    KVListGroupedModel g(source_);
+    QAbstractItemModelTester tester(&g, QAbstractItemModelTester::FailureReportingMode::QtTest);
+    g.setGroupFunction(G::firstLetter(ContactEntry::name), { ContactEntry::name });
+    checkGroups(g);
+
+    // "" first, accents and case do not matter
+    QCOMPARE(g.groups(), QStringList({ "", "A", "B", "C", "E" }));
+    QCOMPARE(g.count("B"), 3);
+    QCOMPARE(g.count("E"), 2);
+    QCOMPARE(g.count("X"), 0);
+}
+
+void tst_KVListGroupedModel::groupKeyName()
+{
+    // the qml way
+    KVListGroupedModel g;
+    QAbstractItemModelTester tester(&g, QAbstractItemModelTester::FailureReportingMode::QtTest);
+    g.setSourceModel(source_);
+    g.setGroupKeyName("name");
+    g.setFirstLetterOnly(true);
+    checkGroups(g);
+
+    // whole values
+    g.setGroupKey(ContactEntry::age);
+    QCOMPARE(g.groups(), QStringList({ "0", "1", "2" }));
+    QCOMPARE(g.count("0"), 4);
+    QCOMPARE(g.groupKeyName(), QString("age"));
+}
+
+void tst_KVListGroupedModel::collapse()
+{
+    KVListGroupedModel g(source_);
+    QAbstractItemModelTester tester(&g, QAbstractItemModelTester::FailureReportingMode::QtTest);
+    g.setGroupFunction(G::firstLetter(ContactEntry::name), { ContactEntry::name });
+
+    g.toggleGroup("B");
+    QVERIFY(!g.isGroupExpanded("B"));
+    checkGroups(g);
+    g.setGroupExpanded("A", false);
+    checkGroups(g);
+
+    // changes in collapsed groups
+    source_->at(0)->setValue(ContactEntry::name, "Bobby");
+    source_->insert(0, ContactEntry::create("Bea", QString()));
+    checkGroups(g);
+
+    // collapsed groups stay collapsed when the groups are rebuilt
+    source_->move(0, 5);
+    QVERIFY(!g.isGroupExpanded("B"));
+    checkGroups(g);
+
+    g.toggleGroup("B");
+    g.toggleGroup("A");
+    checkGroups(g);
+}
+
+void tst_KVListGroupedModel::incremental()
+{
+    KVListGroupedModel g(source_);
+    QAbstractItemModelTester tester(&g, QAbstractItemModelTester::FailureReportingMode::QtTest);
+    g.setGroupFunction(G::firstLetter(ContactEntry::name), { ContactEntry::name });
+    QSignalSpy reset(&g, &QAbstractItemModel::modelReset);
+    QSignalSpy groupCount(&g, &KVListGroupedModel::groupCountChanged);
+
+    // into existing groups, new groups, in front of and behind other members
+    const QStringList added = { "Zoe", "Adam", "Bill", "Dora", "zack", "Carmen" };
+    for(int i=0; i<added.size(); i++) {
+        source_->insert((i * 3) % (source_->size() + 1), ContactEntry::create(added.at(i), QString()));
+        checkGroups(g);
+    }
+    QVERIFY(groupCount.count() > 0);
+
+    // removing the last member removes the group
+    while(source_->size() > 0) {
+        source_->deleteAt(source_->size() / 2);
+        checkGroups(g);
+    }
+    QCOMPARE(g.groupCount(), 0);
+    QCOMPARE(reset.count(), 0);
+}
+
+void tst_KVListGroupedModel::valueChanges()
+{
+    KVListGroupedModel g(source_);
+    QAbstractItemModelTester tester(&g, QAbstractItemModelTester::FailureReportingMode::QtTest);
+    g.setGroupFunction(G::firstLetter(ContactEntry::name), { ContactEntry::name });
+    QSignalSpy reset(&g, &QAbstractItemModel::modelReset);
+
+    // an entry changes its group (also into a new one / leaving one empty)
+    source_->at(0)->setValue(ContactEntry::name, "Arnold");
+    checkGroups(g);
+    source_->at(6)->setValue(ContactEntry::name, "Xaver");
+    checkGroups(g);
+    QVERIFY(!g.groups().contains(""));
+    source_->at(4)->setValue(ContactEntry::name, "bea");
+    source_->at(8)->setValue(ContactEntry::name, "Ute");
+    checkGroups(g);
+    QVERIFY(!g.groups().contains("E"));
+
+    // within its group: a plain dataChanged()
+    QSignalSpy changed(&g, &QAbstractItemModel::dataChanged);
+    source_->at(3)->setValue(ContactEntry::name, "Benjamin");
+    checkGroups(g);
+    QCOMPARE(changed.count(), 1);
+
+    // keys the group does not depend on
+    changed.clear();
+    source_->at(3)->setValue(ContactEntry::age, 99);
+    QCOMPARE(changed.count(), 1);
+    checkGroups(g);
+
+    QCOMPARE(reset.count(), 0);
+}
+
+void tst_KVListGroupedModel::moveAndReset()
+{
+    KVListGroupedModel g(source_);
+    QAbstractItemModelTester tester(&g, QAbstractItemModelTester::FailureReportingMode::QtTest);
+    g.setGroupFunction(G::firstLetter(ContactEntry::name), { ContactEntry::name });
+
+    source_->move(0, 9);
+    checkGroups(g);
+    source_->sortByKey(ContactEntry::name);
+    checkGroups(g);
+    source_->deleteAll();
+    checkGroups(g);
+    QCOMPARE(g.rowCount(), 0);
+
+    // the source goes away
+    delete source_;
+    source_ = nullptr;
+    QCOMPARE(g.rowCount(), 0);
+    QVERIFY(!g.sourceModel());
+}
+
+QTEST_GUILESS_MAIN(tst_KVListGroupedModel)
+#include "tst_kvlistgroupedmodel.moc"
@@ -0,0 +1,196 @@
+#include <QtTest>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include "kvlistreplication.h"
+#include "kvlisttesttypes.h"
+
+// forwards the messages between a replica and its source and can drop a batch on the way
+class Relay : public QObject
+{
+    Q_OBJECT
+
+public:
+    Relay(const QString &name, const QString &sourceName) : sourceName_(sourceName) {
+        connect(&server_, &QLocalServer::newConnection, this, [this](){
+            replica_ = server_.nextPendingConnection();
+            source_ = new QLocalSocket(this);
+            connect(replica_, &QLocalSocket::readyRead, this, [this](){ forward(replica_, source_, false); });
+            connect(source_, &QLocalSocket::readyRead, this, [this](){ forward(source_, replica_, true); });
+            source_->connectToServer(sourceName_);
+        });
+        QLocalServer::removeServer(name);
+        server_.listen(name);
+    }
+
+    bool dropNextBatch = false;
+    int dropped = 0;
+    int snapshots = 0;
+
+private:
+    void forward(QLocalSocket *from, QLocalSocket *to, bool fromSource) {
+        QDataStream in(from);
+        for(;;) {
+            in.startTransaction();
+            QByteArray msg;
+            in >> msg;
+            if(!in.commitTransaction())
+                break;
+
+            const quint8 type = msg.isEmpty() ? 0xff : quint8(msg.at(0));
+            if(fromSource && type == KVListReplication::Batch && dropNextBatch) {
+                dropNextBatch = false;
+                dropped++;
+                continue;
+            }
+            if(fromSource && type == KVListReplication::Snapshot)
+                snapshots++;
+
+            QDataStream out(to);
+            out << msg;
+        }
+    }
+
+    QString sourceName_;
+    QLocalServer server_;
+    QPointer<QLocalSocket> replica_, source_;
+};
+
+class tst_KVListReplication : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void snapshot();
+    void incrementalChanges();
+    void resyncAfterDroppedBatch();
+
+private:
+    QString serverName();
+    static void fill(KVListModel &model, int rows);
+    static bool equal(const KVListModel &a, const KVListModel &b);
+    int counter_ = 0;
+};
+
+QString tst_KVListReplication::serverName()
+{
+    return QString("tst_kvlistreplication_%1_%2").arg(QCoreApplication::applicationPid()).arg(counter_++);
+}
+
+void tst_KVListReplication::fill(KVListModel &model, int rows)
+{
+    for(int i=0; i<rows; i++)
+        model << ContactEntry::create(QString("name%1").arg(i), QString("name%1@example.com").arg(i), i);
+}
+
+bool tst_KVListReplication::equal(const KVListModel &a, const KVListModel &b)
+{
+    return a.size() == b.size() && KVListModel::differingRows(&a, &b).isEmpty();
+}
+
+void tst_KVListReplication::initTestCase()
+{
+    registerContactTypes();
+}
+
+void tst_KVListReplication::snapshot()
+{
+    ContactModel model;
+    fill(model, 5);
+    model.at(2)->setValue(ContactEntry::display_ns, "not replicated");
+
+    const QString name = serverName();
+    KVListReplicaSource *source = new KVListReplicaSource(&model, name);
+    QVERIFY2(source->isListening(), qPrintable(source->errorString()));
+
+    ContactModel replicaModel;
+    QSignalSpy inserted(&replicaModel, &QAbstractItemModel::rowsInserted);
+    KVListReplica *replica = new KVListReplica(&replicaModel, name);
+    QTRY_COMPARE(replicaModel.size(), 5);
+
+    // applied at once
+    QCOMPARE(inserted.count(), 1);
+    QVERIFY(equal(model, replicaModel));
+    QCOMPARE(replica->sequence(), source->sequence());
+    QCOMPARE(replicaModel.at(3)->getValue(ContactEntry::name).toString(), QString("name3"));
+    QVERIFY(!replicaModel.at(2)->getValue(ContactEntry::display_ns).isValid());
+
+    // the socket of a running source is not taken over
+    {
+        KVListReplicaSource second(&model, name);
+        QVERIFY(!second.isListening());
+    }
+    model.at(0)->setValue(ContactEntry::age, 42);
+    QTRY_COMPARE(replica->sequence(), source->sequence());
+    QCOMPARE(replicaModel.at(0)->getValue(ContactEntry::age).toInt(), 42);
+}
+
+void tst_KVListReplication::incrementalChanges()
+{
+    ContactModel model;
+    fill(model, 3);
+
+    const QString name = serverName();
+    KVListReplicaSource *source = new KVListReplicaSource(&model, name);
+    ContactModel replicaModel;
+    KVListReplica *replica = new KVListReplica(&replicaModel, name);
+    QTRY_COMPARE(replicaModel.size(), 3);
+
+    // inserts
+    model << ContactEntry::create("appended", "appended@example.com");
+    model.insert(0, ContactEntry::create("first", "first@example.com"));
+    QTRY_COMPARE(replica->sequence(), source->sequence());
+    QCOMPARE(replicaModel.size(), 5);
+    QCOMPARE(replicaModel.at(0)->getValue(ContactEntry::name).toString(), QString("first"));
+    QCOMPARE(replicaModel.at(4)->getValue(ContactEntry::name).toString(), QString("appended"));
+
+    // values
+    model.at(2)->setValue(ContactEntry::age, 42);
+    model.at(3)->setValue(ContactEntry::email, "changed@example.com");
+    QTRY_COMPARE(replica->sequence(), source->sequence());
+    QCOMPARE(replicaModel.at(2)->getValue(ContactEntry::age).toInt(), 42);
+    QCOMPARE(replicaModel.at(3)->getValue(ContactEntry::email).toString(), QString("changed@example.com"));
+
+    // moves and removals
+    model.move(0, 4);
+    model.move(3, 1);
+    model.deleteAt(2);
+    QTRY_COMPARE(replica->sequence(), source->sequence());
+    QVERIFY(equal(model, replicaModel));
+}
+
+void tst_KVListReplication::resyncAfterDroppedBatch()
+{
+    ContactModel model;
+    fill(model, 3);
+
+    const QString name = serverName(), relayName = serverName();
+    KVListReplicaSource *source = new KVListReplicaSource(&model, name);
+    Relay relay(relayName, name);
+    ContactModel replicaModel;
+    KVListReplica *replica = new KVListReplica(&replicaModel, relayName);
+    QTRY_COMPARE(replicaModel.size(), 3);
+    QCOMPARE(relay.snapshots, 1);
+
+    // lost on the way: the replica does not notice until the next batch
+    relay.dropNextBatch = true;
+    model.at(0)->setValue(ContactEntry::name, "dropped");
+    QTRY_COMPARE(relay.dropped, 1);
+    QCOMPARE(replicaModel.at(0)->getValue(ContactEntry::name).toString(), QString("name0"));
+
+    // the gap in the sequence makes the replica request a new snapshot
+    model << ContactEntry::create("after the gap", "gap@example.com");
+    QTRY_COMPARE(relay.snapshots, 2);
+    QTRY_COMPARE(replica->sequence(), source->sequence());
+    QVERIFY(equal(model, replicaModel));
+    QCOMPARE(replicaModel.at(0)->getValue(ContactEntry::name).toString(), QString("dropped"));
+
+    // and continues with incremental changes afterwards
+    model.at(1)->setValue(ContactEntry::age, 7);
+    QTRY_COMPARE(replica->sequence(), source->sequence());
+    QVERIFY(equal(model, replicaModel));
+    QCOMPARE(relay.snapshots, 2);
+}
+
+QTEST_GUILESS_MAIN(tst_KVListReplication)
+#include "tst_kvlistreplication.moc"
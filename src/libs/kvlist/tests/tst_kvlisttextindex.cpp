@@ -0,0 +1,244 @@
+#include <QtTest>
+#include <algorithm>
+#include "kvlisttextindex.h"
+#include "kvlistfilteredmodel.h"
+#include "kvlisttesttypes.h"
+
+// the live search has to keep up with typing: one frame per keystroke
+static const qint64 FRAME_NS = 16 * 1000 * 1000;
+static const int ROWS = 100000;
+
+class tst_KVListTextIndex : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void typing();
+    void filteredModelTyping();
+    void valueChangedDuringSearch();
+    void insertRemoveDuringSearch();
+    void reset();
+
+private:
+    // what the index should find, by checking every entry
+    QSet<KVListEntry*> expected(const QString &text) const;
+    // search via the index, 'ns' is the time it took
+    QSet<KVListEntry*> search(const QString &text, qint64 *ns = nullptr);
+
+    ContactModel *model_ = nullptr;
+    KVListTextIndex *index_ = nullptr;
+};
+
+void tst_KVListTextIndex::initTestCase()
+{
+    static const QStringList firstNames = {
+        "Anna", "Christina", "Christian", "Chris", "Christoph", "Jürgen", "José", "Johanna", "John", "Johannes",
+        "Marie", "Mario", "Michael", "Michaela", "Sophie", "Stefan", "Stephanie", "Thomas", "Tobias", "Zoë" };
+    static const QStringList surNames = {
+        "Müller", "Mueller", "Meier", "Maier", "Schmidt", "Schneider", "Fischer", "Weber", "Wagner", "Becker",
+        "Schulz", "Hoffmann", "Koch", "Richter", "Klein", "Wolf", "Schröder", "Neumann", "Schwarz", "Zimmermann" };
+
+    model_ = new ContactModel();
+    QVector<KVListEntry*> entries;
+    entries.reserve(ROWS);
+    for(int i=0; i<ROWS; i++) {
+        const QString first = firstNames.at(i % firstNames.size());
+        const QString last = surNames.at((i / firstNames.size()) % surNames.size());
+        entries << ContactEntry::create(first + ' ' + last, QString("%1.%2%3@example.com").arg(first, last).arg(i), i);
+    }
+    model_->appendEntries(entries);
+
+    QElapsedTimer timer;
+    timer.start();
+    index_ = new KVListTextIndex(model_, { ContactEntry::name, ContactEntry::email });
+    qInfo() << "index of" << ROWS << "entries:" << timer.elapsed() << "ms," << index_->wordCount() << "words";
+    QCOMPARE(index_->entryCount(), ROWS);
+}
+
+void tst_KVListTextIndex::cleanupTestCase()
+{
+    delete model_;
+}
+
+QSet<KVListEntry*> tst_KVListTextIndex::expected(const QString &text) const
+{
+    const QStringList query = KVListTextIndex::words(text);
+    QSet<KVListEntry*> result;
+    for(KVListEntry *e : *model_) {
+        const QStringList words = KVListTextIndex::words(e->getValue(ContactEntry::name).toString())
+                + KVListTextIndex::words(e->getValue(ContactEntry::email).toString());
+        bool all = true;
+        for(const QString &q : query) {
+            all = std::any_of(words.begin(), words.end(), [&q](const QString &w) { return w.startsWith(q); });
+            if(!all)
+                break;
+        }
+        if(all)
+            result.insert(e);
+    }
+    return result;
+}
+
+QSet<KVListEntry*> tst_KVListTextIndex::search(const QString &text, qint64 *ns)
+{
+    QElapsedTimer timer;
+    timer.start();
+    QSet<KVListEntry*> result = index_->search(text);
+    if(ns)
+        *ns = timer.nsecsElapsed();
+    return result;
+}
+
+void tst_KVListTextIndex::typing()
+{
+    // the user types "christina mül", char by char (with a word boundary and an umlaut)
+    const QString text = QStringLiteral("christina mül");
+    QSet<KVListEntry*> previous;
+    qint64 slowest = 0;
+
+    for(int i=1; i<=text.size(); i++) {
+        const QString typed = text.left(i);
+        qint64 ns;
+        const QSet<KVListEntry*> result = search(typed, &ns);
+        QCOMPARE(result, expected(typed));
+        qInfo() << qPrintable(QString("'%1'").arg(typed).leftJustified(16)) << result.size() << "results"
+                << double(ns) / 1000000 << "ms";
+
+        // every keystroke narrows the previous result
+        if(i > 1)
+            QVERIFY2((result - previous).isEmpty(), qPrintable(typed));
+        previous = result;
+        slowest = qMax(slowest, ns);
+    }
+
+    QVERIFY(!previous.isEmpty());
+    // 'ü' is normalized to 'u': "mül" finds Müller, but not Mueller
+    for(KVListEntry *e : previous)
+        QVERIFY(e->getValue(ContactEntry::name).toString().endsWith(QStringLiteral("Müller")));
+
+#ifdef QT_NO_DEBUG
+    QVERIFY2(slowest < FRAME_NS, qPrintable(QString("slowest keystroke: %1 ms").arg(double(slowest) / 1000000)));
+#else
+    Q_UNUSED(slowest)
+#endif
+
+    // deleting chars widens the result again
+    QCOMPARE(search("christina"), expected("christina"));
+    QCOMPARE(search(""), expected(""));
+    QCOMPARE(index_->search("").size(), ROWS);
+}
+
+void tst_KVListTextIndex::filteredModelTyping()
+{
+    // the same keystrokes through the proxy a view would use
+    KVListFilteredModel filtered(model_);
+    QSignalSpy reset(&filtered, &QAbstractItemModel::modelReset);
+    const QString text = QStringLiteral("christina mül");
+    int previousRows = filtered.rowCount();
+    qint64 slowest = 0;
+
+    for(int i=1; i<=text.size(); i++) {
+        const QString typed = text.left(i);
+        QElapsedTimer timer;
+        timer.start();
+        filtered.setSearchText(typed);
+        const qint64 ns = timer.nsecsElapsed();
+        qInfo() << qPrintable(QString("'%1'").arg(typed).leftJustified(16)) << filtered.rowCount() << "rows"
+                << double(ns) / 1000000 << "ms";
+
+        QCOMPARE(filtered.rowCount(), expected(typed).size());
+        QVERIFY(filtered.rowCount() <= previousRows);
+        previousRows = filtered.rowCount();
+        slowest = qMax(slowest, ns);
+    }
+    QCOMPARE(reset.count(), 0);
+
+#ifdef QT_NO_DEBUG
+    QVERIFY2(slowest < FRAME_NS, qPrintable(QString("slowest keystroke: %1 ms").arg(double(slowest) / 1000000)));
+#else
+    Q_UNUSED(slowest)
+#endif
+
+    // the rows are the right ones
+    const QSet<KVListEntry*> exp = expected(text);
+    for(int row=0; row<filtered.rowCount(); row++)
+        QVERIFY(exp.contains(model_->at(filtered.mapToSource(filtered.index(row, 0)).row())));
+
+    // deleting chars widens the result again
+    filtered.setSearchText(QStringLiteral("christina"));
+    QCOMPARE(filtered.rowCount(), expected("christina").size());
+    filtered.setSearchText(QString());
+    QCOMPARE(filtered.rowCount(), ROWS);
+}
+
+void tst_KVListTextIndex::valueChangedDuringSearch()
+{
+    QSet<KVListEntry*> result = search("zo");
+    QCOMPARE(result, expected("zo"));
+
+    // an entry which did not match starts to match, one which matched does not anymore
+    KVListEntry *joining = nullptr, *leaving = *result.begin();
+    for(KVListEntry *e : *model_) {
+        if(!result.contains(e)) {
+            joining = e;
+            break;
+        }
+    }
+    QVERIFY(joining);
+    joining->setValue(ContactEntry::name, QStringLiteral("Zoltán Zobel"));
+    leaving->setValue(ContactEntry::name, QStringLiteral("Anna Becker"));
+    leaving->setValue(ContactEntry::email, QStringLiteral("anna@example.com"));
+
+    // the next keystroke refines the previous result, which has to reflect the changes
+    result = search("zol");
+    QCOMPARE(result, expected("zol"));
+    QVERIFY(result.contains(joining));
+    QVERIFY(!result.contains(leaving));
+
+    // changes of keys which are not indexed don't matter
+    joining->setValue(ContactEntry::age, 1);
+    QCOMPARE(search("zolt"), expected("zolt"));
+    QVERIFY(index_->search("zolt").contains(joining));
+
+    // also a new query (no refinement) sees the changes
+    QCOMPARE(search("anna beck"), expected("anna beck"));
+    QVERIFY(index_->search("anna beck").contains(leaving));
+}
+
+void tst_KVListTextIndex::insertRemoveDuringSearch()
+{
+    QSet<KVListEntry*> result = search("steph");
+    QCOMPARE(result, expected("steph"));
+
+    KVListEntry *added = ContactEntry::create(QStringLiteral("Stephen Hawking"), QStringLiteral("stephen@example.com"));
+    model_->insert(10, added);
+    KVListEntry *removed = *result.begin();
+    model_->deleteAt(model_->indexOf(removed));
+
+    result = search("stephe");
+    QCOMPARE(result, expected("stephe"));
+    QVERIFY(result.contains(added));
+    QCOMPARE(index_->entryCount(), ROWS);
+}
+
+void tst_KVListTextIndex::reset()
+{
+    ContactModel model;
+    model << ContactEntry::create("Anna Müller", QString()) << ContactEntry::create("Anton Meier", QString());
+    KVListTextIndex index(&model, { ContactEntry::name });
+    QCOMPARE(index.search("an").size(), 2);
+
+    // the index drops the entries before they are deleted and is rebuilt afterwards
+    model.deleteAll();
+    QCOMPARE(index.entryCount(), 0);
+    QVERIFY(index.search("an").isEmpty());
+
+    model << ContactEntry::create("Andrea Weber", QString());
+    QCOMPARE(index.search("an").size(), 1);
+    QCOMPARE(index.entryCount(), 1);
+}
+
+QTEST_GUILESS_MAIN(tst_KVListTextIndex)
+#include "tst_kvlisttextindex.moc"
@@ -0,0 +1,216 @@
+#include <QtTest>
+#include <QAbstractItemModelTester>
+#include "kvlisttreemodel.h"
+#include "kvlisttesttypes.h"
+
+class tst_KVListTreeModel : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void lazyFetch();
+    void lazyChildModels();
+    void childChanges();
+    void collapseOnReplace();
+    void consistency();
+
+private:
+    // root: 3 rows; row 0 has 5 children, the first of them 2 children; row 1 has a lazy child model
+    static ContactModel *children(int rows, const QString &prefix, QObject *parent);
+    static QString name(const QModelIndex &index) { return index.data(ContactEntry::name).toString(); }
+
+    ContactModel *root_ = nullptr;
+    bool factoryCalled_ = false;
+};
+
+ContactModel *tst_KVListTreeModel::children(int rows, const QString &prefix, QObject *parent)
+{
+    ContactModel *m = new ContactModel(parent);
+    for(int i=0; i<rows; i++)
+        *m << ContactEntry::create(QString("%1.%2").arg(prefix).arg(i), QString());
+    return m;
+}
+
+void tst_KVListTreeModel::init()
+{
+    root_ = children(3, "r", nullptr);
+    ContactModel *c = children(5, "r0", root_->at(0));
+    c->at(0)->setChildModel(ContactEntry::children, children(2, "r0.0", c->at(0)));
+    root_->at(0)->setChildModel(ContactEntry::children, c);
+
+    factoryCalled_ = false;
+    root_->at(1)->setChildModelFactory(ContactEntry::children, [this](){
+        factoryCalled_ = true;
+        return children(4, "r1", root_->at(1));
+    });
+}
+
+void tst_KVListTreeModel::cleanup()
+{
+    delete root_;
+    root_ = nullptr;
+}
+
+void tst_KVListTreeModel::lazyFetch()
+{
+    KVListTreeModel tree(root_, { ContactEntry::children });
+    tree.setFetchBatchSize(2);
+
+    // the top level is there right away
+    QCOMPARE(tree.rowCount(), 3);
+    QCOMPARE(name(tree.index(2, 0)), QString("r.2"));
+
+    // children are fetched in batches once the branch is expanded
+    const QModelIndex r0 = tree.index(0, 0);
+    QVERIFY(tree.hasChildren(r0));
+    QCOMPARE(tree.rowCount(r0), 0);
+    QVERIFY(tree.canFetchMore(r0));
+    tree.fetchMore(r0);
+    QCOMPARE(tree.rowCount(r0), 2);
+    tree.fetchMore(r0);
+    tree.fetchMore(r0);
+    QCOMPARE(tree.rowCount(r0), 5);
+    QVERIFY(!tree.canFetchMore(r0));
+
+    const QModelIndex r00 = tree.index(0, 0, r0);
+    QCOMPARE(name(r00), QString("r0.0"));
+    QCOMPARE(tree.parent(r00), r0);
+    QCOMPARE(tree.entry(r00), root_->at(0)->getChildModel(ContactEntry::children)->at(0));
+
+    // next level
+    tree.fetchMore(r00);
+    QCOMPARE(tree.rowCount(r00), 2);
+    QCOMPARE(name(tree.index(1, 0, r00)), QString("r0.0.1"));
+    QCOMPARE(tree.parent(tree.index(1, 0, r00)), r00);
+
+    // rows without child model
+    QVERIFY(!tree.hasChildren(tree.index(2, 0)));
+    QVERIFY(!tree.canFetchMore(tree.index(2, 0)));
+}
+
+void tst_KVListTreeModel::lazyChildModels()
+{
+    KVListTreeModel tree(root_, { ContactEntry::children });
+
+    // drawing the expand indicator does not create the child model
+    const QModelIndex r1 = tree.index(1, 0);
+    QVERIFY(tree.hasChildren(r1));
+    QVERIFY(root_->at(1)->isLazy(ContactEntry::children));
+    QVERIFY(!factoryCalled_);
+
+    // expanding does
+    tree.fetchMore(r1);
+    QVERIFY(factoryCalled_);
+    QCOMPARE(tree.rowCount(r1), 4);
+    QCOMPARE(name(tree.index(3, 0, r1)), QString("r1.3"));
+}
+
+void tst_KVListTreeModel::childChanges()
+{
+    KVListTreeModel tree(root_, { ContactEntry::children });
+    const QModelIndex r0 = tree.index(0, 0);
+    tree.fetchMore(r0);
+    KVListModel *c = root_->at(0)->getChildModel(ContactEntry::children);
+
+    // inserts / removals in a child model show up below its row
+    QSignalSpy inserted(&tree, &QAbstractItemModel::rowsInserted);
+    c->insert(1, ContactEntry::create("new", QString()));
+    QCOMPARE(inserted.count(), 1);
+    QCOMPARE(inserted.at(0).at(0).value<QModelIndex>(), r0);
+    QCOMPARE(inserted.at(0).at(1).toInt(), 1);
+    QCOMPARE(tree.rowCount(r0), 6);
+    QCOMPARE(name(tree.index(1, 0, r0)), QString("new"));
+
+    QSignalSpy removed(&tree, &QAbstractItemModel::rowsRemoved);
+    c->deleteAt(0);
+    QCOMPARE(removed.count(), 1);
+    QCOMPARE(tree.rowCount(r0), 5);
+
+    // value changes
+    QSignalSpy changed(&tree, &QAbstractItemModel::dataChanged);
+    c->at(2)->setValue(ContactEntry::name, "changed");
+    QCOMPARE(changed.count(), 1);
+    QCOMPARE(changed.at(0).at(0).value<QModelIndex>(), tree.index(2, 0, r0));
+    QCOMPARE(name(tree.index(2, 0, r0)), QString("changed"));
+
+    // moves keep persistent indexes
+    QPersistentModelIndex p(tree.index(0, 0, r0));
+    const QString pName = name(p);
+    c->move(0, 3);
+    QCOMPARE(p.row(), 3);
+    QCOMPARE(name(p), pName);
+
+    // removing the row of an expanded branch
+    QPersistentModelIndex child(tree.index(0, 0, r0));
+    root_->deleteAt(0);
+    QCOMPARE(tree.rowCount(), 2);
+    QVERIFY(!child.isValid());
+}
+
+void tst_KVListTreeModel::collapseOnReplace()
+{
+    KVListTreeModel tree(root_, { ContactEntry::children });
+    QAbstractItemModelTester tester(&tree, QAbstractItemModelTester::FailureReportingMode::QtTest);
+
+    const QModelIndex r0 = tree.index(0, 0);
+    while(tree.canFetchMore(r0))
+        tree.fetchMore(r0);
+    QCOMPARE(tree.rowCount(r0), 5);
+
+    // the branch is collapsed: the rows are removed while the old rows are still counted
+    QSignalSpy aboutToBeRemoved(&tree, &QAbstractItemModel::rowsAboutToBeRemoved);
+    int rowCountInside = -1;
+    connect(&tree, &QAbstractItemModel::rowsAboutToBeRemoved, this, [&](const QModelIndex &parent){
+        rowCountInside = tree.rowCount(parent);
+    });
+    root_->at(0)->setChildModel(ContactEntry::children, children(1, "replaced", root_->at(0)));
+    QCOMPARE(aboutToBeRemoved.count(), 1);
+    QCOMPARE(rowCountInside, 5);
+    QCOMPARE(tree.rowCount(r0), 0);
+
+    // and can be expanded again, showing the new model
+    QVERIFY(tree.canFetchMore(r0));
+    tree.fetchMore(r0);
+    QCOMPARE(tree.rowCount(r0), 1);
+    QCOMPARE(name(tree.index(0, 0, r0)), QString("replaced.0"));
+}
+
+void tst_KVListTreeModel::consistency()
+{
+    KVListTreeModel tree(root_, { ContactEntry::children });
+    tree.setFetchBatchSize(2);
+    // checks every signal of the tree against its state (and fetches all branches on the way)
+    QAbstractItemModelTester tester(&tree, QAbstractItemModelTester::FailureReportingMode::QtTest);
+
+    KVListModel *c = root_->at(0)->getChildModel(ContactEntry::children);
+    c->insert(0, ContactEntry::create("a", QString()));
+    c->append(ContactEntry::create("b", QString()));
+    c->move(0, 2);
+    c->deleteAt(1);
+    c->sort([](const KVListEntry *a, const KVListEntry *b) {
+        return a->getValue(ContactEntry::name).toString() > b->getValue(ContactEntry::name).toString();
+    });
+
+    // the model of an expanded grandchild goes away with its entry while the branch is reset
+    const QModelIndex r0 = tree.index(0, 0);
+    QModelIndex r00;
+    for(int row=0; row<tree.rowCount(r0); row++) {
+        if(name(tree.index(row, 0, r0)) == "r0.0")
+            r00 = tree.index(row, 0, r0);
+    }
+    while(tree.canFetchMore(r00))
+        tree.fetchMore(r00);
+    QCOMPARE(tree.rowCount(r00), 2);
+    c->deleteAll();
+    QCOMPARE(tree.rowCount(r0), 0);
+
+    root_->at(1)->getChildModel(ContactEntry::children)->deleteAll();
+    root_->at(0)->setChildModel(ContactEntry::children, children(3, "replaced", root_->at(0)));
+    root_->insert(0, ContactEntry::create("first", QString()));
+    root_->deleteAt(1);
+}
+
+QTEST_GUILESS_MAIN(tst_KVListTreeModel)
+#include "tst_kvlisttreemodel.moc"
@@ -0,0 +1,177 @@
+#include <QtTest>
+#include <QAbstractItemModelTester>
+#include "kvlistwindowmodel.h"
+#include "kvlisttesttypes.h"
+
+class tst_KVListWindowModel : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void window();
+    void scrolling();
+    void scrollingKeepsRows();
+    void sourceChanges();
+    void layoutChanges();
+    void setData();
+
+private:
+    // the window shows exactly the source rows [offset, offset + limit)
+    void checkWindow(const KVListWindowModel &w);
+
+    ContactModel *source_ = nullptr;
+    int created_ = 0;
+};
+
+void tst_KVListWindowModel::init()
+{
+    source_ = new ContactModel();
+    for(created_=0; created_<100; created_++)
+        *source_ << ContactEntry::create(QString("name%1").arg(created_), QString(), created_);
+}
+
+void tst_KVListWindowModel::cleanup()
+{
+    delete source_;
+    source_ = nullptr;
+}
+
+void tst_KVListWindowModel::checkWindow(const KVListWindowModel &w)
+{
+    const int rows = qBound(0, source_->size() - w.offset(), w.limit());
+    QCOMPARE(w.rowCount(), rows);
+    QCOMPARE(w.count(), rows);
+    for(int row=0; row<rows; row++) {
+        QCOMPARE(w.at(row), source_->at(w.offset() + row));
+        QCOMPARE(w.index(row).data(ContactEntry::name), source_->at(w.offset() + row)->getValue(ContactEntry::name));
+    }
+}
+
+void tst_KVListWindowModel::window()
+{
+    KVListWindowModel w(source_, 10, 5);
+    QAbstractItemModelTester tester(&w, QAbstractItemModelTester::FailureReportingMode::QtTest);
+    checkWindow(w);
+    QCOMPARE(w.index(0).data(ContactEntry::name).toString(), QString("name10"));
+    QCOMPARE(w.mapToSource(2), 12);
+    QCOMPARE(w.mapFromSource(14), 4);
+    QCOMPARE(w.mapFromSource(15), -1);
+    QCOMPARE(w.roleNames(), source_->roleNames());
+
+    // at the end of the source
+    w.setOffset(97);
+    checkWindow(w);
+    QCOMPARE(w.rowCount(), 3);
+    w.setOffset(1000);
+    checkWindow(w);
+    QCOMPARE(w.rowCount(), 0);
+
+    // limit
+    w.setOffset(0);
+    w.setLimit(20);
+    checkWindow(w);
+    w.setLimit(0);
+    checkWindow(w);
+}
+
+void tst_KVListWindowModel::scrolling()
+{
+    KVListWindowModel w(source_, 10, 5);
+    QAbstractItemModelTester tester(&w, QAbstractItemModelTester::FailureReportingMode::QtTest);
+    QSignalSpy countChanged(&w, &KVListWindowModel::countChanged);
+
+    for(int offset : { 12, 13, 8, 20, 2, 0, 96, 99, 100, 50 }) {
+        w.setOffset(offset);
+        QCOMPARE(w.offset(), offset);
+        checkWindow(w);
+    }
+    QVERIFY(countChanged.count() > 0);
+}
+
+void tst_KVListWindowModel::scrollingKeepsRows()
+{
+    KVListWindowModel w(source_, 10, 5);
+    QSignalSpy reset(&w, &QAbstractItemModel::modelReset);
+
+    // rows which stay visible keep their indexes (no reset)
+    QPersistentModelIndex p(w.index(3));
+    w.setOffset(12);
+    QCOMPARE(p.row(), 1);
+    QCOMPARE(p.data(ContactEntry::name).toString(), QString("name13"));
+    w.setOffset(10);
+    QCOMPARE(p.row(), 3);
+    QCOMPARE(reset.count(), 0);
+}
+
+void tst_KVListWindowModel::sourceChanges()
+{
+    KVListWindowModel w(source_, 10, 5);
+    QAbstractItemModelTester tester(&w, QAbstractItemModelTester::FailureReportingMode::QtTest);
+
+    auto create = [this]() { return ContactEntry::create(QString("name%1").arg(created_++), QString()); };
+
+    // in front of the window, inside, right behind and far behind it
+    for(int row : { 0, 9, 10, 12, 14, 15, 50 }) {
+        source_->insert(row, create());
+        checkWindow(w);
+    }
+    for(int row : { 0, 9, 10, 12, 14, 15, 50 }) {
+        source_->deleteAt(row);
+        checkWindow(w);
+    }
+
+    // several rows at once
+    source_->appendEntries({ create(), create(), create() });
+    checkWindow(w);
+
+    // the window shrinks with the source and grows again
+    w.setOffset(95);
+    while(source_->size() > 96) {
+        source_->deleteAt(source_->size() - 1);
+        checkWindow(w);
+    }
+    source_->append(create());
+    checkWindow(w);
+
+    // values: only the window's rows are reported
+    QSignalSpy changed(&w, &QAbstractItemModel::dataChanged);
+    source_->at(0)->setValue(ContactEntry::age, 1);
+    QCOMPARE(changed.count(), 0);
+    source_->at(96)->setValue(ContactEntry::age, 1);
+    QCOMPARE(changed.count(), 1);
+    QCOMPARE(changed.at(0).at(0).value<QModelIndex>().row(), 1);
+
+    // reset
+    source_->deleteAll();
+    checkWindow(w);
+}
+
+void tst_KVListWindowModel::layoutChanges()
+{
+    KVListWindowModel w(source_, 10, 5);
+    QAbstractItemModelTester tester(&w, QAbstractItemModelTester::FailureReportingMode::QtTest);
+
+    // a row moving out of the window loses its persistent index, the others follow their entry
+    QPersistentModelIndex leaving(w.index(0)), staying(w.index(2));
+    source_->move(10, 50);
+    checkWindow(w);
+    QVERIFY(!leaving.isValid());
+    QCOMPARE(staying.row(), 1);
+
+    source_->sortByKey(ContactEntry::age, Qt::DescendingOrder);
+    checkWindow(w);
+    QCOMPARE(w.at(0)->getValue(ContactEntry::age).toInt(), 89);
+}
+
+void tst_KVListWindowModel::setData()
+{
+    KVListWindowModel w(source_, 10, 5);
+    QVERIFY(w.setData(w.index(1), "changed", ContactEntry::name));
+    QCOMPARE(source_->at(11)->getValue(ContactEntry::name).toString(), QString("changed"));
+    QVERIFY(!w.setData(w.index(7), "outside", ContactEntry::name));
+}
+
+QTEST_GUILESS_MAIN(tst_KVListWindowModel)
+#include "tst_kvlistwindowmodel.moc"
@@ -0,0 +1,153 @@
+#include "logoprocessor.h"
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QStandardPaths>
+#include <QSaveFile>
+#include <QFile>
+#include <QDir>
+#include <QDateTime>
+#include <QRunnable>
+#include <QThread>
+#include <QDebug>
+
+namespace {
+class Job : public QRunnable
+{
+public:
+    explicit Job(const std::function<void ()> &func) : func_(func) {}
+    void run() override { func_(); }
+private:
+    std::function<void ()> func_;
+};
+}
+
+LogoProcessor *LogoProcessor::instance()
+{
+    static LogoProcessor *instance_ = new LogoProcessor(QCoreApplication::instance());
+    return instance_;
+}
+
+LogoProcessor::LogoProcessor(QObject *parent) :
+    QObject(parent),
+    cacheBudget_(32*1024*1024)
+{
+    QString loc = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+    QDir d(loc);
+    d.mkpath("./logos/cache");
+    logoDir_ = d.filePath("logos");
+    cacheDir_ = d.filePath("logos/cache");
+
+    // decoding and encoding is mostly cpu bound, but we leave some cores to the gui
+    pool_.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+}
+
+void LogoProcessor::process(const QString &sourceFile, const QString &targetBase, DoneFunc done)
+{
+    pool_.start(new Job([=](){
+        QString file = processInWorker(sourceFile, targetBase);
+        QUrl url = file.isEmpty() ? QUrl() : QUrl::fromLocalFile(file);
+
+        // deliver the result in our thread
+        QMetaObject::invokeMethod(this, [=](){ done(url); }, Qt::QueuedConnection);
+    }));
+}
+
+QImage LogoProcessor::cropImg(const QImage &src)
+{
+    int min = qMin(src.width(), src.height());
+    QRect r1(0,0, src.width(), src.height()), r2(0,0, min, min);
+    r2.moveCenter(r1.center());
+    QImage img = src.copy(r2);
+
+    if(img.width() > 512)
+        img = img.scaled(512, 512);
+
+    return img;
+}
+
+QString LogoProcessor::processInWorker(const QString &sourceFile, const QString &targetBase)
+{
+    QFile f(sourceFile);
+    if(!f.open(QIODevice::ReadOnly)) {
+        qWarning() << "cannot read logo" << sourceFile;
+        return QString();
+    }
+    QByteArray data = f.readAll();
+    f.close();
+
+    QString hash = QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex());
+    QString cached = QDir(cacheDir_).filePath(hash + ".png");
+    QString target = QString("%1-%2.png").arg(targetBase, hash.left(16));
+
+    {
+        // the same picture might be processed concurrently (e.g. bulk import)... do it only once
+        QSharedPointer<QMutex> lock = lockFor(hash);
+        QMutexLocker locker(lock.data());
+
+        if(QFile::exists(cached)) {
+            // keep recently used entries in the cache
+            QFile c(cached);
+            if(c.open(QIODevice::ReadWrite))
+                c.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+        } else {
+            QImage img;
+            if(!img.loadFromData(data)) {
+                qWarning() << "cannot decode logo" << sourceFile;
+                return QString();
+            }
+            img = cropImg(img);
+
+            QSaveFile out(cached);
+            if(!out.open(QIODevice::WriteOnly) || !img.save(&out, "PNG") || !out.commit()) {
+                qWarning() << "cannot write logo" << cached;
+                return QString();
+            }
+        }
+
+        if(!QFile::exists(target) && !QFile::copy(cached, target)) {
+            qWarning() << "cannot write logo" << target;
+            return QString();
+        }
+    }
+
+    trimCache();
+    return target;
+}
+
+QSharedPointer<QMutex> LogoProcessor::lockFor(const QString &hash)
+{
+    QMutexLocker locker(&mutex_);
+    QSharedPointer<QMutex> lock = inProgress_.value(hash).toStrongRef();
+    if(!lock) {
+        lock = QSharedPointer<QMutex>::create();
+        inProgress_.insert(hash, lock);
+    }
+
+    // forget about locks nobody uses anymore
+    for(auto i = inProgress_.begin(); i != inProgress_.end(); ) {
+        if(i.value().isNull())
+            i = inProgress_.erase(i);
+        else
+            ++i;
+    }
+    return lock;
+}
+
+void LogoProcessor::trimCache()
+{
+    QMutexLocker locker(&mutex_);
+
+    // oldest first
+    QFileInfoList files = QDir(cacheDir_).entryInfoList(QStringList() << "*.png", QDir::Files, QDir::Time | QDir::Reversed);
+    qint64 size = 0;
+    for(const QFileInfo &fi : files)
+        size += fi.size();
+
+    for(int i=0; i<files.size() && size > cacheBudget_; i++) {
+        // still being processed by another worker
+        if(!inProgress_.value(files[i].completeBaseName()).isNull())
+            continue;
+        if(QFile::remove(files[i].filePath()))
+            size -= files[i].size();
+    }
+}
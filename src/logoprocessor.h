@@ -0,0 +1,55 @@
+#ifndef LOGOPROCESSOR_H
+#define LOGOPROCESSOR_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QMutex>
+#include <QAtomicInteger>
+#include <QHash>
+#include <QSharedPointer>
+#include <QImage>
+#include <QUrl>
+#include <functional>
+
+// processes user chosen logos (decode, crop, scale, encode) on a thread pool
+//
+// processed images are kept in a content-hashed cache (sha1 of the source file), so the same
+// picture is only processed once; the cache is bounded by 'cacheBudget' bytes (least recently
+// used files are removed first). Each result is copied to its own file, so removing cache
+// entries never affects logos in use.
+class LogoProcessor : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef std::function<void (const QUrl &url)> DoneFunc;
+
+    static LogoProcessor *instance();
+
+    // process 'sourceFile' and store it as '<targetBase>-<hash>.png'; 'done' is called in the
+    // thread of the processor (the gui thread) with the resulting url, or an empty url on errors
+    void process(const QString &sourceFile, const QString &targetBase, DoneFunc done);
+
+    QString logoDir() const { return logoDir_; }
+
+    qint64 cacheBudget() const { return cacheBudget_; }
+    void setCacheBudget(qint64 bytes) { cacheBudget_ = bytes; }
+
+    static QImage cropImg(const QImage &src);
+
+private:
+    explicit LogoProcessor(QObject *parent=nullptr);
+
+    QString processInWorker(const QString &sourceFile, const QString &targetBase);
+    QSharedPointer<QMutex> lockFor(const QString &hash);
+    void trimCache();
+
+    QString logoDir_, cacheDir_;
+    QThreadPool pool_;
+    QAtomicInteger<qint64> cacheBudget_;
+
+    QMutex mutex_;
+    QHash<QString, QWeakPointer<QMutex>> inProgress_;
+};
+
+#endif // LOGOPROCESSOR_H
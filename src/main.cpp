@@ -7,6 +7,10 @@
 #include "activitymodel.h"
 #include "activityentry.h"
 #include "kvlistserializer.h"
+#include "kvlistaggregate.h"
+#include "kvlistwindowmodel.h"
+#include "kvlistgroupedmodel.h"
+#include "kvlisttrace.h"
 
 
 void registerTypes(QObject *parent) {
@@ -22,13 +26,37 @@ void registerTypes(QObject *parent) {
         FriendsModel *f = new FriendsModel(parent);
         f->setSerializationFile(fname);
 
-        if(!f->deSerialize())
+        // FRIENDS_TRACE=<file> records all operations for kvlist_replay (once loading is done)
+        QString traceFile = qEnvironmentVariable("FRIENDS_TRACE");
+        auto startTrace = [f, traceFile](){
+            if(!traceFile.isEmpty())
+                new KVListTraceRecorder(f, traceFile);
+        };
+
+        // don't block the engine: entries show up while the file is parsed
+        QObject::connect(f, &KVListModel::loaded, f, [f, startTrace](bool ok){
+            if(!ok)
+                f->createDefaultValues();
+            startTrace();
+        });
+        if(!f->deSerializeAsync()) {
             f->createDefaultValues();
+            startTrace();
+        }
+
+        // changes which are not saved by the ui (e.g. logos processed in the background)
+        QObject::connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, f, [f](){
+            if(f->isModified())
+                f->serialize();
+        });
 
         return f;
     });
 
     qmlRegisterType<FriendsEntry>("Insta", 1, 0, "FriendsEntry");
+    qmlRegisterType<KVListAggregate>("Insta", 1, 0, "KVListAggregate");
+    qmlRegisterType<KVListWindowModel>("Insta", 1, 0, "KVListWindowModel");
+    qmlRegisterType<KVListGroupedModel>("Insta", 1, 0, "KVListGroupedModel");
 
     REGISTER_2_SERIALIZATION_FACTORY(FriendsModel);
     REGISTER_2_SERIALIZATION_FACTORY(FriendsEntry);
@@ -0,0 +1,69 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+#include <QDateTime>
+#include <QUuid>
+#include <algorithm>
+#include "friendsmodel.h"
+#include "kvlistmemoryusage.h"
+
+// kvlist_membench: fills a FriendsModel with generated rows and prints the estimated memory per row
+// (see KVListMemoryUsage), e.g. to compare the footprint before / after a change of the entry layout
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Estimates the memory per row of a FriendsModel");
+    parser.addHelpOption();
+    QCommandLineOption rows("rows", "number of generated rows", "n", "10000");
+    QCommandLineOption activities("activities", "also create the activity child models");
+    parser.addOption(rows);
+    parser.addOption(activities);
+    parser.process(app);
+
+    const int n = qMax(1, parser.value(rows).toInt());
+
+    FriendsModel model;
+    const QDateTime now = QDateTime::currentDateTime();
+    QVector<KVListEntry*> entries;
+    entries.reserve(n);
+    for(int i=0; i<n; i++) {
+        const QString first = QString("First%1").arg(i);
+        const QString last = QString("Last%1").arg(i % 1000);
+        FriendsEntry *e = FriendsEntry::create({
+                                                   {FriendsEntry::firstname, first},
+                                                   {FriendsEntry::surname, last},
+                                                   {FriendsEntry::email, QString("%1.%2@example.com").arg(first, last)},
+                                                   {FriendsEntry::phonenumber, QString("+49 30 %1").arg(1000000 + i)},
+                                                   {FriendsEntry::lastseen, now.addSecs(-i * 60)},
+                                               });
+        if(parser.isSet(activities))
+            e->getChildModel(FriendsEntry::activitiesAll);
+        entries << e;
+    }
+    model.appendEntries(entries);
+
+    const KVListMemoryUsage usage = KVListMemoryUsage::measure(&model);
+
+    QTextStream out(stdout);
+    out << n << " rows, " << usage.modelCount() << " models, " << usage.totalRows() << " rows in total" << "\n";
+    out << "total:       " << usage.total() << " bytes" << "\n";
+    out << "bytesPerRow: " << usage.bytesPerRow() << "\n";
+
+    for(int c=0; c<KVListMemoryUsage::CategoryCount; c++) {
+        const KVListMemoryUsage::Category category = KVListMemoryUsage::Category(c);
+        out << "  " << KVListMemoryUsage::categoryName(category).leftJustified(16)
+            << QString::number(usage.bytes(category) / n).rightJustified(8) << " bytes/row" << "\n";
+    }
+
+    // largest keys first
+    const QHash<QString, qint64> keys = usage.keyBytes();
+    QStringList names = keys.keys();
+    std::sort(names.begin(), names.end(), [&keys](const QString &a, const QString &b) { return keys[a] > keys[b]; });
+    out << "per key:" << "\n";
+    for(const QString &name : names)
+        out << "  " << name.leftJustified(36) << QString::number(keys[name] / n).rightJustified(8) << " bytes/row" << "\n";
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+#include "friendsmodel.h"
+#include "activitymodel.h"
+#include "activityentry.h"
+#include "kvlistserializer.h"
+#include "kvlisttrace.h"
+
+// kvlist_replay: replays a trace recorded via KVListTraceRecorder (e.g. FRIENDS_TRACE=friends.kvlt ./FriendsList)
+// and prints the time spent per operation
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    REGISTER_2_SERIALIZATION_FACTORY(FriendsModel);
+    REGISTER_2_SERIALIZATION_FACTORY(FriendsEntry);
+    REGISTER_2_SERIALIZATION_FACTORY(ActivityModel);
+    REGISTER_2_SERIALIZATION_FACTORY(ActivityEntry);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replays a KVList trace and measures the time per operation");
+    parser.addHelpOption();
+    parser.addPositionalArgument("trace", "trace file");
+    QCommandLineOption realTime("realtime", "keep the recorded pauses between operations");
+    QCommandLineOption repeat("repeat", "replay <n> times (on a fresh model each time)", "n", "1");
+    parser.addOption(realTime);
+    parser.addOption(repeat);
+    parser.process(app);
+
+    if(parser.positionalArguments().size() != 1)
+        parser.showHelp(1);
+
+    QTextStream out(stdout);
+    KVListTracePlayer player;
+    if(!player.open(parser.positionalArguments().first())) {
+        out << "cannot open trace: " << player.errorString() << "\n";
+        return 1;
+    }
+
+    const int runs = qMax(1, parser.value(repeat).toInt());
+    for(int run=0; run<runs; run++)
+    {
+        KVListModel *model = player.createModel();
+        if(!model) {
+            out << "cannot create the model: " << player.errorString() << "\n";
+            return 1;
+        }
+
+        bool ok = player.replay(model, parser.isSet(realTime));
+        delete model;
+        if(!ok) {
+            out << "replay failed: " << player.errorString() << "\n";
+            return 1;
+        }
+
+        out << "run " << run+1 << ": " << player.replayNs() / 1000 << " us replayed, "
+            << player.recordedUs() << " us recorded" << "\n";
+        for(int op=0; op<KVListTrace::OpCount; op++) {
+            KVListTracePlayer::OpStats s = player.stats(KVListTrace::Op(op));
+            if(s.count == 0)
+                continue;
+            out << "  " << KVListTrace::opName(KVListTrace::Op(op)).leftJustified(16)
+                << QString::number(s.count).rightJustified(10) << " ops "
+                << QString::number(s.replayNs / 1000).rightJustified(10) << " us "
+                << QString::number(double(s.replayNs) / s.count, 'f', 0).rightJustified(8) << " ns/op" << "\n";
+        }
+    }
+
+    return 0;
+}